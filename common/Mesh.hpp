@@ -1,9 +1,12 @@
 #ifndef MESH_H
 #define MESH_H
 
+#include "profiler.hpp"
+#include "render_stats.hpp"
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <string>
+#include <utility>
 #include <vector>
 
 // tirado do livro Learn OpenGL : cap. 20
@@ -12,7 +15,7 @@
 struct Vertex {
   glm::vec3 Position; // Posição
   glm::vec3 Normal;   // Normal
-  // glm::vec2 TexCoords; // Removido pois não usamos texturas
+  glm::vec2 TexCoords; // Coordenadas de textura ((0, 0) sem "vt")
 };
 
 // Classe Mesh
@@ -30,36 +33,93 @@ public:
 
   // Desenha a malha
   void Draw(GLuint shaderProgram) {
-    glBindVertexArray(VAO);
-    if (!indices.empty()) {
+    PROFILE_ZONE("Mesh::Draw");
+    if (!isResident())
+      return;
+    countedBindVertexArray(VAO);
+    if (isIndexed()) {
       // Desenha com índices se existirem
-      glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+      countedDrawElements(GL_TRIANGLES, (GLsizei)m_indexCount, GL_UNSIGNED_INT,
+                          0);
     } else {
       // Desenha array de vértices
-      glDrawArrays(GL_TRIANGLES, 0, vertices.size());
+      countedDrawArrays(GL_TRIANGLES, 0, (GLsizei)m_vertexCount);
     }
-    glBindVertexArray(0); // Desvincula VAO
+    countedBindVertexArray(0); // Desvincula VAO
+  }
+
+  // VAO com os atributos da malha (para quem desenha sem Draw())
+  unsigned int getVAO() const { return VAO; }
+
+  // VAO só com posições (atributo 0), num buffer compacto à parte, para
+  // passes que só escrevem profundidade. Usa os mesmos índices.
+  unsigned int getPositionVAO() const { return positionVAO; }
+
+  // Contagens dos buffers na GPU, guardadas à parte das cópias na CPU:
+  // release() liberta as cópias mas não muda o que a malha contém
+  size_t vertexCount() const { return m_vertexCount; }
+  size_t indexCount() const { return m_indexCount; }
+  bool isIndexed() const { return m_indexCount != 0; }
+
+  // Memória dos buffers na GPU (vértices, posições e índices)
+  size_t gpuBytes() const {
+    if (!isResident())
+      return 0;
+    return m_vertexCount * (sizeof(Vertex) + sizeof(glm::vec3)) +
+           m_indexCount * sizeof(unsigned int);
+  }
+
+  bool isResident() const { return VAO != 0; }
+
+  // Liberta os buffers na GPU e as cópias na CPU (ResidencyManager); a
+  // malha só volta a ser desenhável depois de reload()
+  void release() {
+    if (!isResident())
+      return;
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteVertexArrays(1, &positionVAO);
+    glDeleteBuffers(1, &VBO);
+    glDeleteBuffers(1, &EBO);
+    glDeleteBuffers(1, &positionVBO);
+    VAO = VBO = EBO = positionVAO = positionVBO = 0;
+    std::vector<Vertex>().swap(vertices);
+    std::vector<unsigned int>().swap(indices);
+  }
+
+  // Volta a criar os buffers a partir dos dados dados (ex.: da cache)
+  void reload(std::vector<Vertex> vertices, std::vector<unsigned int> indices) {
+    release();
+    this->vertices = std::move(vertices);
+    this->indices = std::move(indices);
+    setupMesh();
   }
 
 private:
-  unsigned int VAO, VBO, EBO;
+  unsigned int VAO = 0, VBO = 0, EBO = 0;
+  unsigned int positionVAO = 0, positionVBO = 0;
+  size_t m_vertexCount = 0, m_indexCount = 0;
 
   // Configura os buffers da malha (VAO, VBO, EBO)
   void setupMesh() {
+    PROFILE_ZONE("Mesh::setupMesh");
+    m_vertexCount = vertices.size();
+    m_indexCount = indices.size();
+    if (vertices.empty())
+      return; // Nada a carregar: a malha fica não residente
     glGenVertexArrays(1, &VAO);
     glGenBuffers(1, &VBO);
     glGenBuffers(1, &EBO);
 
     glBindVertexArray(VAO);
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex),
-                 &vertices[0], GL_STATIC_DRAW);
+    countedBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex),
+                      vertices.data(), GL_STATIC_DRAW);
 
     if (!indices.empty()) {
       glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-      glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-                   indices.size() * sizeof(unsigned int), &indices[0],
-                   GL_STATIC_DRAW);
+      countedBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                        indices.size() * sizeof(unsigned int), indices.data(),
+                        GL_STATIC_DRAW);
     }
 
     // Atributo 0: Posição
@@ -69,6 +129,27 @@ private:
     glEnableVertexAttribArray(1);
     glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
                           (void *)offsetof(Vertex, Normal));
+    // Atributo 2: Coordenadas de textura
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                          (void *)offsetof(Vertex, TexCoords));
+
+    // Stream só de posições: 12 bytes por vértice em vez de 32
+    std::vector<glm::vec3> positions(vertices.size());
+    for (size_t i = 0; i < vertices.size(); ++i)
+      positions[i] = vertices[i].Position;
+
+    glGenVertexArrays(1, &positionVAO);
+    glGenBuffers(1, &positionVBO);
+    glBindVertexArray(positionVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, positionVBO);
+    countedBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(glm::vec3),
+                      positions.data(), GL_STATIC_DRAW);
+    if (!indices.empty())
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3),
+                          (void *)0);
 
     glBindVertexArray(0);
   }
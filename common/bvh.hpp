@@ -0,0 +1,155 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class JobSystem;
+
+struct Ray {
+  glm::vec3 origin;
+  glm::vec3 direction; // Need not be normalized; t is in its units
+  float tMax = 1e30f;
+};
+
+struct RayHit {
+  float t = 1e30f;
+  float u = 0.0f, v = 0.0f; // Barycentrics of vertices 1 and 2
+  uint32_t triangle = UINT32_MAX;
+
+  bool hit() const { return triangle != UINT32_MAX; }
+};
+
+// 32-byte node shared by Bvh and InstanceBvh; children sit next to each
+// other, so an interior node only stores the left one
+struct alignas(32) BvhNode {
+  glm::vec3 min;
+  uint32_t leftFirst; // Left child (interior) or first item (leaf)
+  glm::vec3 max;
+  uint32_t count; // Items in a leaf, 0 for interior nodes
+};
+
+// Four rays traced together (structure of arrays). Meant for coherent rays,
+// such as the primary rays of a 2x2 pixel block.
+struct RayPacket4 {
+  float ox[4], oy[4], oz[4];
+  float dx[4], dy[4], dz[4];
+  float tMax[4];
+};
+
+struct PacketHit4 {
+  float t[4];
+  float u[4], v[4];
+  uint32_t triangle[4]; // UINT32_MAX where the ray missed
+};
+
+// Bounding volume hierarchy over a triangle soup, as returned by loadOBJ
+// (three positions per triangle).
+//
+// The build sorts triangles by centroid into kBins bins per axis and takes
+// the split with the lowest surface area heuristic cost; nodes with few
+// triangles become leaves when splitting would not pay. With a JobSystem,
+// the binning of large nodes and the subtrees of large nodes run in
+// parallel.
+//
+// Hits report the triangle's index in the source array, so callers can
+// look up normals or materials with it.
+class Bvh {
+public:
+  static const int kBins = 16;
+  static const uint32_t kMaxLeafSize = 8;
+
+  struct Stats {
+    double buildMs = 0.0;
+    size_t nodes = 0;
+    size_t leaves = 0;
+    int maxDepth = 0; // Of the deepest leaf, the root being 1
+  };
+
+  void build(const glm::vec3 *positions, size_t triangleCount,
+             JobSystem *jobs = nullptr);
+
+  bool empty() const { return m_nodes.empty(); }
+  size_t triangleCount() const { return m_triangles.size(); }
+  const Stats &stats() const { return m_stats; }
+  glm::vec3 boundsMin() const;
+  glm::vec3 boundsMax() const;
+
+  // Nearest hit closer than hit.t (and ray.tMax); true if hit was updated
+  bool intersect(const Ray &ray, RayHit &hit) const;
+
+  // Nearest hit of each ray of the packet. Falls back to four single rays
+  // without SSE.
+  void intersect4(const RayPacket4 &packet, PacketHit4 &hit) const;
+
+private:
+  typedef BvhNode Node;
+  // Precomputed for Moller-Trumbore
+  struct Triangle {
+    glm::vec3 v0, e1, e2;
+  };
+  struct BuildContext;
+
+  void subdivide(BuildContext &ctx, uint32_t node, uint32_t first,
+                 uint32_t count, int depth);
+
+  std::vector<Node> m_nodes;
+  std::vector<Triangle> m_triangles; // In leaf order
+  std::vector<uint32_t> m_sourceIndex; // Leaf order -> source triangle
+  Stats m_stats;
+};
+
+// Bottom-level structure placed in the world
+struct BvhInstance {
+  const Bvh *blas = nullptr;
+  glm::mat4 model = glm::mat4(1.0f);
+  uint32_t id = 0; // Reported back in InstanceHit
+};
+
+struct InstanceHit {
+  float t = 1e30f;
+  float u = 0.0f, v = 0.0f;
+  uint32_t triangle = UINT32_MAX;
+  uint32_t instance = UINT32_MAX; // BvhInstance::id
+
+  bool hit() const { return instance != UINT32_MAX; }
+};
+
+// Top-level hierarchy over instances of bottom-level Bvhs (TLAS over
+// BLAS). Leaves hold instances; a ray reaching one is moved into the
+// instance's object space and traced through its Bvh. Directions are not
+// renormalized there, so t means the same in both spaces.
+//
+// Instances are few next to triangles, so the build splits at the median
+// along the longest axis instead of evaluating SAH; a thousand instances
+// rebuild in well under a millisecond.
+class InstanceBvh {
+public:
+  void build(const BvhInstance *instances, size_t count);
+
+  bool empty() const { return m_nodes.empty(); }
+  size_t instanceCount() const { return m_instances.size(); }
+
+  // Nearest hit over all instances; true if one was found
+  bool intersect(const Ray &ray, InstanceHit &hit) const;
+
+private:
+  struct Placed {
+    const Bvh *blas;
+    glm::mat4 worldToObject;
+    uint32_t id;
+  };
+
+  struct BuildItem;
+
+  // Fills `node` with items [first, first + count), then its children
+  void buildRange(std::vector<BuildItem> &items, uint32_t node,
+                  uint32_t first, uint32_t count, int depth);
+
+  std::vector<BvhNode> m_nodes;
+  std::vector<Placed> m_instances; // In leaf order
+};
+
+#endif
@@ -0,0 +1,125 @@
+#ifndef CHUNK_STREAMER_H
+#define CHUNK_STREAMER_H
+
+#include "chunked_mesh.hpp"
+#include "frustum.hpp"
+#include <glad/glad.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// One visible chunk at its best resident LOD
+struct ChunkDraw {
+  GLuint vao = 0;
+  GLsizei indexCount = 0;
+  uint32_t lod = 0;
+  float distance = 0.0f; // From the camera to the chunk's bounds
+};
+
+struct ChunkStreamStats {
+  uint32_t chunks = 0;  // In the file
+  uint32_t drawn = 0;   // Visible, drawn at some resident LOD
+  uint32_t missing = 0; // Visible, nothing resident yet
+  uint32_t pending = 0; // Reads queued or in flight
+  uint32_t loads = 0;   // LODs uploaded by the last update()
+  uint32_t evictions = 0;
+  uint64_t residentBytes = 0;
+  uint64_t budgetBytes = 0;
+  uint32_t drawnPerLod[kChunkLodCount] = {};
+};
+
+// Streams the chunks of a chunk file (chunked_mesh.hpp) by camera
+// proximity and screen-space error, under a memory budget.
+//
+// Each update() picks, per chunk, the coarsest LOD whose error covers at
+// most maxPixelError pixels. Under the budget every chunk is first given
+// its coarsest LOD, then the nearest ones are refined towards that choice
+// while memory is left (only if even the coarsest LODs do not all fit are
+// the farthest chunks dropped). Reads run on a dedicated IO thread, so a
+// slow disk never holds up the job system; finished reads are uploaded by
+// the next update(). Until a chunk's chosen LOD arrives, the LOD it
+// already has keeps being drawn.
+//
+// Everything but the IO thread runs on the GL thread.
+class ChunkStreamer {
+public:
+  ChunkStreamer();
+  ~ChunkStreamer();
+
+  ChunkStreamer(const ChunkStreamer &) = delete;
+  ChunkStreamer &operator=(const ChunkStreamer &) = delete;
+
+  // Read the header and chunk table and start the IO thread
+  bool open(const std::string &path);
+
+  // Bytes of loaded LODs plus reads in flight (0 = unlimited)
+  void setBudget(uint64_t bytes) { m_budget = bytes; }
+  void setMaxPixelError(float pixels) { m_maxPixelError = pixels; }
+
+  // Once per frame. `cameraPos` is in the mesh's model space; an error e
+  // at distance d covers e * pixelScale / d pixels, so pixelScale is the
+  // viewport height * proj[1][1] / 2.
+  void update(const glm::vec3 &cameraPos, float pixelScale);
+
+  // Free every loaded LOD and forget the chunks wanted; reads in flight
+  // are dropped when they land. For when the mesh is no longer drawn.
+  void evictAll();
+
+  // Visible chunks (frustum in model space), each at its best resident
+  // LOD. Call after update().
+  void collectDraws(const Frustum &frustum, std::vector<ChunkDraw> &draws);
+
+  const ChunkStreamStats &stats() const { return m_stats; }
+
+private:
+  struct Slot {
+    GLuint vao = 0, vbo = 0, ebo = 0;
+    bool resident = false;
+    bool pending = false; // Read queued or in flight
+  };
+  struct Chunk {
+    glm::vec3 boundsMin, boundsMax;
+    ChunkLod lods[kChunkLodCount];
+    Slot slots[kChunkLodCount];
+    int wanted = -1; // LOD chosen by the last update(), -1 = none
+    float distance = 0.0f;
+  };
+  struct Request {
+    uint32_t chunk, lod;
+  };
+  struct Result {
+    uint32_t chunk, lod;
+    bool ok;
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+  };
+
+  void ioThreadMain();
+  void upload(Result &result);
+  void evict(Chunk &chunk, uint32_t lod);
+  // Free fallback LODs, farthest chunks first, until `bytes` more fit
+  bool makeRoom(uint64_t bytes);
+
+  std::vector<Chunk> m_chunks;
+  std::vector<uint32_t> m_order; // Chunks nearest first (scratch)
+  uint64_t m_budget = 0;
+  uint64_t m_residentBytes = 0;
+  uint64_t m_pendingBytes = 0;
+  uint32_t m_pendingReads = 0;
+  float m_maxPixelError = 1.0f;
+  ChunkStreamStats m_stats;
+
+  // IO thread: reads requests from m_file, hands back results
+  FILE *m_file = nullptr;
+  std::thread m_ioThread;
+  std::mutex m_mutex;
+  std::condition_variable m_wake;
+  std::deque<Request> m_requests;
+  std::deque<Result> m_results;
+  bool m_stop = false;
+};
+
+#endif
@@ -0,0 +1,112 @@
+#ifndef CHUNKED_MESH_H
+#define CHUNKED_MESH_H
+
+#include "Mesh.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+class JobSystem;
+
+// Paged file of a mesh split into spatial chunks, each with kChunkLodCount
+// levels of detail (ChunkStreamer reads it at runtime, mesh_chunker writes
+// it). Layout:
+//
+//   ChunkFileHeader
+//   LOD blobs, each starting on a kChunkPageSize boundary:
+//     Vertex[vertexCount], uint32_t index[indexCount]
+//   ChunkRecord[chunkCount] at tableOffset (bounds and LOD table)
+//
+// The table comes last because chunks are written as they are built and
+// their number is only known at the end. Only the header and the table are
+// read up front; a blob is one seek and one read. LOD 0 is the
+// full-resolution geometry of the chunk.
+const uint32_t kChunkLodCount = 4;
+const uint32_t kChunkPageSize = 4096;
+
+struct ChunkFileHeader {
+  char magic[4]; // "TP2C"
+  uint32_t version;
+  uint32_t vertexSize; // sizeof(Vertex) when written
+  uint32_t lodCount;   // kChunkLodCount
+  uint32_t chunkCount;
+  uint32_t pageSize;
+  float boundsMin[3], boundsMax[3]; // Whole mesh
+  uint64_t tableOffset;             // Of the ChunkRecords
+};
+
+struct ChunkLod {
+  uint64_t offset; // Of the blob, from the start of the file
+  uint32_t vertexCount;
+  uint32_t indexCount;
+  float error; // Largest distance any surface point moved (model units)
+  uint32_t padding;
+};
+
+struct ChunkRecord {
+  float boundsMin[3], boundsMax[3];
+  ChunkLod lods[kChunkLodCount];
+};
+
+// Bytes of one LOD once loaded (and on the GPU)
+inline uint64_t chunkLodBytes(const ChunkLod &lod) {
+  return (uint64_t)lod.vertexCount * sizeof(Vertex) +
+         (uint64_t)lod.indexCount * sizeof(uint32_t);
+}
+
+// A mesh handed over one triangle (three vertices) at a time, so it never
+// has to be in memory as a whole. The source must give the same triangles
+// in the same order on every call, and return false if it cannot.
+typedef std::function<void(const Vertex *triangle)> TriangleSink;
+typedef std::function<bool(const TriangleSink &sink)> TriangleSource;
+
+struct ChunkBuildOptions {
+  size_t maxTriangles = 16384;        // Per chunk
+  size_t bucketTriangles = 1u << 20; // Refined in memory at once
+};
+
+struct ChunkBuildStats {
+  uint64_t triangles = 0;
+  uint32_t chunks = 0;
+  uint32_t buckets = 0;       // Refined in memory, one after another
+  uint64_t largestBucket = 0; // Triangles
+  uint64_t lodTriangles[kChunkLodCount] = {};
+  uint64_t lodVertices[kChunkLodCount] = {};
+  float lodError[kChunkLodCount] = {};
+};
+
+// Split a mesh into chunks of at most `maxTriangles` and write them with
+// their LODs to `path`, out of core:
+//
+//  1. One pass over the source for the bounds and the LOD grids.
+//  2. A second pass bins the triangles by centroid into slabs along the
+//     longest axis, one bucket file each next to `path`, and sums the
+//     vertices of every LOD grid cell. A bucket still above
+//     `bucketTriangles` is binned again.
+//  3. Each bucket in turn is loaded, split by median splits along the
+//     longest axis, and its chunks' LODs are built on the job system,
+//     written out and freed. The table is written last.
+//
+// Memory is one bucket plus the grid cells, never the whole mesh.
+//
+// LOD 0 welds identical vertices. Coarser LODs cluster vertices on a grid
+// whose cell doubles per level; the grid and each cell's representative
+// vertex (the average of the mesh's vertices in it) are shared by the
+// whole mesh, so neighbouring chunks at the same LOD still meet without
+// cracks, across buckets too.
+bool buildChunkFile(const std::string &path, const TriangleSource &source,
+                    const ChunkBuildOptions &options, ChunkBuildStats &stats,
+                    JobSystem *jobs = nullptr);
+
+// Header and chunk table only
+bool readChunkTable(FILE *file, ChunkFileHeader &header,
+                    std::vector<ChunkRecord> &records);
+
+// One LOD blob
+bool readChunkLod(FILE *file, const ChunkLod &lod,
+                  std::vector<Vertex> &vertices,
+                  std::vector<uint32_t> &indices);
+
+#endif
@@ -0,0 +1,108 @@
+#ifndef CLUSTERED_LIGHTS_H
+#define CLUSTERED_LIGHTS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+class JobSystem;
+
+// Point light with a finite range; nothing is lit past `radius`
+struct PointLight {
+  glm::vec3 position; // World space
+  float radius;
+  glm::vec3 color;
+};
+
+// Camera the clusters are built for
+struct ClusterCamera {
+  glm::mat4 view;
+  float fovY;   // Radians
+  float aspect; // Width / height
+  float zNear;  // Depth of the first slice (fragments nearer use it too)
+  float zFar;   // Depth of the last slice
+};
+
+// Per-cluster light lists, ready to upload (what phong.frag reads)
+struct ClusterLists {
+  // Two texels per light: (eye position, radius), (color, 0)
+  std::vector<glm::vec4> lights;
+  // Two words per cluster: offset into indices, light count
+  std::vector<uint32_t> grid;
+  std::vector<uint32_t> indices;
+  uint32_t maxPerCluster = 0;
+  float binMs = 0.0f;
+};
+
+// Clustered forward shading: the view frustum is split into kTilesX x
+// kTilesY screen tiles and kSlices depth slices, exponentially spaced so
+// clusters stay roughly cube shaped. Every light is listed in the clusters
+// its sphere touches, and a fragment only loops over the list of the
+// cluster it falls in.
+//
+// build() runs on the CPU: lights are moved into eye space in parallel,
+// then each depth slice is binned by its own job (a light's screen bounds
+// are computed per slice, then tested against each cluster's box), so no
+// two jobs write the same list.
+class LightClusters {
+public:
+  static const int kTilesX = 16;
+  static const int kTilesY = 9;
+  static const int kSlices = 24;
+  static const int kClusterCount = kTilesX * kTilesY * kSlices;
+  static const uint32_t kMaxLights = 4096;
+
+  // Bin `count` lights (at most kMaxLights) into `out`
+  void build(const PointLight *lights, size_t count,
+             const ClusterCamera &camera, ClusterLists &out,
+             JobSystem *jobs = nullptr);
+
+private:
+  struct EyeLight {
+    glm::vec3 center; // Eye space (looking down -z)
+    float radius;
+    int firstSlice, lastSlice; // -1 when entirely out of range
+  };
+
+  // Eye-space depth of the near boundary of `slice`
+  float sliceDepth(int slice) const;
+  void binSlice(int slice);
+
+  ClusterCamera m_camera;
+  float m_tanX = 1.0f, m_tanY = 1.0f; // Half extents at depth 1
+  float m_logRatio = 1.0f;            // log(zFar / zNear)
+  std::vector<EyeLight> m_eyeLights;
+  std::vector<uint32_t> m_counts; // Lights per cluster
+  // Per slice: its clusters' lists back to back, concatenated into `out`
+  // afterwards, and the scratch overlaps they are sorted from
+  std::vector<std::vector<uint32_t>> m_sliceIndices;
+  std::vector<std::vector<uint32_t>> m_slicePairs;
+};
+
+// Texture buffers holding ClusterLists for phong.frag, bound to three
+// texture units of their own
+class ClusterBuffers {
+public:
+  static const GLint kLightDataUnit = 4; // Past the shadow cube map
+  static const GLint kGridUnit = 5;
+  static const GLint kIndexUnit = 6;
+
+  ClusterBuffers();
+  ~ClusterBuffers();
+
+  ClusterBuffers(const ClusterBuffers &) = delete;
+  ClusterBuffers &operator=(const ClusterBuffers &) = delete;
+
+  // Upload (orphaning last frame's storage) and bind to the units above
+  void upload(const ClusterLists &lists);
+
+  // Point a program's samplers at the units above. Call once after linking.
+  static void setupProgram(GLuint program);
+
+private:
+  GLuint m_buffers[3] = {0, 0, 0};
+  GLuint m_textures[3] = {0, 0, 0};
+};
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#include <glad/glad.h>
+
+// Offscreen scene target whose resolution follows the GPU frame time.
+//
+// The scene is drawn into the lower-left scale x scale part of an offscreen
+// framebuffer and then stretched onto the default framebuffer with a linear
+// blit. The storage is sized for maxScale of the output and only
+// reallocated when the output size changes, so changing the scale is free.
+//
+// update() moves the scale toward the GPU budget. Pixel cost grows with the
+// square of the scale, so each step multiplies it by sqrt(budget / time).
+// Hysteresis keeps it stable: nothing changes while the (smoothed) time is
+// inside [lowerBand, 1] x budget, and the time must stay outside that band
+// for holdFrames measurements in a row before the scale moves.
+class DynamicResolution {
+public:
+  struct Settings {
+    float budgetMs = 16.0f;    // Target GPU time per frame
+    float minScale = 0.5f;     // Per-axis bounds of the render scale
+    float maxScale = 1.0f;
+    float lowerBand = 0.85f;   // Grow only below lowerBand x budget
+    int holdFrames = 8;        // Measurements outside the band per step
+    float maxStepDown = 0.85f; // Largest single change, as a factor
+    float maxStepUp = 1.05f;
+  };
+
+  DynamicResolution();
+  explicit DynamicResolution(const Settings &settings);
+  ~DynamicResolution();
+
+  DynamicResolution(const DynamicResolution &) = delete;
+  DynamicResolution &operator=(const DynamicResolution &) = delete;
+
+  // Bind the offscreen target for an output of width x height and set the
+  // viewport to the scaled size
+  void begin(int width, int height);
+
+  // Blit the scaled image to the default framebuffer, which stays bound
+  // with a full-size viewport
+  void resolve();
+
+  // Feed one GPU frame time measurement
+  void update(float gpuMs);
+
+  float scale() const { return m_scale; }
+  int renderWidth() const { return m_renderWidth; }
+  int renderHeight() const { return m_renderHeight; }
+  const Settings &settings() const { return m_settings; }
+
+private:
+  void allocate(int width, int height);
+
+  Settings m_settings;
+  float m_scale;
+  float m_smoothedMs = 0.0f;
+  int m_outsideBand = 0; // Consecutive measurements, + over / - under
+
+  GLuint m_fbo = 0;
+  GLuint m_color = 0;
+  GLuint m_depth = 0;
+  int m_outputWidth = 0, m_outputHeight = 0;
+  int m_renderWidth = 0, m_renderHeight = 0;
+};
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef ENTITY_STORE_H
+#define ENTITY_STORE_H
+
+#include "frustum.hpp"
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <learnopengl/transform.h>
+#include <vector>
+
+class JobSystem;
+
+typedef uint32_t EntityId;
+const EntityId kInvalidEntity = 0xFFFFFFFFu;
+
+// Structure-of-arrays storage for many render objects.
+//
+// Every attribute lives in its own dense array (positions, rotations and
+// scales split per component), so update() and cull() stream through memory
+// and process four entities per SSE register without gathering fields out
+// of objects. Entities are kept dense: destroy() moves the last entity into
+// the hole, so array positions change; EntityIds stay valid.
+//
+// Array positions ("indices") are what cull() returns and what the dense
+// getters take, so a draw list can be built without going through ids.
+class EntityStore {
+public:
+  // `boundsCenter` / `boundsRadius`: bounding sphere in mesh space
+  EntityId create(uint32_t mesh, uint32_t material,
+                  const glm::vec3 &boundsCenter, float boundsRadius);
+  void destroy(EntityId entity);
+
+  void setPosition(EntityId entity, const glm::vec3 &position);
+  void setRotation(EntityId entity, const glm::vec3 &eulerDegrees);
+  void setRotation(EntityId entity, const glm::quat &rotation);
+  void setScale(EntityId entity, const glm::vec3 &scale);
+
+  // Recompute world matrices and world bounding spheres (skipped when no
+  // entity changed since the last call). Large stores are split into
+  // chunks over `jobs` when given.
+  void update(JobSystem *jobs = nullptr);
+
+  // Append the indices of the entities whose world sphere touches the
+  // frustum, in index order; returns how many were appended
+  size_t cull(const Frustum &frustum, std::vector<uint32_t> &visible,
+              JobSystem *jobs = nullptr) const;
+
+  size_t size() const { return m_ids.size(); }
+  uint32_t indexOf(EntityId entity) const { return m_index[entity]; }
+
+  // --- Dense access by index ---
+  EntityId entityAt(uint32_t index) const { return m_ids[index]; }
+  uint32_t mesh(uint32_t index) const { return m_mesh[index]; }
+  uint32_t material(uint32_t index) const { return m_material[index]; }
+  const glm::mat4 &worldMatrix(uint32_t index) const {
+    return m_world[index];
+  }
+  glm::vec4 worldSphere(uint32_t index) const {
+    return glm::vec4(m_sphereX[index], m_sphereY[index], m_sphereZ[index],
+                     m_sphereR[index]);
+  }
+
+private:
+  void updateSpan(uint32_t begin, uint32_t end);
+  void updateScalar(uint32_t index);
+#ifdef TRANSFORM_USE_SSE
+  void update4(uint32_t index);
+#endif
+  void cullSpan(const Frustum &frustum, uint32_t begin, uint32_t end,
+                std::vector<uint32_t> &visible) const;
+
+  // Local transform
+  std::vector<float> m_posX, m_posY, m_posZ;
+  std::vector<float> m_rotX, m_rotY, m_rotZ, m_rotW; // Quaternion
+  std::vector<float> m_scaleX, m_scaleY, m_scaleZ;
+
+  // Mesh-space bounding sphere
+  std::vector<float> m_localX, m_localY, m_localZ, m_localR;
+
+  // Outputs of update()
+  std::vector<glm::mat4> m_world;
+  std::vector<float> m_sphereX, m_sphereY, m_sphereZ, m_sphereR;
+
+  // Render handles
+  std::vector<uint32_t> m_mesh, m_material;
+
+  std::vector<EntityId> m_ids;   // Index -> EntityId
+  std::vector<uint32_t> m_index; // EntityId -> index (~0u once destroyed)
+  std::vector<EntityId> m_freeIds;
+  bool m_dirty = false;
+};
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef FRAME_HANDOFF_H
+#define FRAME_HANDOFF_H
+
+#include <atomic>
+#include <cstdint>
+
+// Lock-free single-producer / single-consumer handoff of frame data.
+//
+// Three slots: the producer fills its write slot and publishes it, the
+// consumer reads its read slot, and the third slot is the one in flight
+// between them. publish() and acquire() each swap their own slot with the
+// in-flight one in a single atomic exchange, so neither side ever waits on
+// the other and a slot is never written while it is being read. If the
+// producer publishes twice before the consumer looks, the older frame is
+// replaced (the consumer always gets the newest one).
+//
+// Slots keep their contents between frames, so vectors inside T reuse
+// their capacity instead of reallocating every frame.
+template <typename T> class FrameHandoff {
+public:
+  // --- Producer ---
+  T &writeSlot() { return m_slots[m_write]; }
+  void publish() {
+    uint8_t previous = m_middle.exchange((uint8_t)(m_write | kFresh),
+                                         std::memory_order_acq_rel);
+    m_write = previous & kIndexMask;
+  }
+
+  // --- Consumer ---
+  // Take the newest published slot; false if nothing new since last time
+  bool acquire() {
+    if (!(m_middle.load(std::memory_order_relaxed) & kFresh))
+      return false;
+    uint8_t previous = m_middle.exchange(m_read, std::memory_order_acq_rel);
+    m_read = previous & kIndexMask;
+    return true;
+  }
+  const T &readSlot() const { return m_slots[m_read]; }
+
+private:
+  static const uint8_t kIndexMask = 0x3;
+  static const uint8_t kFresh = 0x4; // Middle slot not yet acquired
+
+  T m_slots[3];
+  uint8_t m_write = 0; // Producer only
+  uint8_t m_read = 1;  // Consumer only
+  std::atomic<uint8_t> m_middle{2};
+};
+
+#endif
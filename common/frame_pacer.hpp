@@ -0,0 +1,78 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <glad/glad.h>
+#include <cstdint>
+#include <deque>
+
+// How finished frames are presented
+enum PresentMode {
+  PRESENT_VSYNC,    // Swap interval 1
+  PRESENT_ADAPTIVE, // Interval -1: vsync, but late frames tear instead of
+                    // waiting a whole refresh (falls back to VSYNC)
+  PRESENT_UNCAPPED, // Interval 0, as fast as possible
+  PRESENT_LIMITED,  // Interval 0 plus a CPU limiter at the FPS cap
+  PRESENT_MODE_COUNT
+};
+
+const char *presentModeName(PresentMode mode);
+
+// Presentation control for the render thread: swap interval, an optional
+// FPS limiter, and an estimate of input-to-photon latency.
+//
+// The limiter sleeps until shortly before the frame's deadline and spins
+// the rest of the way, since OS sleeps overshoot by up to a millisecond or
+// more. Deadlines advance by exactly one period, so an occasional late
+// frame does not shift the cadence.
+//
+// Latency is measured from the moment input was sampled to the moment a
+// fence placed right after the swap signals, i.e. when the GPU has finished
+// the frame. The display still has to scan it out, so this is a lower bound
+// of the real latency.
+//
+// All methods must be called on the thread that owns the GL context.
+class FramePacer {
+public:
+  FramePacer() = default;
+  ~FramePacer();
+
+  FramePacer(const FramePacer &) = delete;
+  FramePacer &operator=(const FramePacer &) = delete;
+
+  // Change the swap interval / limiter (cheap when nothing changed)
+  void configure(PresentMode mode, float fpsCap);
+
+  // Block until the next limiter deadline; no-op unless PRESENT_LIMITED
+  void waitForNextFrame();
+
+  // Call right after glfwSwapBuffers. inputNs: Profiler::nowNs() taken when
+  // the frame's input was sampled. Fences the frame and, with waitForGpu,
+  // blocks until the GPU has finished it (low-latency mode).
+  void frameSubmitted(uint64_t inputNs, bool waitForGpu);
+
+  // Record the latency of every frame whose fence has signaled. Done by
+  // frameSubmitted(); calling it early in the frame as well makes samples
+  // more precise, since a fence is only noticed when it is polled.
+  void pollFences();
+
+  // Smoothed input-to-GPU-done latency in milliseconds (0 until measured)
+  float latencyMs() const { return m_latencyMs; }
+
+private:
+  struct PendingFrame {
+    GLsync fence;
+    uint64_t inputNs;
+  };
+  // Frames tracked at once; older fences are dropped unmeasured
+  static const size_t kMaxPending = 8;
+
+  PresentMode m_mode = PRESENT_MODE_COUNT; // Nothing applied yet
+  float m_fpsCap = 0.0f;
+  uint64_t m_periodNs = 0;
+  uint64_t m_deadlineNs = 0;
+
+  std::deque<PendingFrame> m_pending;
+  float m_latencyMs = 0.0f;
+};
+
+#endif
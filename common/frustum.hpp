@@ -0,0 +1,43 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+// View frustum as six planes (left, right, bottom, top, near, far).
+// xyz is the normal pointing into the frustum, w the distance term, so a
+// point p is inside a plane when dot(xyz, p) + w >= 0.
+struct Frustum {
+  glm::vec4 planes[6];
+};
+
+// Planes of a projection * view matrix (Gribb / Hartmann), normalized so
+// plane distances are in world units
+inline Frustum extractFrustum(const glm::mat4 &viewProj) {
+  // glm is column-major: row r is (m[0][r], m[1][r], m[2][r], m[3][r])
+  glm::vec4 row[4];
+  for (int r = 0; r < 4; ++r)
+    row[r] = glm::vec4(viewProj[0][r], viewProj[1][r], viewProj[2][r],
+                       viewProj[3][r]);
+
+  Frustum frustum;
+  frustum.planes[0] = row[3] + row[0];
+  frustum.planes[1] = row[3] - row[0];
+  frustum.planes[2] = row[3] + row[1];
+  frustum.planes[3] = row[3] - row[1];
+  frustum.planes[4] = row[3] + row[2];
+  frustum.planes[5] = row[3] - row[2];
+  for (glm::vec4 &plane : frustum.planes)
+    plane /= glm::length(glm::vec3(plane));
+  return frustum;
+}
+
+// Conservative sphere test (may keep spheres just outside a corner)
+inline bool sphereInFrustum(const Frustum &frustum, const glm::vec3 &center,
+                            float radius) {
+  for (const glm::vec4 &plane : frustum.planes)
+    if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+      return false;
+  return true;
+}
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef GBUFFER_H
+#define GBUFFER_H
+
+#include "objloader.hpp"
+#include <glad/glad.h>
+#include <vector>
+
+// Geometry buffer of the deferred path: what gbuffer.frag writes per pixel
+// and deferred.frag lights in one full-screen pass.
+//
+//   attachment 0  GL_RG16F      view-space normal, octahedral encoded
+//   attachment 1  GL_R8UI       material index (into setMaterials())
+//   depth         GL_DEPTH_COMPONENT24, view position is rebuilt from it
+//
+// 8 bytes per pixel in all. Materials live in a texture buffer (three
+// texels each: Ka, Kd, Ks with the shininess in w), so the G-buffer never
+// stores colors. The storage only grows: a smaller frame (e.g. with
+// dynamic resolution) uses its lower-left corner.
+class GBuffer {
+public:
+  // Texture units the lighting pass reads, past the clustered lights
+  static const GLint kNormalUnit = 7;
+  static const GLint kMaterialUnit = 8;
+  static const GLint kDepthUnit = 9;
+  static const GLint kMaterialTableUnit = 10;
+  static const int kBytesPerPixel = 8;
+  static const size_t kMaxMaterials = 256; // GL_R8UI indices
+
+  GBuffer();
+  ~GBuffer();
+
+  GBuffer(const GBuffer &) = delete;
+  GBuffer &operator=(const GBuffer &) = delete;
+
+  void setMaterials(const std::vector<Material> &materials);
+
+  // Remember the bound draw framebuffer, then bind and clear the G-buffer
+  // with a width x height viewport
+  void begin(int width, int height);
+
+  // Back to the framebuffer bound at begin() (same viewport) with the
+  // G-buffer textures on their units
+  void end();
+
+  // Full-screen triangle for the lighting program, which must be bound.
+  // Leaves its own VAO bound.
+  void drawLighting();
+
+  // Point a lighting program's samplers at the units above. Call once
+  // after linking.
+  static void setupProgram(GLuint program);
+
+  int width() const { return m_width; }
+  int height() const { return m_height; }
+
+private:
+  void allocate(int width, int height);
+
+  GLuint m_fbo = 0;
+  GLuint m_normal = 0, m_material = 0, m_depth = 0;
+  GLuint m_materialBuffer = 0, m_materialTexture = 0;
+  GLuint m_emptyVao = 0; // Core profile draws need a VAO
+  GLint m_previousFbo = 0;
+  int m_storageWidth = 0, m_storageHeight = 0;
+  int m_width = 0, m_height = 0;
+};
+
+#endif
@@ -0,0 +1,115 @@
+#ifndef GEOMETRY_ARENA_H
+#define GEOMETRY_ARENA_H
+
+#include "Mesh.hpp"
+#include "objloader.hpp"
+#include "stream_buffer.hpp"
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+// Layout expected by glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand {
+  GLuint count;
+  GLuint instanceCount;
+  GLuint firstIndex;
+  GLint baseVertex;
+  GLuint baseInstance;
+};
+
+// FrameData uniform block of arena.vert / arena.frag (std140)
+struct ArenaFrameUniforms {
+  glm::mat4 view;
+  glm::mat4 projection;
+  glm::vec4 lightPosition; // Eye coords
+  glm::vec4 la, ld, ls;    // Light intensities (w unused)
+  int32_t blinn = 0;
+  int32_t drawDataBase = 0; // Filled in by submit()
+  int32_t pad[2] = {0, 0};
+};
+
+// Where one mesh lives inside the arena buffers
+struct ArenaMesh {
+  GLuint firstIndex = 0;
+  GLuint indexCount = 0;
+  GLint baseVertex = 0;
+  GLuint vertexCount = 0;
+};
+
+// Shared geometry buffers for many meshes.
+//
+// Vertices and indices of every mesh are suballocated from one VBO and one
+// EBO behind a single VAO, so drawing N meshes needs no VAO switches. Each
+// frame the draws are turned into indirect commands on the CPU and issued
+// with one glMultiDrawElementsIndirect (GL 4.3+). On older contexts the
+// commands are issued with glMultiDrawElementsBaseVertex, one call per run
+// of consecutive draws sharing an instance.
+//
+// An instance is a model matrix + material. Its data is read in arena.vert
+// from a texture buffer, indexed by the DrawIndex attribute: baseInstance on
+// the indirect path, a constant generic attribute on the fallback path.
+// Instance data, frame uniforms and indirect commands are written into a
+// StreamBuffer every frame.
+class GeometryArena {
+public:
+  // Attribute location of the per-draw index in arena.vert
+  static const GLuint kDrawIndexAttrib = 7;
+
+  GeometryArena(size_t maxVertices, size_t maxIndices, size_t maxDraws);
+  ~GeometryArena();
+
+  // Copy a mesh into the arena. Empty indices draw the vertices in order.
+  // Returns a mesh handle, or -1 when the arena is full.
+  int addMesh(const std::vector<Vertex> &vertices,
+              const std::vector<unsigned int> &indices);
+
+  // Material table shared by all draws (Ka, Kd, Ks, Ns)
+  void setMaterials(const std::vector<Material> &materials);
+
+  // --- Per frame ---
+  void beginFrame();
+  // Returns an instance index, or -1 when maxDraws instances exist already
+  int addInstance(const glm::mat4 &model, uint32_t material);
+  // Draw a mesh with an instance's transform and material. Several meshes
+  // (e.g. the parts of one model) may share an instance.
+  void addDraw(int mesh, int instance);
+  // Write instance data, frame uniforms and commands into `stream`, then
+  // draw everything. The arena program must be bound.
+  void submit(StreamBuffer &stream, const ArenaFrameUniforms &frame);
+
+  // Point the samplers and the FrameData block of an arena program at the
+  // units / binding used by submit(). Call once after linking.
+  static void setupProgram(GLuint program);
+
+  bool usesIndirect() const { return m_indirect; }
+  size_t meshCount() const { return m_meshes.size(); }
+  size_t drawCount() const { return m_commands.size(); }
+  const ArenaMesh &mesh(int handle) const { return m_meshes[handle]; }
+  // Texture units and uniform binding used by submit()
+  static const GLint kDrawDataUnit = 0;
+  static const GLint kMaterialUnit = 1;
+  static const GLuint kFrameDataBinding = 0;
+
+private:
+  size_t m_maxVertices, m_maxIndices, m_maxDraws;
+  size_t m_usedVertices = 0, m_usedIndices = 0;
+  bool m_indirect = false;
+  size_t m_uniformAlignment = 256;
+
+  GLuint m_vao = 0, m_vbo = 0, m_ebo = 0;
+  GLuint m_drawIndexBuffer = 0; // 0..maxDraws-1, read with divisor 1
+  GLuint m_drawDataTexture = 0;
+  GLuint m_drawDataSource = 0; // Buffer attached to m_drawDataTexture
+  GLuint m_materialBuffer = 0, m_materialTexture = 0;
+
+  std::vector<ArenaMesh> m_meshes;
+  std::vector<DrawElementsIndirectCommand> m_commands;
+  std::vector<glm::vec4> m_drawData; // 8 texels per instance
+
+  // Scratch arrays for the glMultiDrawElementsBaseVertex fallback
+  std::vector<GLsizei> m_counts;
+  std::vector<const void *> m_offsets;
+  std::vector<GLint> m_baseVertices;
+};
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include <glad/glad.h>
+#include <cstdint>
+
+// GPU time of a span of commands, measured with GL_TIME_ELAPSED queries.
+//
+// Results arrive a few frames late, so a small ring of queries is used and
+// only results that are already available are read: measuring never makes
+// the CPU wait for the GPU. Spans may not nest (one TIME_ELAPSED query can
+// be active at a time).
+class GpuTimer {
+public:
+  GpuTimer();
+  ~GpuTimer();
+
+  GpuTimer(const GpuTimer &) = delete;
+  GpuTimer &operator=(const GpuTimer &) = delete;
+
+  // Bracket the commands to measure (once per frame)
+  void begin();
+  void end();
+
+  // Latest finished measurement in milliseconds (0 until the first one)
+  float lastMs() const { return m_lastMs; }
+  // Measurements finished so far; changes when lastMs() is new
+  uint64_t resultCount() const { return m_results; }
+
+private:
+  static const int kQueries = 4;
+
+  void collect();
+
+  GLuint m_queries[kQueries] = {};
+  bool m_pending[kQueries] = {};
+  int m_next = 0; // Oldest query, reused by the next begin()
+  float m_lastMs = 0.0f;
+  uint64_t m_results = 0;
+};
+
+#endif
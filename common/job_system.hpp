@@ -0,0 +1,124 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+typedef std::function<void()> JobFn;
+
+// Test-and-set lock for the very short critical sections of the job queues
+class SpinLock {
+public:
+  void lock() {
+    for (int spins = 0; m_flag.test_and_set(std::memory_order_acquire);
+         ++spins)
+      if (spins > 64)
+        std::this_thread::yield();
+  }
+  void unlock() { m_flag.clear(std::memory_order_release); }
+
+private:
+  std::atomic_flag m_flag = ATOMIC_FLAG_INIT;
+};
+
+class JobCounter;
+
+struct Job {
+  JobFn fn;
+  JobCounter *signal = nullptr; // Decremented when fn returns
+};
+
+// Dependency counter. Every job started with this counter as `signal`
+// holds it above zero until it finishes; jobs started with it as `after`
+// are held back until it drops to zero.
+class JobCounter {
+public:
+  JobCounter() = default;
+  JobCounter(const JobCounter &) = delete;
+  JobCounter &operator=(const JobCounter &) = delete;
+
+  bool done() const { return m_pending.load(std::memory_order_acquire) == 0; }
+
+private:
+  friend class JobSystem;
+  std::atomic<int> m_pending{0};
+  SpinLock m_lock;
+  std::vector<Job> m_continuations;
+};
+
+// Work-stealing job scheduler.
+//
+// Each thread owns a deque: it pushes and pops its own jobs at the back
+// (newest first, still warm in cache) while idle threads steal from the
+// front of other deques (oldest first, usually the biggest pieces of work).
+// The thread that creates the JobSystem is thread 0 and runs jobs while it
+// waits; the other threads sleep when there is nothing to run or steal.
+//
+// Jobs may start other jobs and wait on counters. A waiting thread keeps
+// running jobs instead of blocking, so nested waits cannot deadlock.
+class JobSystem {
+public:
+  // 0 workers = one per hardware thread, minus the creating thread
+  explicit JobSystem(unsigned workers = 0);
+  // Jobs still queued are dropped
+  ~JobSystem();
+
+  JobSystem(const JobSystem &) = delete;
+  JobSystem &operator=(const JobSystem &) = delete;
+
+  // Worker threads + the creating thread
+  unsigned threadCount() const { return (unsigned)m_queues.size(); }
+
+  // Queue fn. `signal` (optional) stays non-zero until fn has returned;
+  // `after` (optional) delays fn until that counter reaches zero.
+  void run(JobFn fn, JobCounter *signal = nullptr,
+           JobCounter *after = nullptr);
+
+  // Run jobs until `counter` reaches zero
+  void wait(JobCounter &counter);
+
+  // Call fn(begin, end) over [0, count) in chunks of `grain` items and
+  // return when all chunks are done
+  void parallelFor(size_t count, size_t grain,
+                   const std::function<void(size_t, size_t)> &fn);
+
+  // Jobs taken from another thread's deque since construction
+  uint64_t stealCount() const {
+    return m_steals.load(std::memory_order_relaxed);
+  }
+
+private:
+  struct alignas(64) Queue {
+    SpinLock lock;
+    std::deque<Job> jobs;
+  };
+
+  void push(Job &&job);
+  bool tryPop(unsigned self, Job &out);
+  void execute(Job &job);
+  void finish(JobCounter *counter);
+  void workerMain(unsigned index);
+  unsigned currentQueue() const;
+
+  std::vector<std::unique_ptr<Queue>> m_queues;
+  std::vector<std::thread> m_threads;
+
+  std::atomic<int> m_queued{0}; // Jobs sitting in any deque
+  std::atomic<uint64_t> m_steals{0};
+  std::atomic<bool> m_shutdown{false};
+
+  // Idle workers sleep here
+  std::mutex m_sleepMutex;
+  std::condition_variable m_wake;
+  std::atomic<int> m_sleepers{0};
+};
+
+#endif
@@ -3,6 +3,15 @@
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <cmath>
+#include <cstddef>
+
+#if defined(__SSE__) || defined(_M_X64) ||                                    \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define TRANSFORM_USE_SSE 1
+#endif
 
 class Transform {
 protected:
@@ -11,43 +20,186 @@ protected:
   glm::vec3 m_eulerRot = {0.0f, 0.0f, 0.0f}; // In degrees
   glm::vec3 m_scale = {1.0f, 1.0f, 1.0f};
 
+  // m_eulerRot as a quaternion (Y * X * Z order), updated by the setters
+  glm::quat m_rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+
   // Global space information concatenate in matrix
   glm::mat4 m_modelMatrix = glm::mat4(1.0f);
 
   // Dirty flag
   bool m_isDirty = true;
 
+public:
+  // Quaternion of the rotation Y * X * Z, written out from the products of
+  // the three half-angle axis rotations
+  static glm::quat eulerToQuat(const glm::vec3 &eulerDegrees) {
+    const glm::vec3 half = glm::radians(eulerDegrees) * 0.5f;
+    const float sx = std::sin(half.x), cx = std::cos(half.x);
+    const float sy = std::sin(half.y), cy = std::cos(half.y);
+    const float sz = std::sin(half.z), cz = std::cos(half.z);
+    glm::quat q;
+    q.w = cx * cy * cz + sx * sy * sz;
+    q.x = cy * sx * cz + cx * sy * sz;
+    q.y = cx * sy * cz - cy * sx * sz;
+    q.z = cx * cy * sz - sx * sy * cz;
+    return q;
+  }
+
+  // translation * rotation * scale (also know as TRS matrix), built in one
+  // step from the quaternion instead of multiplying five 4x4 matrices
+  static void composeTRS(const glm::vec3 &pos, const glm::quat &q,
+                         const glm::vec3 &scale, glm::mat4 &out) {
+    const float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+    const float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+    const float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+
+    out[0][0] = (1.0f - 2.0f * (yy + zz)) * scale.x;
+    out[0][1] = 2.0f * (xy + wz) * scale.x;
+    out[0][2] = 2.0f * (xz - wy) * scale.x;
+    out[0][3] = 0.0f;
+    out[1][0] = 2.0f * (xy - wz) * scale.y;
+    out[1][1] = (1.0f - 2.0f * (xx + zz)) * scale.y;
+    out[1][2] = 2.0f * (yz + wx) * scale.y;
+    out[1][3] = 0.0f;
+    out[2][0] = 2.0f * (xz + wy) * scale.z;
+    out[2][1] = 2.0f * (yz - wx) * scale.z;
+    out[2][2] = (1.0f - 2.0f * (xx + yy)) * scale.z;
+    out[2][3] = 0.0f;
+    out[3][0] = pos.x;
+    out[3][1] = pos.y;
+    out[3][2] = pos.z;
+    out[3][3] = 1.0f;
+  }
+
+#ifdef TRANSFORM_USE_SSE
+  // composeTRS for four transforms at once, one per SSE lane (structure of
+  // arrays inside the registers). Split in two so callers can use the 3x3
+  // part while it is still one component per register: afterwards
+  // m[3 * C + R] holds column C, row R of every lane.
+  static void composeRotationScale4(__m128 qx, __m128 qy, __m128 qz,
+                                    __m128 qw, __m128 sx, __m128 sy,
+                                    __m128 sz, __m128 m[9]) {
+    const __m128 one = _mm_set1_ps(1.0f), two = _mm_set1_ps(2.0f);
+    const __m128 x2 = _mm_mul_ps(qx, two), y2 = _mm_mul_ps(qy, two),
+                 z2 = _mm_mul_ps(qz, two);
+    const __m128 xx = _mm_mul_ps(qx, x2), yy = _mm_mul_ps(qy, y2),
+                 zz = _mm_mul_ps(qz, z2);
+    const __m128 xy = _mm_mul_ps(qx, y2), xz = _mm_mul_ps(qx, z2),
+                 yz = _mm_mul_ps(qy, z2);
+    const __m128 wx = _mm_mul_ps(qw, x2), wy = _mm_mul_ps(qw, y2),
+                 wz = _mm_mul_ps(qw, z2);
+
+    m[0] = _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(yy, zz)), sx);
+    m[1] = _mm_mul_ps(_mm_add_ps(xy, wz), sx);
+    m[2] = _mm_mul_ps(_mm_sub_ps(xz, wy), sx);
+    m[3] = _mm_mul_ps(_mm_sub_ps(xy, wz), sy);
+    m[4] = _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, zz)), sy);
+    m[5] = _mm_mul_ps(_mm_add_ps(yz, wx), sy);
+    m[6] = _mm_mul_ps(_mm_add_ps(xz, wy), sz);
+    m[7] = _mm_mul_ps(_mm_sub_ps(yz, wx), sz);
+    m[8] = _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, yy)), sz);
+  }
+
+  // Second half: the 3x3 part and the translations transposed back into
+  // four column-major matrices
+  static void storeTRS4(const __m128 m[9], __m128 px, __m128 py, __m128 pz,
+                        glm::mat4 *const out[4]) {
+    __m128 m00 = m[0], m01 = m[1], m02 = m[2];
+    __m128 m10 = m[3], m11 = m[4], m12 = m[5];
+    __m128 m20 = m[6], m21 = m[7], m22 = m[8];
+    __m128 zero0 = _mm_setzero_ps(), zero1 = zero0, zero2 = zero0;
+    __m128 w = _mm_set1_ps(1.0f);
+
+    // Each transpose turns "one component for 4 transforms" into "one
+    // column for each transform": afterwards the n-th register of a group
+    // is that column of transform n
+    _MM_TRANSPOSE4_PS(m00, m01, m02, zero0);
+    _MM_TRANSPOSE4_PS(m10, m11, m12, zero1);
+    _MM_TRANSPOSE4_PS(m20, m21, m22, zero2);
+    _MM_TRANSPOSE4_PS(px, py, pz, w);
+
+    const __m128 col0[4] = {m00, m01, m02, zero0};
+    const __m128 col1[4] = {m10, m11, m12, zero1};
+    const __m128 col2[4] = {m20, m21, m22, zero2};
+    const __m128 col3[4] = {px, py, pz, w};
+    for (int n = 0; n < 4; ++n) {
+      glm::mat4 &matrix = *out[n];
+      _mm_storeu_ps(&matrix[0][0], col0[n]);
+      _mm_storeu_ps(&matrix[1][0], col1[n]);
+      _mm_storeu_ps(&matrix[2][0], col2[n]);
+      _mm_storeu_ps(&matrix[3][0], col3[n]);
+    }
+  }
+#endif
+
 protected:
-  glm::mat4 getLocalModelMatrix() {
-    const glm::mat4 transformX =
-        glm::rotate(glm::mat4(1.0f), glm::radians(m_eulerRot.x),
-                    glm::vec3(1.0f, 0.0f, 0.0f));
-    const glm::mat4 transformY =
-        glm::rotate(glm::mat4(1.0f), glm::radians(m_eulerRot.y),
-                    glm::vec3(0.0f, 1.0f, 0.0f));
-    const glm::mat4 transformZ =
-        glm::rotate(glm::mat4(1.0f), glm::radians(m_eulerRot.z),
-                    glm::vec3(0.0f, 0.0f, 1.0f));
-
-    // Y * X * Z
-    const glm::mat4 rotationMatrix = transformY * transformX * transformZ;
-
-    // translation * rotation * scale (also know as TRS matrix)
-    return glm::translate(glm::mat4(1.0f), m_pos) * rotationMatrix *
-           glm::scale(glm::mat4(1.0f), m_scale);
+  glm::mat4 getLocalModelMatrix() const {
+    glm::mat4 local;
+    composeTRS(m_pos, m_rotation, m_scale, local);
+    return local;
   }
 
+#ifdef TRANSFORM_USE_SSE
+  // Four transforms at once, one per SSE lane
+  static void composeTRS4(Transform *const t[4]) {
+#define TRANSFORM_LANES(expr)                                                  \
+  _mm_setr_ps(t[0]->expr, t[1]->expr, t[2]->expr, t[3]->expr)
+    __m128 m[9];
+    composeRotationScale4(
+        TRANSFORM_LANES(m_rotation.x), TRANSFORM_LANES(m_rotation.y),
+        TRANSFORM_LANES(m_rotation.z), TRANSFORM_LANES(m_rotation.w),
+        TRANSFORM_LANES(m_scale.x), TRANSFORM_LANES(m_scale.y),
+        TRANSFORM_LANES(m_scale.z), m);
+    glm::mat4 *const out[4] = {&t[0]->m_modelMatrix, &t[1]->m_modelMatrix,
+                               &t[2]->m_modelMatrix, &t[3]->m_modelMatrix};
+    storeTRS4(m, TRANSFORM_LANES(m_pos.x), TRANSFORM_LANES(m_pos.y),
+              TRANSFORM_LANES(m_pos.z), out);
+#undef TRANSFORM_LANES
+    for (int n = 0; n < 4; ++n)
+      t[n]->m_isDirty = false;
+  }
+#endif
+
 public:
+  // Recomputes the model matrix only if a setter changed the transform
   void computeModelMatrix() {
-    m_modelMatrix = getLocalModelMatrix();
+    if (!m_isDirty)
+      return;
+    composeTRS(m_pos, m_rotation, m_scale, m_modelMatrix);
     m_isDirty = false;
   }
 
+  // Always recomputes: the parent matrix may have changed even when this
+  // transform did not
   void computeModelMatrix(const glm::mat4 &parentGlobalModelMatrix) {
     m_modelMatrix = parentGlobalModelMatrix * getLocalModelMatrix();
     m_isDirty = false;
   }
 
+  // Batch update of a contiguous array: clean transforms are skipped and the
+  // dirty ones are composed four at a time with SSE (scalar elsewhere)
+  static void computeModelMatrices(Transform *transforms, size_t count) {
+    size_t i = 0;
+#ifdef TRANSFORM_USE_SSE
+    Transform *lanes[4];
+    int filled = 0;
+    for (; i < count; ++i) {
+      if (!transforms[i].m_isDirty)
+        continue;
+      lanes[filled++] = &transforms[i];
+      if (filled == 4) {
+        composeTRS4(lanes);
+        filled = 0;
+      }
+    }
+    for (int l = 0; l < filled; ++l)
+      lanes[l]->computeModelMatrix();
+#else
+    for (; i < count; ++i)
+      transforms[i].computeModelMatrix();
+#endif
+  }
+
   void setLocalPosition(const glm::vec3 &newPosition) {
     m_pos = newPosition;
     m_isDirty = true;
@@ -55,6 +207,7 @@ public:
 
   void setLocalRotation(const glm::vec3 &newRotation) {
     m_eulerRot = newRotation;
+    m_rotation = eulerToQuat(newRotation);
     m_isDirty = true;
   }
 
@@ -69,6 +222,8 @@ public:
 
   const glm::vec3 &getLocalRotation() const { return m_eulerRot; }
 
+  const glm::quat &getLocalRotationQuat() const { return m_rotation; }
+
   const glm::vec3 &getLocalScale() const { return m_scale; }
 
   const glm::mat4 &getModelMatrix() const { return m_modelMatrix; }
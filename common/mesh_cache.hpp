@@ -0,0 +1,23 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include "Mesh.hpp"
+#include <string>
+#include <vector>
+
+// Binary copy of a mesh loaded from a model file: the Vertex array and the
+// indices exactly as Mesh uploads them, so reading it back is one read per
+// array with no parsing. Stamped with the model's size and modification
+// time and with sizeof(Vertex); a stale or damaged cache reads as missing.
+
+// Cache file of a model (next to it)
+std::string meshCachePath(const std::string &modelPath);
+
+bool writeMeshCache(const std::string &modelPath,
+                    const std::vector<Vertex> &vertices,
+                    const std::vector<unsigned int> &indices);
+
+bool readMeshCache(const std::string &modelPath, std::vector<Vertex> &vertices,
+                   std::vector<unsigned int> &indices);
+
+#endif
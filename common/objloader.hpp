@@ -1,3 +1,6 @@
+#ifndef OBJLOADER_H
+#define OBJLOADER_H
+
 #include <vector>
 #include <string>
 #include <fstream>
@@ -12,6 +15,7 @@ struct Material {
     glm::vec3 Ks;        // Specular color
     float Ns;            // Shininess exponent
     float d;             // Dissolve (transparency)
+    std::string map_Kd;  // Diffuse texture, relative to the .mtl ("" = none)
 };
 
 bool loadMTL(
@@ -19,14 +23,29 @@ bool loadMTL(
     std::map < std::string, Material > & out_materials
 );
 
+class JobSystem;
+
+// Com um JobSystem o ficheiro é lido em blocos paralelos
+bool loadOBJ(
+    const char * path,
+    std::vector < glm::vec3 > & out_vertices,
+    std::vector < glm::vec3 > & out_normals,
+    JobSystem * jobs = nullptr
+);
+
+// Igual, com as coordenadas de textura ("vt"); (0, 0) onde a face não as tem
 bool loadOBJ(
     const char * path,
     std::vector < glm::vec3 > & out_vertices,
-    std::vector < glm::vec3 > & out_normals
+    std::vector < glm::vec2 > & out_uvs,
+    std::vector < glm::vec3 > & out_normals,
+    JobSystem * jobs = nullptr
 );
 
 /*
 We want loadOBJ to read the file “path”, write the data in out_vertices/out_uvs/out_normals, and return false if something went wrong.
  std::vector is the C++ way to declare an array of glm::vec3 which size can be modified at will: it has nothing to do with a mathematical vector. 
 Just an array, really. And finally, the & means that function will be able to modify the std::vectors.
-*/
\ No newline at end of file
+*/
+
+#endif
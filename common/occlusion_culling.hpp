@@ -0,0 +1,89 @@
+#ifndef OCCLUSION_CULLING_H
+#define OCCLUSION_CULLING_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+// Hierarchical-Z buffer on the CPU, built from a depth image read back
+// from the GPU.
+//
+// Level 0 is the depth image shrunk to at most kBaseSize texels on its long
+// side, each texel holding the farthest depth of the pixels it covers; every
+// further level halves the size, again keeping the farthest depth. A texel
+// therefore says "nothing behind this depth is visible anywhere in my
+// area", which makes the test conservative.
+//
+// Tests use the view-projection the depth was rendered with, so results
+// are one or two frames old: when the camera moves, an object coming out
+// from behind an occluder can appear a frame late.
+class DepthPyramid {
+public:
+  static const int kBaseSize = 256;
+
+  // depth: width x height window-space depths (0 = near, 1 = far), rows
+  // bottom to top as glReadPixels returns them
+  void build(const float *depth, int width, int height,
+             const glm::mat4 &viewProj);
+
+  bool valid() const { return !m_levels.empty(); }
+  uint64_t frame() const { return m_frame; }
+  void setFrame(uint64_t frame) { m_frame = frame; }
+
+  // True when the sphere (xyz center, w radius, world space) is certainly
+  // hidden behind what was drawn
+  bool sphereOccluded(const glm::vec4 &sphere) const;
+
+private:
+  struct Level {
+    int width = 0, height = 0;
+    std::vector<float> maxDepth;
+  };
+
+  std::vector<Level> m_levels;
+  glm::mat4 m_viewProj = glm::mat4(1.0f);
+  int m_factor = 1; // Source pixels per level-0 texel, per axis
+  int m_sourceWidth = 0, m_sourceHeight = 0;
+  uint64_t m_frame = 0; // Frame whose depth this is
+};
+
+// Asynchronous depth readback for DepthPyramid.
+//
+// capture() copies the depth of the bound framebuffer into a pixel pack
+// buffer and fences it; collect() maps the oldest capture only once its
+// fence has signaled, so neither call waits for the GPU. With kSlots
+// buffers in flight a capture is normally collected two frames later.
+class DepthReadback {
+public:
+  DepthReadback();
+  ~DepthReadback();
+
+  DepthReadback(const DepthReadback &) = delete;
+  DepthReadback &operator=(const DepthReadback &) = delete;
+
+  // Queue a copy of the current read framebuffer's depth (width x height
+  // from the origin), rendered with viewProj, for snapshot `frame`
+  void capture(int width, int height, const glm::mat4 &viewProj,
+               uint64_t frame);
+
+  // Build `out` from the oldest finished capture; false if none is ready
+  bool collect(DepthPyramid &out);
+
+private:
+  static const int kSlots = 3;
+
+  struct Slot {
+    GLuint buffer = 0;
+    size_t capacity = 0;
+    GLsync fence = 0; // Non-zero while a capture is in flight
+    int width = 0, height = 0;
+    glm::mat4 viewProj = glm::mat4(1.0f);
+    uint64_t frame = 0;
+  };
+
+  Slot m_slots[kSlots];
+  int m_next = 0; // Slot of the next capture (also the oldest one)
+};
+
+#endif
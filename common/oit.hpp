@@ -0,0 +1,55 @@
+#ifndef OIT_H
+#define OIT_H
+
+#include <glad/glad.h>
+
+// Weighted blended order-independent transparency (McGuire & Bavoil).
+//
+// Transparent surfaces are drawn in any order into two targets: an RGBA16F
+// sum of premultiplied colors and alphas, each scaled by a weight that
+// falls off with depth, and an R8 product of (1 - alpha) ("revealage").
+// A full-screen pass then blends the weighted average color over the
+// scene. Nothing is sorted, on the CPU or the GPU, and the cost is two
+// extra targets plus one blit and one full-screen pass whatever the number
+// of transparent draws. The price is an approximation: the order of
+// overlapping layers with similar depth is only roughly respected.
+//
+// Transparent draws test against a copy of the opaque depth and write no
+// depth of their own.
+class WeightedBlendedOit {
+public:
+  // Texture units read by the composite pass, past the G-buffer
+  static const GLint kAccumUnit = 11;
+  static const GLint kRevealageUnit = 12;
+
+  WeightedBlendedOit();
+  ~WeightedBlendedOit();
+
+  WeightedBlendedOit(const WeightedBlendedOit &) = delete;
+  WeightedBlendedOit &operator=(const WeightedBlendedOit &) = delete;
+
+  // Copy the depth of the bound draw framebuffer's lower-left width x
+  // height (a GL_DEPTH24_STENCIL8 target, as both scene targets are), then
+  // bind and clear the accumulation targets with their blending set up
+  void begin(int width, int height);
+
+  // Blend the result over the framebuffer bound at begin() with the
+  // composite program, then restore blending off and depth writes on.
+  // Leaves the composite program and its own VAO bound.
+  void resolve(GLuint compositeProgram);
+
+  // Point a composite program's samplers at the units above. Call once
+  // after linking.
+  static void setupProgram(GLuint program);
+
+private:
+  void allocate(int width, int height);
+
+  GLuint m_fbo = 0;
+  GLuint m_accum = 0, m_revealage = 0, m_depth = 0;
+  GLuint m_emptyVao = 0;
+  GLint m_previousFbo = 0;
+  int m_storageWidth = 0, m_storageHeight = 0;
+};
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Render passes, in submission order (the top bits of the sort key)
+enum RenderPass : uint32_t {
+  PASS_DEPTH_PREPASS = 0, // Depth-only draws of the opaque geometry
+  PASS_OPAQUE = 1,
+  PASS_UNLIT = 2,
+  PASS_TRANSPARENT = 3,
+  PASS_OVERLAY = 4,
+};
+
+// Everything needed to issue one draw
+struct DrawData {
+  GLuint program = 0;
+  GLuint vao = 0;
+  uint32_t material = 0; // Index into the caller's material table
+  GLsizei count = 0;     // Index count (indexed) or vertex count
+  GLint first = 0;       // First vertex for non-indexed draws
+  bool indexed = false;  // GL_UNSIGNED_INT indices at offset 0
+  glm::mat4 model = glm::mat4(1.0f);
+};
+
+// Compact packet that is actually sorted: 64-bit key + index of its DrawData
+struct DrawPacket {
+  uint64_t key;
+  uint32_t draw;
+};
+
+// Collects draws for a frame, radix-sorts them by state and submits them
+// with redundant program / material / VAO binds filtered out.
+//
+// Key layout, most significant bits first:
+//   63..60 pass   59..48 program   47..36 material   35..24 VAO   23..0 depth
+// Program, material and VAO are truncated to 12 bits. A collision only makes
+// two states share a sort bucket; binds always compare the real values.
+class RenderQueue {
+public:
+  // Called by execute() when the bound state changes
+  struct Hooks {
+    // First draw of each pass, before its program is bound. It may bind
+    // programs and VAOs of its own (a full-screen pass between two
+    // passes): execute() forgets its bound state afterwards and binds the
+    // next draw's program, material and VAO again.
+    std::function<void(uint32_t pass)> onPass;
+    std::function<void(GLuint program)> onProgram;
+    std::function<void(GLuint program, uint32_t material)> onMaterial;
+    std::function<void(GLuint program, const DrawData &draw)> onDraw;
+  };
+
+  static uint64_t makeKey(uint32_t pass, GLuint program, uint32_t material,
+                          GLuint vao, float depth01);
+
+  void clear() {
+    m_packets.clear();
+    m_draws.clear();
+  }
+
+  // depth01 is the normalized view depth (0 = near, 1 = far). Opaque passes
+  // sort front to back, PASS_TRANSPARENT back to front.
+  void submit(uint32_t pass, const DrawData &draw, float depth01);
+
+  // LSD radix sort on the 64-bit keys (stable, 8 bits per pass, passes whose
+  // digit is identical for every packet are skipped)
+  void sort();
+
+  void execute(const Hooks &hooks) const;
+
+  size_t size() const { return m_packets.size(); }
+  const std::vector<DrawPacket> &packets() const { return m_packets; }
+  const DrawData &draw(const DrawPacket &packet) const {
+    return m_draws[packet.draw];
+  }
+
+private:
+  std::vector<DrawPacket> m_packets;
+  std::vector<DrawPacket> m_scratch;
+  std::vector<DrawData> m_draws;
+};
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef RENDER_STATS_H
+#define RENDER_STATS_H
+
+#include <glad/glad.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Per-frame render statistics.
+//
+// The counted* wrappers below forward to the GL call and bump the counters of
+// the frame being recorded. Counters are plain integers: every GL call is
+// made from the thread that owns the context, so no atomics are needed.
+struct RenderStats {
+  uint32_t drawCalls = 0;
+  uint64_t triangles = 0;
+  uint64_t vertices = 0;
+  uint32_t programBinds = 0;
+  uint32_t vaoBinds = 0;
+  uint32_t uniformUploads = 0;
+  uint64_t bufferBytesUploaded = 0;
+  uint32_t streamStalls = 0; // StreamBuffer waits on a GPU fence
+  uint32_t objectsVisible = 0; // Passed frustum culling
+  uint32_t objectsCulled = 0;   // Outside the frustum
+  uint32_t objectsOccluded = 0; // In the frustum, hidden by the depth pyramid
+};
+
+// Counters of the frame currently being recorded
+RenderStats &renderStats();
+
+// Counters of the last completed frame (what tests and the overlay read)
+const RenderStats &lastFrameStats();
+
+// Close the current frame: its counters become lastFrameStats() and the
+// current counters are reset
+void endFrameStats();
+
+// Human-readable lines for the overlay / console
+std::vector<std::string> formatRenderStats(const RenderStats &stats);
+
+// --- Counted GL wrappers ---
+
+inline void countDraw(GLenum mode, GLsizei count, GLsizei instances = 1) {
+  RenderStats &stats = renderStats();
+  stats.drawCalls++;
+  stats.vertices += (uint64_t)count * instances;
+  if (mode == GL_TRIANGLES)
+    stats.triangles += (uint64_t)(count / 3) * instances;
+}
+
+inline void countedDrawArrays(GLenum mode, GLint first, GLsizei count) {
+  countDraw(mode, count);
+  glDrawArrays(mode, first, count);
+}
+
+inline void countedDrawElements(GLenum mode, GLsizei count, GLenum type,
+                                const void *indices) {
+  countDraw(mode, count);
+  glDrawElements(mode, count, type, indices);
+}
+
+inline void countedUseProgram(GLuint program) {
+  renderStats().programBinds++;
+  glUseProgram(program);
+}
+
+inline void countedBindVertexArray(GLuint vao) {
+  if (vao != 0) // Unbinding is bookkeeping, not a state change we pay for
+    renderStats().vaoBinds++;
+  glBindVertexArray(vao);
+}
+
+inline void countedBufferData(GLenum target, GLsizeiptr size, const void *data,
+                              GLenum usage) {
+  renderStats().bufferBytesUploaded += (uint64_t)size;
+  glBufferData(target, size, data, usage);
+}
+
+inline void countedBufferSubData(GLenum target, GLintptr offset,
+                                 GLsizeiptr size, const void *data) {
+  renderStats().bufferBytesUploaded += (uint64_t)size;
+  glBufferSubData(target, offset, size, data);
+}
+
+inline void countUniformUpload() { renderStats().uniformUploads++; }
+
+#endif
@@ -0,0 +1,79 @@
+#ifndef RESIDENCY_H
+#define RESIDENCY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// What one frame did to GPU memory (ResidencyManager::endFrame)
+struct ResidencyStats {
+  uint64_t budgetBytes = 0;   // 0 = unlimited
+  uint64_t residentBytes = 0; // After the frame's evictions
+  uint32_t resident = 0;      // Resources loaded
+  uint32_t total = 0;         // Resources registered
+  // Churn: resources (re)loaded and evicted during the frame
+  uint32_t loads = 0;
+  uint32_t evictions = 0;
+  uint64_t loadedBytes = 0;
+  uint64_t evictedBytes = 0;
+};
+
+// Keeps reloadable GPU resources (meshes, textures) under a memory budget.
+//
+// Each resource is registered with a load callback, which creates it and
+// returns its size in bytes (0 on failure), and an unload callback, which
+// frees it. use() marks a resource as needed this frame, loading it first
+// when it was evicted. Whenever the total goes over the budget, resources
+// not used this frame are unloaded, least recently used first; resources
+// in use stay even over budget. GL thread only, like the callbacks.
+class ResidencyManager {
+public:
+  typedef std::function<size_t()> LoadFn;
+  typedef std::function<void()> UnloadFn;
+
+  explicit ResidencyManager(uint64_t budgetBytes = 0);
+
+  // `residentBytes` is the size of a resource that is already loaded;
+  // 0 leaves it to load on first use. Returns its id.
+  int add(const std::string &name, LoadFn load, UnloadFn unload,
+          size_t residentBytes);
+
+  // Resident and used this frame afterwards? False when loading failed
+  // (a failed resource is not retried).
+  bool use(int id);
+  bool isResident(int id) const { return m_resources[id].resident; }
+
+  // 0 = unlimited. A lower budget takes effect at the next endFrame().
+  void setBudget(uint64_t bytes) { m_budget = bytes; }
+  uint64_t budget() const { return m_budget; }
+  uint64_t residentBytes() const { return m_residentBytes; }
+
+  // Evict down to the budget, then close the frame's statistics
+  void endFrame();
+  const ResidencyStats &lastFrame() const { return m_lastFrame; }
+
+private:
+  struct Resource {
+    std::string name;
+    LoadFn load;
+    UnloadFn unload;
+    size_t bytes = 0; // Last loaded size, kept while evicted
+    uint64_t lastUsed = 0;
+    bool resident = false;
+    bool failed = false;
+  };
+
+  // Unload least recently used resources until `incoming` more bytes fit
+  void evictFor(uint64_t incoming);
+
+  std::vector<Resource> m_resources;
+  uint64_t m_budget;
+  uint64_t m_residentBytes = 0;
+  uint64_t m_frame = 1; // Current frame; lastUsed == m_frame means in use
+  ResidencyStats m_current;
+  ResidencyStats m_lastFrame;
+};
+
+#endif
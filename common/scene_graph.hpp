@@ -0,0 +1,87 @@
+#ifndef SCENE_GRAPH_H
+#define SCENE_GRAPH_H
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <learnopengl/transform.h>
+#include <vector>
+
+class JobSystem;
+
+typedef uint32_t NodeId;
+const NodeId kInvalidNode = 0xFFFFFFFFu;
+
+// Transform hierarchy stored as flat arrays.
+//
+// Nodes are kept in depth-first (pre-order) order: every parent comes before
+// its children and every subtree is a contiguous range [i, subtreeEnd(i)).
+// One linear pass therefore updates all world matrices, a subtree with no
+// dirty node is skipped with a single jump, and disjoint subtrees can be
+// updated on different threads.
+//
+// NodeIds are stable handles; the array position of a node changes whenever
+// the hierarchy is re-sorted (after createNode / setParent).
+class SceneGraph {
+public:
+  NodeId createNode(NodeId parent = kInvalidNode);
+
+  // Move a node (with its subtree) under a new parent, or make it a root
+  void setParent(NodeId node, NodeId parent);
+  NodeId getParent(NodeId node) const { return m_links[node].parent; }
+
+  // Local transform setters; they flag the path up to the root so update()
+  // knows which subtrees to visit
+  void setLocalPosition(NodeId node, const glm::vec3 &position);
+  void setLocalRotation(NodeId node, const glm::vec3 &eulerDegrees);
+  void setLocalScale(NodeId node, const glm::vec3 &scale);
+
+  const Transform &getTransform(NodeId node) const {
+    return m_transforms[m_index[node]];
+  }
+  const glm::mat4 &getWorldMatrix(NodeId node) const {
+    return m_transforms[m_index[node]].getModelMatrix();
+  }
+
+  size_t size() const { return m_links.size(); }
+
+  // Recompute the world matrices of every node that moved (directly or
+  // through an ancestor). With a job system, large subtrees are spread
+  // over its threads.
+  void update(JobSystem *jobs = nullptr);
+
+  // Nodes whose world matrix was recomputed by the last update()
+  size_t lastUpdatedCount() const { return m_lastUpdated; }
+
+private:
+  // Hierarchy links, indexed by NodeId
+  struct Links {
+    NodeId parent = kInvalidNode;
+    NodeId firstChild = kInvalidNode;
+    NodeId nextSibling = kInvalidNode;
+  };
+
+  void unlink(NodeId node);
+  void link(NodeId node, NodeId parent);
+  void markDirty(uint32_t index);
+  void sortNodes();
+  void updateRange(uint32_t begin, uint32_t end, size_t &updated);
+  bool updateNode(uint32_t index);
+  bool isFlatRoot(uint32_t index) const;
+
+  std::vector<Links> m_links;
+
+  // Per node, in pre-order
+  std::vector<Transform> m_transforms;
+  std::vector<uint32_t> m_parentIndex; // kInvalidNode for roots
+  std::vector<uint32_t> m_subtreeEnd;  // One past the last descendant
+  std::vector<uint8_t> m_dirtyBelow;   // Node or a descendant changed
+  std::vector<uint8_t> m_worldChanged; // World matrix rewritten this update
+
+  std::vector<uint32_t> m_index; // NodeId -> array position
+  std::vector<uint32_t> m_tasks; // Subtree roots updated in parallel
+  bool m_needsSort = false;
+  bool m_updateAll = false;
+  size_t m_lastUpdated = 0;
+};
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef SHADOW_MAP_H
+#define SHADOW_MAP_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// One mesh instance that casts shadows
+struct ShadowCaster {
+  glm::mat4 model;
+  glm::vec4 sphere; // World bounding sphere (xyz center, w radius)
+};
+
+// Omnidirectional shadow map of a point light: a depth cube map holding,
+// per direction, the distance from the light to the nearest caster divided
+// by farPlane() (written by shadow.frag). phong.frag compares against it
+// with a samplerCubeShadow, so each tap is already 2x2 filtered, and
+// averages several taps around the direction (PCF).
+//
+// The six faces are only re-rendered when the light, the casters or the
+// resolution changed since the last render; a paused light over a still
+// scene costs nothing.
+class PointShadowMap {
+public:
+  static const GLint kTextureUnit = 3; // Past the arena's buffer textures
+
+  PointShadowMap(int size, float farPlane);
+  ~PointShadowMap();
+
+  PointShadowMap(const PointShadowMap &) = delete;
+  PointShadowMap &operator=(const PointShadowMap &) = delete;
+
+  // Face size in texels; a change reallocates and forces the next render
+  void setSize(int size);
+  int size() const { return m_size; }
+  float farPlane() const { return m_farPlane; }
+  GLuint texture() const { return m_texture; }
+
+  // True when render() would draw something different from what the map
+  // holds. Hashes the caster transforms.
+  bool needsUpdate(const glm::vec3 &lightPos,
+                   const std::vector<ShadowCaster> &casters) const;
+
+  // Draw the casters into every face whose frustum their sphere touches.
+  // drawCaster is called with the face's view-projection and the caster,
+  // with the program and position-only VAO left to it. Leaves the default
+  // framebuffer bound and polygon mode set to GL_FILL.
+  void render(const glm::vec3 &lightPos,
+              const std::vector<ShadowCaster> &casters,
+              const std::function<void(const glm::mat4 &faceViewProj,
+                                       const ShadowCaster &caster)>
+                  &drawCaster);
+
+  // Faces drawn and casters submitted by the last render()
+  int lastFaces() const { return m_lastFaces; }
+  uint32_t lastDraws() const { return m_lastDraws; }
+
+private:
+  void allocate();
+
+  GLuint m_texture = 0;
+  GLuint m_framebuffer = 0;
+  int m_size;
+  float m_farPlane;
+
+  bool m_valid = false; // Holds a render for the values below
+  glm::vec3 m_lightPos = glm::vec3(0.0f);
+  uint64_t m_castersHash = 0;
+  int m_lastFaces = 0;
+  uint32_t m_lastDraws = 0;
+};
+
+#endif
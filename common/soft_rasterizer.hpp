@@ -0,0 +1,115 @@
+#ifndef SOFT_RASTERIZER_H
+#define SOFT_RASTERIZER_H
+
+#include "objloader.hpp"
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class JobSystem;
+
+// Light of phong.frag (Light uniform block)
+struct SoftLight {
+  glm::vec4 positionEye = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+  glm::vec3 la = glm::vec3(0.1f);
+  glm::vec3 ld = glm::vec3(0.8f);
+  glm::vec3 ls = glm::vec3(1.0f);
+  bool blinn = false;
+};
+
+// One mesh draw: the same data phong.vert gets as attributes and uniforms.
+// Positions and normals are read with a byte stride, so the interleaved
+// Vertex array of a Mesh can be passed directly. Without indices the
+// vertices are drawn in order, three per triangle.
+struct SoftDraw {
+  const glm::vec3 *positions = nullptr;
+  const glm::vec3 *normals = nullptr;
+  size_t stride = sizeof(glm::vec3); // Bytes between consecutive vertices
+  size_t vertexCount = 0;
+  const unsigned int *indices = nullptr;
+  size_t indexCount = 0;
+
+  glm::mat4 modelView = glm::mat4(1.0f);
+  glm::mat4 mvp = glm::mat4(1.0f);
+  glm::mat3 normalMatrix = glm::mat3(1.0f);
+  Material material = {glm::vec3(0.2f), glm::vec3(0.6f), glm::vec3(0.9f),
+                       32.0f, 1.0f, ""};
+};
+
+// Lighting of phong.frag for one fragment (eye-space position and normal)
+glm::vec3 shadePhong(const glm::vec3 &fragPos, const glm::vec3 &normal,
+                     const SoftLight &light, const Material &material);
+
+// Color clamped to [0, 1], as RGBA8 with alpha 255
+uint32_t packColor(const glm::vec3 &color);
+
+// Binary PPM of RGBA8 pixels stored bottom row first
+bool writePPM(const std::string &path, int width, int height,
+              const uint32_t *pixels);
+
+// CPU implementation of the phong.vert / phong.frag pipeline, for hosts
+// without a GPU.
+//
+// Each draw runs in three phases, each spread over a JobSystem:
+//   1. vertices: clip position, eye position and eye normal per vertex;
+//   2. setup + binning: screen-space edge functions per triangle, and the
+//      triangle appended to every kTileSize x kTileSize tile its bounds
+//      touch (per-chunk bins, concatenated in triangle order);
+//   3. tiles: each tile first resolves visibility (edge functions and depth
+//      four pixels at a time with SSE, keeping the nearest triangle per
+//      pixel), then shades every covered pixel once, so Phong costs one
+//      evaluation per pixel however much the triangles overlap.
+//
+// Depth follows GL (window z in [0, 1], GL_LESS). Triangles with a vertex
+// behind the camera are dropped instead of clipped. No face culling, like
+// the GL renderer.
+class SoftRasterizer {
+public:
+  static const int kTileSize = 64;
+
+  SoftRasterizer(int width, int height);
+
+  int width() const { return m_width; }
+  int height() const { return m_height; }
+
+  void clear(const glm::vec3 &color);
+  void draw(const SoftDraw &draw, const SoftLight &light,
+            JobSystem *jobs = nullptr);
+
+  // RGBA8 pixels, bottom row first (glTexSubImage2D-ready)
+  const std::vector<uint32_t> &pixels() const { return m_color; }
+  // Binary PPM, top row first
+  bool writePPM(const std::string &path) const;
+
+private:
+  struct ShadedVertex {
+    glm::vec4 clip;
+    glm::vec3 eyePos;
+    glm::vec3 eyeNormal;
+  };
+  // Screen-space triangle: edge function i is a[i] * x + b[i] * y + c[i],
+  // positive inside and scaled so the three sum to 1 (barycentrics)
+  struct SetupTriangle {
+    float a[3], b[3], c[3];
+    float z[3];    // Window depth per vertex
+    float invW[3]; // For perspective-correct attributes
+    uint32_t v[3]; // Vertex indices into m_vertices
+    int minX, maxX, minY, maxY; // Pixel bounds, clipped to the screen
+  };
+
+  void rasterTile(int tile, const SoftDraw &draw, const SoftLight &light);
+
+  int m_width, m_height;
+  int m_tilesX, m_tilesY;
+  std::vector<uint32_t> m_color;
+  std::vector<float> m_depth;
+
+  // Per-draw scratch, reused between draws
+  std::vector<ShadedVertex> m_vertices;
+  std::vector<SetupTriangle> m_triangles;
+  std::vector<std::vector<uint32_t>> m_bins; // Triangles per tile
+  std::vector<std::vector<std::vector<uint32_t>>> m_chunkBins;
+};
+
+#endif
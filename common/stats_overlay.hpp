@@ -0,0 +1,27 @@
+#ifndef STATS_OVERLAY_H
+#define STATS_OVERLAY_H
+
+#include <glad/glad.h>
+#include <string>
+#include <vector>
+
+// On-screen text overlay drawn with a built-in 3x5 pixel font (upper-case
+// letters, digits and a few symbols). Each lit font pixel becomes a quad, so
+// it needs no texture or font file. Its own GL calls are not counted in
+// RenderStats, so turning it on does not change the numbers it shows.
+class StatsOverlay {
+public:
+  StatsOverlay();
+  ~StatsOverlay();
+
+  // Draw text lines in the top-left corner of a framebuffer of the given size
+  void draw(const std::vector<std::string> &lines, int fbWidth, int fbHeight);
+
+private:
+  GLuint m_program = 0;
+  GLuint m_vao = 0;
+  GLuint m_vbo = 0;
+  std::vector<float> m_quads; // Reused between frames (x, y per vertex)
+};
+
+#endif
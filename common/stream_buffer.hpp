@@ -0,0 +1,73 @@
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include <glad/glad.h>
+#include <cstddef>
+#include <cstdint>
+
+// Streaming allocator for per-frame GPU data (matrices, lights, instance
+// data, indirect commands).
+//
+// One buffer is split into `frames` regions used round-robin; a fence is
+// inserted after the last draw that reads a region, and the region is only
+// written again once that fence has signaled. With three regions the GPU
+// has two frames of slack, so the CPU normally never waits.
+//
+// GL 4.4+: the buffer is created with glBufferStorage and stays mapped
+// (GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT), so allocate() hands out
+// plain pointers and flush() is a no-op.
+// GL 3.3: the rest of the current region is mapped with
+// GL_MAP_UNSYNCHRONIZED_BIT (the fence already guarantees the GPU is done
+// with it) and unmapped by flush(), which must happen before the draws that
+// read the data. Allocating after a flush() maps the remainder again.
+class StreamBuffer {
+public:
+  struct Allocation {
+    void *data = nullptr; // CPU write pointer (nullptr if the region is full)
+    GLintptr offset = 0;  // Byte offset inside buffer()
+    size_t size = 0;
+  };
+
+  StreamBuffer(size_t bytesPerFrame, int frames = 3);
+  ~StreamBuffer();
+
+  // Move to the next region, waiting on its fence only if the GPU is more
+  // than `frames - 1` frames behind
+  void beginFrame();
+
+  // Suballocate from the current region. `alignment` must be a power of two.
+  Allocation allocate(size_t size, size_t alignment = 16);
+
+  // Make everything written so far visible to the GPU
+  void flush();
+
+  // Fence the current region; call after the last draw that reads it
+  void endFrame();
+
+  GLuint buffer() const { return m_buffer; }
+  bool isPersistent() const { return m_persistent; }
+  size_t bytesPerFrame() const { return m_bytesPerFrame; }
+
+  // Frames where beginFrame() had to block on the GPU
+  uint64_t stallCount() const { return m_stalls; }
+
+private:
+  static const int kMaxFrames = 4;
+
+  void mapRemaining(); // GL 3.3 path
+
+  size_t m_bytesPerFrame;
+  int m_frames;
+  int m_region = -1;
+  size_t m_used = 0;     // Bytes allocated in the current region
+  size_t m_mapStart = 0; // Region offset of m_regionPtr (GL 3.3 path)
+  bool m_persistent = false;
+
+  GLuint m_buffer = 0;
+  uint8_t *m_persistentPtr = nullptr; // Whole buffer (persistent path)
+  uint8_t *m_regionPtr = nullptr;     // Mapped part of the current region
+  GLsync m_fences[kMaxFrames] = {};
+  uint64_t m_stalls = 0;
+};
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef TEXTURE_H
+#define TEXTURE_H
+
+#include <glad/glad.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class JobSystem;
+
+enum TextureFormat : uint32_t {
+  TEXTURE_RGBA8 = 0,
+  TEXTURE_BC1 = 1, // 8 bytes per 4x4 block, RGB (alpha dropped)
+  TEXTURE_BC3 = 2, // 16 bytes per 4x4 block, RGB + interpolated alpha
+};
+
+enum MipFilter : uint32_t {
+  MIP_BOX = 0,    // 2x2 average (SSE)
+  MIP_KAISER = 1, // Separable 8-tap Kaiser-windowed sinc, sharper
+};
+
+struct TextureLevel {
+  int width = 0, height = 0;
+  std::vector<uint8_t> data; // Rows bottom to top, as OpenGL expects
+};
+
+// A texture and its mip chain, down to 1 x 1
+struct TextureData {
+  TextureFormat format = TEXTURE_RGBA8;
+  bool hasAlpha = false; // Some texel of the source is not opaque
+  std::vector<TextureLevel> levels;
+};
+
+struct TextureOptions {
+  MipFilter filter = MIP_BOX;
+  bool compress = true; // BC1, or BC3 when the image has alpha
+  bool useCache = true; // Read / write <image>.tex next to the image
+};
+
+// How long each step of the last loadTexture() took (zero when skipped)
+struct TextureTimings {
+  double decodeMs = 0.0, mipMs = 0.0, compressMs = 0.0, cacheMs = 0.0;
+  bool fromCache = false;
+};
+
+// Bytes of all levels, as uploaded
+size_t textureBytes(const TextureData &texture);
+
+// Binary PPM (P6, 8 bits) or TGA (uncompressed or RLE, 24 / 32 bits) into
+// RGBA8 level 0 of `out`
+bool decodeImage(const char *path, TextureData &out);
+
+// Replace levels 1.. of an RGBA8 texture with a chain built from level 0.
+// Each level is filtered from the one above it, its rows split over the
+// job system.
+void generateMips(TextureData &texture, MipFilter filter,
+                  JobSystem *jobs = nullptr);
+
+// Encode every level of an RGBA8 texture as BC1 (opaque) or BC3, blocks
+// split over the job system. Edges of levels that are not a multiple of 4
+// are padded by repeating the last row / column.
+void compressTexture(TextureData &texture, JobSystem *jobs = nullptr);
+
+// Decode, build mips and compress, or read all of that back from the
+// cache file when it was written for the same image (size and
+// modification time) and options. A fresh result is written to the cache.
+bool loadTexture(const char *path, TextureData &out,
+                 const TextureOptions &options, JobSystem *jobs = nullptr,
+                 TextureTimings *timings = nullptr);
+
+// loadTexture() of every path, each in its own job (which in turn splits
+// its mips and blocks). ok[i] tells whether out[i] was loaded.
+void loadTextures(const std::vector<std::string> &paths,
+                  std::vector<TextureData> &out, std::vector<bool> &ok,
+                  const TextureOptions &options, JobSystem *jobs);
+
+// --- GL side (texture_upload.cpp) ---
+
+// Whether the context has GL_EXT_texture_compression_s3tc, asked once (GL
+// thread). Without it, load with TextureOptions::compress = false.
+bool textureCompressionSupported();
+
+// Texture object with every level of `texture` (glCompressedTexImage2D for
+// BC formats), trilinear filtering and repeat wrapping. 0 on failure,
+// including BC data without S3TC support.
+GLuint createTexture(const TextureData &texture);
+
+#endif
@@ -0,0 +1,52 @@
+#version 410
+
+in vec3 FragPos;
+in vec3 Normal;
+flat in int MaterialIndex;
+
+out vec4 FragColor;
+
+// Per-frame data, written into the stream buffer by GeometryArena::submit
+layout (std140) uniform FrameData {
+  mat4 ViewMatrix;
+  mat4 ProjectionMatrix;
+  vec4 LightPosition; // Light position in eye coords.
+  vec4 La;            // Ambient light intensity
+  vec4 Ld;            // Diffuse light intensity
+  vec4 Ls;            // Specular light intensity
+  ivec4 Params;       // x = blinn, y = first DrawData texel of this frame
+};
+
+// 3 texels per material: (Ka, Shininess), (Kd, d), (Ks, 0)
+uniform samplerBuffer Materials;
+
+void main() {
+    vec4 kaNs = texelFetch(Materials, MaterialIndex * 3 + 0);
+    vec3 Kd = texelFetch(Materials, MaterialIndex * 3 + 1).rgb;
+    vec3 Ks = texelFetch(Materials, MaterialIndex * 3 + 2).rgb;
+
+    vec3 n = normalize(Normal);
+    vec3 s = normalize(vec3(LightPosition) - FragPos);
+    vec3 v = normalize(-FragPos);
+
+    vec3 ambient = La.rgb * kaNs.rgb;
+
+    float sDotN = max(dot(s, n), 0.0);
+    vec3 diffuse = Ld.rgb * Kd * sDotN;
+
+    vec3 spec = vec3(0.0);
+    if(sDotN > 0.0) {
+        float specFactor = 0.0;
+        if(Params.x != 0) {
+            vec3 halfwayDir = normalize(s + v);
+            specFactor = pow(max(dot(n, halfwayDir), 0.0), kaNs.a);
+        } else {
+            vec3 r = reflect(-s, n);
+            specFactor = pow(max(dot(r, v), 0.0), kaNs.a);
+        }
+        spec = Ls.rgb * Ks * specFactor;
+    }
+
+    vec3 result = ambient + diffuse + spec;
+    FragColor = vec4(result, 1.0);
+}
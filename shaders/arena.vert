@@ -0,0 +1,44 @@
+#version 410
+
+layout (location = 0) in vec3 VertexPosition;
+layout (location = 1) in vec3 VertexNormal;
+layout (location = 7) in uint DrawIndex; // Instance of this draw
+
+out vec3 FragPos;
+out vec3 Normal;
+flat out int MaterialIndex;
+
+// 8 texels per instance: model matrix columns, normal matrix columns
+// (texel 4.w = material index), padding
+uniform samplerBuffer DrawData;
+
+// Per-frame data, written into the stream buffer by GeometryArena::submit
+layout (std140) uniform FrameData {
+  mat4 ViewMatrix;
+  mat4 ProjectionMatrix;
+  vec4 LightPosition; // Light position in eye coords.
+  vec4 La;            // Ambient light intensity
+  vec4 Ld;            // Diffuse light intensity
+  vec4 Ls;            // Specular light intensity
+  ivec4 Params;       // x = blinn, y = first DrawData texel of this frame
+};
+
+void main()
+{
+    int base = Params.y + int(DrawIndex) * 8;
+    mat4 model = mat4(texelFetch(DrawData, base + 0),
+                      texelFetch(DrawData, base + 1),
+                      texelFetch(DrawData, base + 2),
+                      texelFetch(DrawData, base + 3));
+    vec4 n0 = texelFetch(DrawData, base + 4);
+    mat3 normalMatrix = mat3(n0.xyz,
+                             texelFetch(DrawData, base + 5).xyz,
+                             texelFetch(DrawData, base + 6).xyz);
+    MaterialIndex = int(n0.w);
+
+    vec4 viewPos = ViewMatrix * model * vec4(VertexPosition, 1.0);
+    FragPos = vec3(viewPos);
+    Normal = normalize(mat3(ViewMatrix) * normalMatrix * VertexNormal);
+
+    gl_Position = ProjectionMatrix * viewPos;
+}
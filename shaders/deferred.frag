@@ -0,0 +1,153 @@
+#version 410
+
+// Lighting pass of the deferred path: the same lighting as phong.frag, but
+// position, normal and material come from the G-buffer (GBuffer)
+
+out vec4 FragColor;
+
+uniform sampler2D GNormal;    // Octahedral view-space normal
+uniform usampler2D GMaterial; // Material index
+uniform sampler2D GDepth;     // Window-space depth
+// Three texels per material: Ka, Kd, (Ks, shininess)
+uniform samplerBuffer Materials;
+uniform mat4 InverseProjection;
+uniform vec2 ViewportSize;
+
+struct LightInfo {
+  vec4 Position; // Light position in eye coords.
+  vec3 La;       // Ambient light intensity
+  vec3 Ld;       // Diffuse light intensity
+  vec3 Ls;       // Specular light intensity
+};
+uniform LightInfo Light;
+
+uniform bool blinn;
+
+// Point light shadows, as in phong.frag
+uniform bool shadows;
+uniform samplerCubeShadow ShadowMap;
+uniform mat3 EyeToWorld;
+uniform float ShadowFar;
+uniform float ShadowFilterRadius;
+
+// Clustered point lights, as in phong.frag
+uniform bool clustered;
+uniform samplerBuffer ClusterLights;
+uniform usamplerBuffer ClusterGrid;
+uniform usamplerBuffer ClusterIndices;
+uniform vec2 ClusterTileSize;
+uniform float ClusterNear;
+uniform float ClusterLogRatio;
+
+const int kClusterTilesX = 16;
+const int kClusterTilesY = 9;
+const int kClusterSlices = 24;
+
+const int kShadowTaps = 21;
+const vec3 kShadowOffsets[kShadowTaps] = vec3[](
+    vec3(0, 0, 0),
+    vec3(1, 1, 1), vec3(1, -1, 1), vec3(-1, -1, 1), vec3(-1, 1, 1),
+    vec3(1, 1, -1), vec3(1, -1, -1), vec3(-1, -1, -1), vec3(-1, 1, -1),
+    vec3(1, 1, 0), vec3(1, -1, 0), vec3(-1, -1, 0), vec3(-1, 1, 0),
+    vec3(1, 0, 1), vec3(-1, 0, 1), vec3(1, 0, -1), vec3(-1, 0, -1),
+    vec3(0, 1, 1), vec3(0, -1, 1), vec3(0, -1, -1), vec3(0, 1, -1));
+
+// Inverse of encodeNormal in gbuffer.frag
+vec3 decodeNormal(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0,
+                                         n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+
+float shadowFactor(vec3 pos, vec3 n, vec3 s) {
+    vec3 toFrag = pos - vec3(Light.Position);
+    float dist = length(toFrag);
+    vec3 dir = EyeToWorld * toFrag;
+    float bias = mix(0.02, 0.004, max(dot(n, s), 0.0));
+    float ref = (dist - bias) / ShadowFar;
+    float radius = ShadowFilterRadius * dist / sqrt(3.0);
+    float lit = 0.0;
+    for (int i = 0; i < kShadowTaps; ++i)
+        lit += texture(ShadowMap, vec4(dir + kShadowOffsets[i] * radius, ref));
+    return lit / float(kShadowTaps);
+}
+
+float specularFactor(vec3 n, vec3 s, vec3 v, float shininess) {
+    if(blinn) {
+        vec3 halfwayDir = normalize(s + v);
+        return pow(max(dot(n, halfwayDir), 0.0), shininess);
+    }
+    vec3 r = reflect(-s, n);
+    return pow(max(dot(r, v), 0.0), shininess);
+}
+
+vec3 clusterLighting(vec3 pos, vec3 n, vec3 v, vec3 kd, vec4 ks) {
+    float depth = -pos.z;
+    int slice = 0;
+    if (depth > ClusterNear)
+        slice = min(int(log(depth / ClusterNear) / ClusterLogRatio *
+                        float(kClusterSlices)), kClusterSlices - 1);
+    ivec2 tile = min(ivec2(gl_FragCoord.xy / ClusterTileSize),
+                     ivec2(kClusterTilesX - 1, kClusterTilesY - 1));
+    int cluster = (slice * kClusterTilesY + tile.y) * kClusterTilesX + tile.x;
+    uvec2 range = texelFetch(ClusterGrid, cluster).xy;
+
+    vec3 result = vec3(0.0);
+    for (uint i = 0u; i < range.y; ++i) {
+        int light = int(texelFetch(ClusterIndices, int(range.x + i)).x);
+        vec4 positionRadius = texelFetch(ClusterLights, 2 * light);
+        vec3 color = texelFetch(ClusterLights, 2 * light + 1).xyz;
+        vec3 toLight = positionRadius.xyz - pos;
+        float dist = length(toLight);
+        if (dist >= positionRadius.w)
+            continue;
+        float x = dist / positionRadius.w;
+        float window = clamp(1.0 - x * x * x * x, 0.0, 1.0);
+        float falloff = window * window / (1.0 + dist * dist);
+        vec3 s = toLight / dist;
+        float sDotN = max(dot(s, n), 0.0);
+        if (sDotN <= 0.0)
+            continue;
+        result += color * falloff *
+                  (kd * sDotN + ks.xyz * specularFactor(n, s, v, ks.w));
+    }
+    return result;
+}
+
+void main() {
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(GDepth, pixel, 0).x;
+    if (depth >= 1.0)
+        discard; // Nothing drawn here: keep the cleared background
+
+    // View position from window depth
+    vec4 ndc = vec4(gl_FragCoord.xy / ViewportSize * 2.0 - 1.0,
+                    depth * 2.0 - 1.0, 1.0);
+    vec4 view = InverseProjection * ndc;
+    vec3 pos = view.xyz / view.w;
+
+    vec3 n = decodeNormal(texelFetch(GNormal, pixel, 0).xy);
+    int material = int(texelFetch(GMaterial, pixel, 0).x);
+    vec3 ka = texelFetch(Materials, 3 * material).xyz;
+    vec3 kd = texelFetch(Materials, 3 * material + 1).xyz;
+    vec4 ks = texelFetch(Materials, 3 * material + 2);
+
+    vec3 s = normalize(vec3(Light.Position) - pos);
+    vec3 v = normalize(-pos);
+    vec3 ambient = Light.La * ka;
+    float sDotN = max(dot(s, n), 0.0);
+    vec3 diffuse = Light.Ld * kd * sDotN;
+    vec3 spec = vec3(0.0);
+    if(sDotN > 0.0)
+        spec = Light.Ls * ks.xyz * specularFactor(n, s, v, ks.w);
+
+    float lit = shadows ? shadowFactor(pos, n, s) : 1.0;
+    vec3 result = ambient + lit * (diffuse + spec);
+    if (clustered)
+        result += clusterLighting(pos, n, v, kd, ks);
+    FragColor = vec4(result, 1.0);
+    // Forward draws after this pass (the light box) test against the scene
+    gl_FragDepth = depth;
+}
@@ -0,0 +1,6 @@
+#version 410
+
+// Depth-only pass: color writes are masked off, nothing to compute
+void main()
+{
+}
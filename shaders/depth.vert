@@ -0,0 +1,13 @@
+#version 410
+
+layout (location = 0) in vec3 VertexPosition;
+
+uniform mat4 MVP;
+
+// Must match phong.vert bit for bit: the shading pass tests with GL_EQUAL
+invariant gl_Position;
+
+void main()
+{
+    gl_Position = MVP * vec4(VertexPosition, 1.0);
+}
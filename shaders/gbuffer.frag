@@ -0,0 +1,23 @@
+#version 410
+
+in vec3 Normal;
+
+layout (location = 0) out vec2 GNormal;   // Octahedral view-space normal
+layout (location = 1) out uint GMaterial; // Index into the material table
+
+uniform int MaterialIndex;
+
+// Fold the unit sphere onto the [-1, 1] square (octahedral mapping)
+vec2 encodeNormal(vec3 n) {
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0,
+                                         n.y >= 0.0 ? 1.0 : -1.0);
+    return n.xy;
+}
+
+void main()
+{
+    GNormal = encodeNormal(normalize(Normal));
+    GMaterial = uint(MaterialIndex);
+}
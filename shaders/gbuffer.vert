@@ -0,0 +1,18 @@
+#version 410
+
+layout (location = 0) in vec3 VertexPosition;
+layout (location = 1) in vec3 VertexNormal;
+
+out vec3 Normal;
+
+uniform mat3 NormalMatrix;
+uniform mat4 MVP;
+
+// Same position as depth.vert, so GL_EQUAL passes after a depth pre-pass
+invariant gl_Position;
+
+void main()
+{
+    Normal = NormalMatrix * VertexNormal;
+    gl_Position = MVP * vec4(VertexPosition, 1.0);
+}
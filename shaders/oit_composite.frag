@@ -0,0 +1,23 @@
+#version 410
+
+// Weighted blended OIT resolve (WeightedBlendedOit): the weighted average
+// color of the transparent surfaces over a pixel, blended onto the scene
+// with GL_ONE_MINUS_SRC_ALPHA, GL_SRC_ALPHA so the scene keeps Revealage
+// of its color
+
+out vec4 FragColor;
+
+uniform sampler2D Accum;     // sum(color * alpha * w), sum(alpha * w)
+uniform sampler2D Revealage; // prod(1 - alpha)
+
+void main() {
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float revealage = texelFetch(Revealage, pixel, 0).x;
+    if (revealage >= 1.0)
+        discard; // No transparent surface here
+    vec4 accum = texelFetch(Accum, pixel, 0);
+    // Half floats overflow under many bright layers
+    if (isinf(max(max(accum.x, accum.y), max(accum.z, accum.w))))
+        accum.xyz = vec3(accum.w);
+    FragColor = vec4(accum.xyz / max(accum.w, 1e-5), revealage);
+}
@@ -0,0 +1,7 @@
+#version 410
+
+layout( location = 0 ) out vec4 FragColor;
+
+void main() {
+    FragColor = vec4(1.0, 1.0, 1.0, 1.0);
+}
@@ -0,0 +1,11 @@
+#version 410
+
+layout (location = 0) in vec2 VertexPosition; // In framebuffer pixels
+
+uniform vec2 ScreenSize;
+
+void main()
+{
+    vec2 ndc = VertexPosition / ScreenSize * 2.0 - 1.0;
+    gl_Position = vec4(ndc.x, -ndc.y, 0.0, 1.0);
+}
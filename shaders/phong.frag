@@ -2,8 +2,12 @@
 
 in vec3 FragPos;
 in vec3 Normal;
+in vec2 TexCoords;
 
-out vec4 FragColor;
+layout (location = 0) out vec4 FragColor;
+// Second target of the transparent pass (WeightedBlendedOit); ignored when
+// only one draw buffer is bound
+layout (location = 1) out vec4 Revealage;
 
 struct LightInfo {
   vec4 Position; // Light position in eye coords.
@@ -18,34 +22,148 @@ struct MaterialInfo {
   vec3 Kd;            // Diffuse reflectivity
   vec3 Ks;            // Specular reflectivity
   float Shininess;    // Specular shininess factor
+  float Dissolve;     // Opacity (d in the .mtl)
 };
 uniform MaterialInfo Material;
 
 uniform bool blinn;
 
+// Diffuse map (map_Kd): multiplies Ka and Kd, as in the .mtl convention
+uniform bool textured;
+uniform sampler2D DiffuseMap;
+
+// Transparent pass: write weighted, premultiplied color and alpha for
+// weighted blended OIT instead of an opaque color
+uniform bool oit;
+
+// Point light shadows (PointShadowMap): distance to the nearest caster per
+// world direction, divided by ShadowFar
+uniform bool shadows;
+uniform samplerCubeShadow ShadowMap;
+uniform mat3 EyeToWorld;         // Rotation of the inverse view matrix
+uniform float ShadowFar;
+uniform float ShadowFilterRadius; // Kernel radius, radians
+
+// Clustered point lights (LightClusters): per cluster, an (offset, count)
+// range of ClusterIndices; two ClusterLights texels per light: (eye
+// position, radius), (color, unused)
+uniform bool clustered;
+uniform samplerBuffer ClusterLights;
+uniform usamplerBuffer ClusterGrid;
+uniform usamplerBuffer ClusterIndices;
+uniform vec2 ClusterTileSize;  // Render target pixels per tile
+uniform float ClusterNear;     // Depth of the first slice boundary
+uniform float ClusterLogRatio; // log(far / near) of the slices
+
+// Same grid as LightClusters::kTilesX, kTilesY, kSlices
+const int kClusterTilesX = 16;
+const int kClusterTilesY = 9;
+const int kClusterSlices = 24;
+
+// PCF taps around the lookup direction: center, 8 cube corners,
+// 12 edge midpoints
+const int kShadowTaps = 21;
+const vec3 kShadowOffsets[kShadowTaps] = vec3[](
+    vec3(0, 0, 0),
+    vec3(1, 1, 1), vec3(1, -1, 1), vec3(-1, -1, 1), vec3(-1, 1, 1),
+    vec3(1, 1, -1), vec3(1, -1, -1), vec3(-1, -1, -1), vec3(-1, 1, -1),
+    vec3(1, 1, 0), vec3(1, -1, 0), vec3(-1, -1, 0), vec3(-1, 1, 0),
+    vec3(1, 0, 1), vec3(-1, 0, 1), vec3(1, 0, -1), vec3(-1, 0, -1),
+    vec3(0, 1, 1), vec3(0, -1, 1), vec3(0, -1, -1), vec3(0, 1, -1));
+
+// Lit fraction of the fragment (1 = fully lit)
+float shadowFactor(vec3 n, vec3 s) {
+    vec3 toFrag = FragPos - vec3(Light.Position);
+    float dist = length(toFrag);
+    vec3 dir = EyeToWorld * toFrag;
+    // Slope-scaled bias: surfaces at grazing angles need more
+    float bias = mix(0.02, 0.004, max(dot(n, s), 0.0));
+    float ref = (dist - bias) / ShadowFar;
+    float radius = ShadowFilterRadius * dist / sqrt(3.0); // Corners: sqrt(3)
+    float lit = 0.0;
+    for (int i = 0; i < kShadowTaps; ++i)
+        lit += texture(ShadowMap, vec4(dir + kShadowOffsets[i] * radius, ref));
+    return lit / float(kShadowTaps);
+}
+
+// Phong or Blinn-Phong specular term for light direction s
+float specularFactor(vec3 n, vec3 s, vec3 v) {
+    if(blinn) {
+        vec3 halfwayDir = normalize(s + v);
+        return pow(max(dot(n, halfwayDir), 0.0), Material.Shininess);
+    }
+    vec3 r = reflect(-s, n);
+    return pow(max(dot(r, v), 0.0), Material.Shininess);
+}
+
+// Diffuse + specular of the point lights listed in this fragment's cluster
+vec3 clusterLighting(vec3 n, vec3 v, vec3 kd) {
+    float depth = -FragPos.z;
+    int slice = 0;
+    if (depth > ClusterNear)
+        slice = min(int(log(depth / ClusterNear) / ClusterLogRatio *
+                        float(kClusterSlices)), kClusterSlices - 1);
+    ivec2 tile = min(ivec2(gl_FragCoord.xy / ClusterTileSize),
+                     ivec2(kClusterTilesX - 1, kClusterTilesY - 1));
+    int cluster = (slice * kClusterTilesY + tile.y) * kClusterTilesX + tile.x;
+    uvec2 range = texelFetch(ClusterGrid, cluster).xy;
+
+    vec3 result = vec3(0.0);
+    for (uint i = 0u; i < range.y; ++i) {
+        int light = int(texelFetch(ClusterIndices, int(range.x + i)).x);
+        vec4 positionRadius = texelFetch(ClusterLights, 2 * light);
+        vec3 color = texelFetch(ClusterLights, 2 * light + 1).xyz;
+        vec3 toLight = positionRadius.xyz - FragPos;
+        float dist = length(toLight);
+        if (dist >= positionRadius.w)
+            continue;
+        // Inverse square, windowed to reach zero at the light's radius
+        float x = dist / positionRadius.w;
+        float window = clamp(1.0 - x * x * x * x, 0.0, 1.0);
+        float falloff = window * window / (1.0 + dist * dist);
+        vec3 s = toLight / dist;
+        float sDotN = max(dot(s, n), 0.0);
+        if (sDotN <= 0.0)
+            continue;
+        result += color * falloff *
+                  (kd * sDotN +
+                   Material.Ks * specularFactor(n, s, v));
+    }
+    return result;
+}
+
 void main() {
     vec3 n = normalize(Normal);
     vec3 s = normalize(vec3(Light.Position) - FragPos);
     vec3 v = normalize(-FragPos);
+    vec3 albedo = textured ? texture(DiffuseMap, TexCoords).rgb : vec3(1.0);
+    vec3 kd = Material.Kd * albedo;
     
-    vec3 ambient = Light.La * Material.Ka;
+    vec3 ambient = Light.La * Material.Ka * albedo;
     
     float sDotN = max(dot(s, n), 0.0);
-    vec3 diffuse = Light.Ld * Material.Kd * sDotN;
+    vec3 diffuse = Light.Ld * kd * sDotN;
     
     vec3 spec = vec3(0.0);
-    if(sDotN > 0.0) {
-        float specFactor = 0.0;
-        if(blinn) {
-            vec3 halfwayDir = normalize(s + v);
-            specFactor = pow(max(dot(n, halfwayDir), 0.0), Material.Shininess);
-        } else {
-            vec3 r = reflect(-s, n);
-            specFactor = pow(max(dot(r, v), 0.0), Material.Shininess);
-        }
-        spec = Light.Ls * Material.Ks * specFactor;
-    }
+    if(sDotN > 0.0)
+        spec = Light.Ls * Material.Ks * specularFactor(n, s, v);
     
-    vec3 result = ambient + diffuse + spec;
-    FragColor = vec4(result, 1.0);
+    float lit = shadows ? shadowFactor(n, s) : 1.0;
+    vec3 result = ambient + lit * (diffuse + spec);
+    if (clustered)
+        result += clusterLighting(n, v, kd);
+
+    if (oit) {
+        // Depth weight (McGuire & Bavoil, eq. 7): nearer layers dominate
+        // the average where transparent surfaces overlap
+        float alpha = Material.Dissolve;
+        float z = -FragPos.z;
+        float weight = alpha * clamp(10.0 / (1e-5 + pow(z / 5.0, 2.0) +
+                                             pow(z / 200.0, 6.0)),
+                                     1e-2, 3e3);
+        FragColor = vec4(result * alpha, alpha) * weight;
+        Revealage = vec4(alpha);
+    } else {
+        FragColor = vec4(result, 1.0);
+    }
 }
\ No newline at end of file
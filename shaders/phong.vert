@@ -2,18 +2,24 @@
 
 layout (location = 0) in vec3 VertexPosition;
 layout (location = 1) in vec3 VertexNormal;
+layout (location = 2) in vec2 VertexTexCoords;
 
 out vec3 FragPos;
 out vec3 Normal;
+out vec2 TexCoords;
 
 uniform mat4 ModelViewMatrix;
 uniform mat3 NormalMatrix;
 uniform mat4 MVP;
 
+// Same position as depth.vert, so GL_EQUAL passes after a depth pre-pass
+invariant gl_Position;
+
 void main()
 {
     FragPos = vec3(ModelViewMatrix * vec4(VertexPosition, 1.0));
     Normal = normalize(NormalMatrix * VertexNormal);
+    TexCoords = VertexTexCoords;
     
     gl_Position = MVP * vec4(VertexPosition, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,13 @@
+#version 410
+
+in vec3 WorldPos;
+
+uniform vec3 LightPos;  // World coords.
+uniform float FarPlane; // Distance stored as depth 1.0
+
+void main()
+{
+    // Distance to the light instead of projected depth: the same value
+    // whichever face the direction falls on
+    gl_FragDepth = length(WorldPos - LightPos) / FarPlane;
+}
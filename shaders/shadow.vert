@@ -0,0 +1,15 @@
+#version 410
+
+layout (location = 0) in vec3 VertexPosition;
+
+out vec3 WorldPos;
+
+uniform mat4 ModelMatrix;
+uniform mat4 FaceViewProj; // One cube map face of the light
+
+void main()
+{
+    vec4 world = ModelMatrix * vec4(VertexPosition, 1.0);
+    WorldPos = world.xyz;
+    gl_Position = FaceViewProj * world;
+}
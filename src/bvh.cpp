@@ -0,0 +1,687 @@
+#include "bvh.hpp"
+#include "job_system.hpp"
+#include <learnopengl/transform.h>
+#include "profiler.hpp"
+#include <algorithm>
+#include <cassert>
+#include <atomic>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+
+namespace {
+const float kTraversalCost = 1.0f; // Relative to one triangle test
+const uint32_t kParallelBinMin = 32768; // Nodes binned on the job system
+const uint32_t kParallelSubtreeMin = 4096; // Nodes whose children fork
+const uint32_t kBinGrain = 8192;
+// Traversal stack. Builds stop splitting at this depth: a traversal holds
+// at most one entry per level above the node it is in, so it always fits.
+const int kStackSize = 64;
+const float kMinT = 1e-5f;
+
+struct Aabb {
+  glm::vec3 min = glm::vec3(FLT_MAX);
+  glm::vec3 max = glm::vec3(-FLT_MAX);
+
+  void grow(const glm::vec3 &p) {
+    min = glm::min(min, p);
+    max = glm::max(max, p);
+  }
+  void grow(const Aabb &b) {
+    min = glm::min(min, b.min);
+    max = glm::max(max, b.max);
+  }
+  float area() const {
+    glm::vec3 e = max - min;
+    return e.x < 0.0f ? 0.0f : 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+  }
+};
+
+struct Bin {
+  Aabb bounds;
+  uint32_t count = 0;
+};
+
+// One triangle during the build. Nodes own contiguous ranges of these,
+// so every pass over a node reads memory in order.
+struct BuildRef {
+  Aabb bounds;
+  glm::vec3 centroid;
+  uint32_t triangle;
+};
+
+// Bounds of the triangles and of their centroids
+struct RangeBounds {
+  Aabb bounds, centroids;
+};
+
+// Run fn(begin, end) over [0, count) in chunks of `grain`, each chunk
+// writing to its own result
+template <typename Result, typename Fn>
+std::vector<Result> chunked(JobSystem *jobs, size_t count, size_t grain,
+                            Fn fn) {
+  size_t chunks = (count + grain - 1) / grain;
+  std::vector<Result> results(chunks);
+  jobs->parallelFor(chunks, 1, [&](size_t begin, size_t end) {
+    for (size_t c = begin; c < end; ++c)
+      fn(c * grain, std::min(count, (c + 1) * grain), results[c]);
+  });
+  return results;
+}
+
+float slabEntry(const glm::vec3 &min, const glm::vec3 &max,
+                const glm::vec3 &origin, const glm::vec3 &invDir, float tMax) {
+  float tx0 = (min.x - origin.x) * invDir.x;
+  float tx1 = (max.x - origin.x) * invDir.x;
+  float ty0 = (min.y - origin.y) * invDir.y;
+  float ty1 = (max.y - origin.y) * invDir.y;
+  float tz0 = (min.z - origin.z) * invDir.z;
+  float tz1 = (max.z - origin.z) * invDir.z;
+  float tNear = std::max(std::max(std::min(tx0, tx1), std::min(ty0, ty1)),
+                         std::max(std::min(tz0, tz1), 0.0f));
+  float tFar = std::min(std::min(std::max(tx0, tx1), std::max(ty0, ty1)),
+                        std::min(std::max(tz0, tz1), tMax));
+  return tNear <= tFar ? tNear : FLT_MAX;
+}
+} // namespace
+
+struct Bvh::BuildContext {
+  const glm::vec3 *positions;
+  JobSystem *jobs;
+  std::vector<BuildRef> refs;
+  std::atomic<uint32_t> nodeCount{1};
+  std::atomic<size_t> leaves{0};
+  std::atomic<int> maxDepth{0};
+
+  RangeBounds rangeBounds(uint32_t first, uint32_t count) const {
+    auto gather = [&](size_t begin, size_t end, RangeBounds &out) {
+      for (size_t i = begin; i < end; ++i) {
+        const BuildRef &ref = refs[first + i];
+        out.bounds.grow(ref.bounds);
+        out.centroids.grow(ref.centroid);
+      }
+    };
+    RangeBounds result;
+    if (jobs && count >= kParallelBinMin) {
+      for (const RangeBounds &part :
+           chunked<RangeBounds>(jobs, count, kBinGrain, gather)) {
+        result.bounds.grow(part.bounds);
+        result.centroids.grow(part.centroids);
+      }
+    } else {
+      gather(0, count, result);
+    }
+    return result;
+  }
+};
+
+void Bvh::build(const glm::vec3 *positions, size_t triangleCount,
+                JobSystem *jobs) {
+  PROFILE_ZONE("Bvh::build");
+  auto start = std::chrono::steady_clock::now();
+  m_nodes.clear();
+  m_triangles.clear();
+  m_sourceIndex.clear();
+  m_stats = Stats();
+  if (triangleCount == 0)
+    return;
+
+  BuildContext ctx;
+  ctx.positions = positions;
+  ctx.jobs = jobs;
+  ctx.refs.resize(triangleCount);
+  auto prepare = [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      Aabb box;
+      for (int k = 0; k < 3; ++k)
+        box.grow(positions[3 * i + k]);
+      ctx.refs[i] = {box, (box.min + box.max) * 0.5f, (uint32_t)i};
+    }
+  };
+  if (jobs)
+    jobs->parallelFor(triangleCount, kBinGrain, prepare);
+  else
+    prepare(0, triangleCount);
+
+  // A binary tree with at least one triangle per leaf has < 2n nodes
+  m_nodes.resize(2 * triangleCount);
+  subdivide(ctx, 0, 0, (uint32_t)triangleCount, 1);
+  m_nodes.resize(ctx.nodeCount.load());
+
+  m_triangles.resize(triangleCount);
+  m_sourceIndex.resize(triangleCount);
+  for (size_t i = 0; i < triangleCount; ++i) {
+    uint32_t source = ctx.refs[i].triangle;
+    const glm::vec3 *v = &positions[3 * (size_t)source];
+    m_triangles[i] = {v[0], v[1] - v[0], v[2] - v[0]};
+    m_sourceIndex[i] = source;
+  }
+
+  m_stats.buildMs = std::chrono::duration<double, std::milli>(
+                        std::chrono::steady_clock::now() - start)
+                        .count();
+  m_stats.nodes = m_nodes.size();
+  m_stats.leaves = ctx.leaves.load();
+  m_stats.maxDepth = ctx.maxDepth.load();
+}
+
+void Bvh::subdivide(BuildContext &ctx, uint32_t nodeIndex, uint32_t first,
+                    uint32_t count, int depth) {
+  RangeBounds range = ctx.rangeBounds(first, count);
+  Node &node = m_nodes[nodeIndex];
+  node.min = range.bounds.min;
+  node.max = range.bounds.max;
+
+  auto makeLeaf = [&] {
+    node.leftFirst = first;
+    node.count = count;
+    ctx.leaves.fetch_add(1, std::memory_order_relaxed);
+    int seen = ctx.maxDepth.load(std::memory_order_relaxed);
+    while (depth > seen &&
+           !ctx.maxDepth.compare_exchange_weak(seen, depth,
+                                               std::memory_order_relaxed)) {
+    }
+  };
+  // At the depth limit whatever is left stays in one (large) leaf
+  if (count <= 2 || depth >= kStackSize) {
+    makeLeaf();
+    return;
+  }
+
+  // Bin the centroids along all three axes at once; small nodes use fewer
+  // bins, as most would stay empty
+  const int binCount = (int)std::min<uint32_t>(kBins, std::max(4u, count));
+  glm::vec3 cmin = range.centroids.min;
+  glm::vec3 extent = range.centroids.max - cmin;
+  glm::vec3 scale;
+  for (int axis = 0; axis < 3; ++axis)
+    scale[axis] = extent[axis] > 1e-12f ? (float)binCount / extent[axis] : 0.0f;
+  auto binOf = [&](const BuildRef &ref, int axis) {
+    int b = (int)((ref.centroid[axis] - cmin[axis]) * scale[axis]);
+    return std::min(b, binCount - 1);
+  };
+  struct Bins {
+    Bin bins[3][kBins];
+  };
+  auto fill = [&](size_t begin, size_t end, Bins &out) {
+    for (size_t i = begin; i < end; ++i) {
+      const BuildRef &ref = ctx.refs[first + i];
+      for (int axis = 0; axis < 3; ++axis) {
+        Bin &bin = out.bins[axis][binOf(ref, axis)];
+        bin.bounds.grow(ref.bounds);
+        bin.count++;
+      }
+    }
+  };
+  Bins bins;
+  if (ctx.jobs && count >= kParallelBinMin) {
+    for (const Bins &part : chunked<Bins>(ctx.jobs, count, kBinGrain, fill))
+      for (int axis = 0; axis < 3; ++axis)
+        for (int b = 0; b < kBins; ++b) {
+          bins.bins[axis][b].bounds.grow(part.bins[axis][b].bounds);
+          bins.bins[axis][b].count += part.bins[axis][b].count;
+        }
+  } else {
+    fill(0, count, bins);
+  }
+
+  // Cheapest plane: sweep from both sides; bins below bestSplit go left
+  float bestCost = FLT_MAX;
+  int bestAxis = -1, bestSplit = 0;
+  for (int axis = 0; axis < 3; ++axis) {
+    if (scale[axis] == 0.0f)
+      continue;
+    const Bin *b = bins.bins[axis];
+    float leftArea[kBins - 1];
+    uint32_t leftCount[kBins - 1];
+    Aabb box;
+    uint32_t sum = 0;
+    for (int i = 0; i < binCount - 1; ++i) {
+      box.grow(b[i].bounds);
+      sum += b[i].count;
+      leftArea[i] = box.area();
+      leftCount[i] = sum;
+    }
+    box = Aabb();
+    sum = 0;
+    for (int i = binCount - 1; i > 0; --i) {
+      box.grow(b[i].bounds);
+      sum += b[i].count;
+      if (leftCount[i - 1] == 0 || sum == 0)
+        continue;
+      float cost = leftArea[i - 1] * (float)leftCount[i - 1] +
+                   box.area() * (float)sum;
+      if (cost < bestCost) {
+        bestCost = cost;
+        bestAxis = axis;
+        bestSplit = i;
+      }
+    }
+  }
+
+  float area = range.bounds.area();
+  float splitCost = kTraversalCost +
+                    (area > 0.0f ? bestCost / area : (float)count);
+  if (count <= kMaxLeafSize && (bestAxis < 0 || splitCost >= (float)count)) {
+    makeLeaf();
+    return;
+  }
+
+  // Without a plane all centroids coincide, and any split is as good
+  BuildRef *begin = &ctx.refs[first];
+  BuildRef *mid = begin + count / 2;
+  if (bestAxis >= 0)
+    mid = std::partition(begin, begin + count, [&](const BuildRef &ref) {
+      return binOf(ref, bestAxis) < bestSplit;
+    });
+  uint32_t leftCount = (uint32_t)(mid - begin);
+
+  uint32_t left = ctx.nodeCount.fetch_add(2, std::memory_order_relaxed);
+  node.leftFirst = left;
+  node.count = 0;
+  if (ctx.jobs && count >= kParallelSubtreeMin) {
+    JobCounter counter;
+    ctx.jobs->run(
+        [&] { subdivide(ctx, left, first, leftCount, depth + 1); },
+        &counter);
+    subdivide(ctx, left + 1, first + leftCount, count - leftCount,
+              depth + 1);
+    ctx.jobs->wait(counter);
+  } else {
+    subdivide(ctx, left, first, leftCount, depth + 1);
+    subdivide(ctx, left + 1, first + leftCount, count - leftCount,
+              depth + 1);
+  }
+}
+
+glm::vec3 Bvh::boundsMin() const {
+  return m_nodes.empty() ? glm::vec3(0.0f) : m_nodes[0].min;
+}
+
+glm::vec3 Bvh::boundsMax() const {
+  return m_nodes.empty() ? glm::vec3(0.0f) : m_nodes[0].max;
+}
+
+bool Bvh::intersect(const Ray &ray, RayHit &hit) const {
+  if (m_nodes.empty())
+    return false;
+  const glm::vec3 invDir = 1.0f / ray.direction;
+  float tBest = std::min(hit.t, ray.tMax);
+  uint32_t bestSlot = UINT32_MAX;
+
+  uint32_t stack[kStackSize];
+  int top = 0;
+  if (slabEntry(m_nodes[0].min, m_nodes[0].max, ray.origin, invDir, tBest) ==
+      FLT_MAX)
+    return false;
+  uint32_t current = 0;
+  for (;;) {
+    const Node &node = m_nodes[current];
+    if (node.count > 0) {
+      for (uint32_t i = node.leftFirst; i < node.leftFirst + node.count;
+           ++i) {
+        const Triangle &tri = m_triangles[i];
+        glm::vec3 p = glm::cross(ray.direction, tri.e2);
+        float det = glm::dot(tri.e1, p);
+        if (std::fabs(det) < 1e-12f)
+          continue;
+        float invDet = 1.0f / det;
+        glm::vec3 tv = ray.origin - tri.v0;
+        float u = glm::dot(tv, p) * invDet;
+        if (u < 0.0f || u > 1.0f)
+          continue;
+        glm::vec3 q = glm::cross(tv, tri.e1);
+        float v = glm::dot(ray.direction, q) * invDet;
+        if (v < 0.0f || u + v > 1.0f)
+          continue;
+        float t = glm::dot(tri.e2, q) * invDet;
+        if (t > kMinT && t < tBest) {
+          tBest = t;
+          hit.u = u;
+          hit.v = v;
+          bestSlot = i;
+        }
+      }
+    } else {
+      // Nearer child first; the other waits on the stack
+      uint32_t near = node.leftFirst, far = near + 1;
+      float tNear = slabEntry(m_nodes[near].min, m_nodes[near].max,
+                              ray.origin, invDir, tBest);
+      float tFar = slabEntry(m_nodes[far].min, m_nodes[far].max, ray.origin,
+                             invDir, tBest);
+      if (tFar < tNear) {
+        std::swap(near, far);
+        std::swap(tNear, tFar);
+      }
+      if (tNear != FLT_MAX) {
+        if (tFar != FLT_MAX) {
+          assert(top < kStackSize); // Bounded by the build's depth limit
+          stack[top++] = far;
+        }
+        current = near;
+        continue;
+      }
+    }
+    // Pop, skipping nodes that now start beyond the nearest hit
+    bool found = false;
+    while (top > 0) {
+      current = stack[--top];
+      if (slabEntry(m_nodes[current].min, m_nodes[current].max, ray.origin,
+                    invDir, tBest) != FLT_MAX) {
+        found = true;
+        break;
+      }
+    }
+    if (!found)
+      break;
+  }
+
+  if (bestSlot == UINT32_MAX)
+    return false;
+  hit.t = tBest;
+  hit.triangle = m_sourceIndex[bestSlot];
+  return true;
+}
+
+void Bvh::intersect4(const RayPacket4 &packet, PacketHit4 &hit) const {
+  for (int lane = 0; lane < 4; ++lane) {
+    hit.t[lane] = packet.tMax[lane];
+    hit.u[lane] = hit.v[lane] = 0.0f;
+    hit.triangle[lane] = UINT32_MAX;
+  }
+  if (m_nodes.empty())
+    return;
+
+#ifdef TRANSFORM_USE_SSE
+  const __m128 ox = _mm_loadu_ps(packet.ox), oy = _mm_loadu_ps(packet.oy),
+               oz = _mm_loadu_ps(packet.oz);
+  const __m128 dx = _mm_loadu_ps(packet.dx), dy = _mm_loadu_ps(packet.dy),
+               dz = _mm_loadu_ps(packet.dz);
+  const __m128 one = _mm_set1_ps(1.0f), zero = _mm_setzero_ps();
+  const __m128 idx = _mm_div_ps(one, dx), idy = _mm_div_ps(one, dy),
+               idz = _mm_div_ps(one, dz);
+  const __m128 signMask = _mm_set1_ps(-0.0f);
+  const __m128 minT = _mm_set1_ps(kMinT), minDet = _mm_set1_ps(1e-12f);
+  __m128 tBest = _mm_loadu_ps(packet.tMax);
+  __m128 uBest = zero, vBest = zero;
+  uint32_t slot[4] = {UINT32_MAX, UINT32_MAX, UINT32_MAX, UINT32_MAX};
+
+  // Lanes whose ray enters the node before its nearest hit; `entry` gets
+  // the smallest entry distance among them
+  auto testNode = [&](const Node &node, float &entry) {
+    __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.min.x), ox), idx);
+    __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.max.x), ox), idx);
+    __m128 tNear = _mm_min_ps(t0, t1), tFar = _mm_max_ps(t0, t1);
+    t0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.min.y), oy), idy);
+    t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.max.y), oy), idy);
+    tNear = _mm_max_ps(tNear, _mm_min_ps(t0, t1));
+    tFar = _mm_min_ps(tFar, _mm_max_ps(t0, t1));
+    t0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.min.z), oz), idz);
+    t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.max.z), oz), idz);
+    tNear = _mm_max_ps(_mm_max_ps(tNear, _mm_min_ps(t0, t1)), zero);
+    tFar = _mm_min_ps(_mm_min_ps(tFar, _mm_max_ps(t0, t1)), tBest);
+    int mask = _mm_movemask_ps(_mm_cmple_ps(tNear, tFar));
+    if (mask) {
+      float lanes[4];
+      _mm_storeu_ps(lanes, tNear);
+      entry = FLT_MAX;
+      for (int lane = 0; lane < 4; ++lane)
+        if (mask & (1 << lane))
+          entry = std::min(entry, lanes[lane]);
+    }
+    return mask;
+  };
+
+  uint32_t stack[kStackSize];
+  int top = 0;
+  float entry;
+  uint32_t current = 0;
+  bool active = testNode(m_nodes[0], entry) != 0;
+  while (active) {
+    const Node &node = m_nodes[current];
+    if (node.count > 0) {
+      // Moller-Trumbore, one ray per lane
+      for (uint32_t i = node.leftFirst; i < node.leftFirst + node.count;
+           ++i) {
+        const Triangle &tri = m_triangles[i];
+        const __m128 e1x = _mm_set1_ps(tri.e1.x), e1y = _mm_set1_ps(tri.e1.y),
+                     e1z = _mm_set1_ps(tri.e1.z);
+        const __m128 e2x = _mm_set1_ps(tri.e2.x), e2y = _mm_set1_ps(tri.e2.y),
+                     e2z = _mm_set1_ps(tri.e2.z);
+        __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+        __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+        __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+        __m128 det = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)),
+            _mm_mul_ps(e1z, pz));
+        __m128 invDet = _mm_div_ps(one, det);
+        __m128 tx = _mm_sub_ps(ox, _mm_set1_ps(tri.v0.x));
+        __m128 ty = _mm_sub_ps(oy, _mm_set1_ps(tri.v0.y));
+        __m128 tz = _mm_sub_ps(oz, _mm_set1_ps(tri.v0.z));
+        __m128 u = _mm_mul_ps(
+            _mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, px), _mm_mul_ps(ty, py)),
+                       _mm_mul_ps(tz, pz)),
+            invDet);
+        __m128 qx = _mm_sub_ps(_mm_mul_ps(ty, e1z), _mm_mul_ps(tz, e1y));
+        __m128 qy = _mm_sub_ps(_mm_mul_ps(tz, e1x), _mm_mul_ps(tx, e1z));
+        __m128 qz = _mm_sub_ps(_mm_mul_ps(tx, e1y), _mm_mul_ps(ty, e1x));
+        __m128 v = _mm_mul_ps(
+            _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)),
+                       _mm_mul_ps(dz, qz)),
+            invDet);
+        __m128 t = _mm_mul_ps(
+            _mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)),
+                       _mm_mul_ps(e2z, qz)),
+            invDet);
+        __m128 accept = _mm_and_ps(
+            _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmpge_ps(v, zero)),
+            _mm_cmple_ps(_mm_add_ps(u, v), one));
+        accept = _mm_and_ps(
+            accept, _mm_and_ps(_mm_cmpgt_ps(t, minT), _mm_cmplt_ps(t, tBest)));
+        accept = _mm_and_ps(
+            accept, _mm_cmpge_ps(_mm_andnot_ps(signMask, det), minDet));
+        int mask = _mm_movemask_ps(accept);
+        if (mask == 0)
+          continue;
+        tBest = _mm_or_ps(_mm_and_ps(accept, t), _mm_andnot_ps(accept, tBest));
+        uBest = _mm_or_ps(_mm_and_ps(accept, u), _mm_andnot_ps(accept, uBest));
+        vBest = _mm_or_ps(_mm_and_ps(accept, v), _mm_andnot_ps(accept, vBest));
+        for (int lane = 0; lane < 4; ++lane)
+          if (mask & (1 << lane))
+            slot[lane] = i;
+      }
+    } else {
+      uint32_t near = node.leftFirst, far = near + 1;
+      float entryNear = FLT_MAX, entryFar = FLT_MAX;
+      bool hitNear = testNode(m_nodes[near], entryNear) != 0;
+      bool hitFar = testNode(m_nodes[far], entryFar) != 0;
+      if (hitFar && (!hitNear || entryFar < entryNear)) {
+        std::swap(near, far);
+        std::swap(hitNear, hitFar);
+      }
+      if (hitNear) {
+        if (hitFar) {
+          assert(top < kStackSize); // Bounded by the build's depth limit
+          stack[top++] = far;
+        }
+        current = near;
+        continue;
+      }
+    }
+    active = false;
+    while (top > 0) {
+      current = stack[--top];
+      if (testNode(m_nodes[current], entry)) {
+        active = true;
+        break;
+      }
+    }
+  }
+
+  _mm_storeu_ps(hit.t, tBest);
+  _mm_storeu_ps(hit.u, uBest);
+  _mm_storeu_ps(hit.v, vBest);
+  for (int lane = 0; lane < 4; ++lane)
+    if (slot[lane] != UINT32_MAX)
+      hit.triangle[lane] = m_sourceIndex[slot[lane]];
+#else
+  for (int lane = 0; lane < 4; ++lane) {
+    Ray ray;
+    ray.origin = glm::vec3(packet.ox[lane], packet.oy[lane], packet.oz[lane]);
+    ray.direction =
+        glm::vec3(packet.dx[lane], packet.dy[lane], packet.dz[lane]);
+    ray.tMax = packet.tMax[lane];
+    RayHit single;
+    if (intersect(ray, single)) {
+      hit.t[lane] = single.t;
+      hit.u[lane] = single.u;
+      hit.v[lane] = single.v;
+      hit.triangle[lane] = single.triangle;
+    }
+  }
+#endif
+}
+
+struct InstanceBvh::BuildItem {
+  Placed placed;
+  glm::vec3 min, max, centroid;
+};
+
+void InstanceBvh::build(const BvhInstance *instances, size_t count) {
+  PROFILE_ZONE("InstanceBvh::build");
+  m_nodes.clear();
+  m_instances.clear();
+
+  // World bounds of each instance: its Bvh's box, transformed
+  std::vector<BuildItem> items;
+  items.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    const BvhInstance &instance = instances[i];
+    if (!instance.blas || instance.blas->empty())
+      continue;
+    glm::vec3 lo = instance.blas->boundsMin(), hi = instance.blas->boundsMax();
+    Aabb box;
+    for (int corner = 0; corner < 8; ++corner) {
+      glm::vec3 p(corner & 1 ? hi.x : lo.x, corner & 2 ? hi.y : lo.y,
+                  corner & 4 ? hi.z : lo.z);
+      box.grow(glm::vec3(instance.model * glm::vec4(p, 1.0f)));
+    }
+    BuildItem item;
+    item.placed = {instance.blas, glm::inverse(instance.model), instance.id};
+    item.min = box.min;
+    item.max = box.max;
+    item.centroid = (box.min + box.max) * 0.5f;
+    items.push_back(item);
+  }
+  if (items.empty())
+    return;
+
+  m_nodes.reserve(2 * items.size());
+  m_nodes.resize(1);
+  buildRange(items, 0, 0, (uint32_t)items.size(), 1);
+  m_instances.reserve(items.size());
+  for (const BuildItem &item : items)
+    m_instances.push_back(item.placed);
+}
+
+void InstanceBvh::buildRange(std::vector<BuildItem> &items, uint32_t node,
+                             uint32_t first, uint32_t count, int depth) {
+  Aabb bounds, centroids;
+  for (uint32_t i = first; i < first + count; ++i) {
+    bounds.grow(Aabb{items[i].min, items[i].max});
+    centroids.grow(items[i].centroid);
+  }
+  m_nodes[node].min = bounds.min;
+  m_nodes[node].max = bounds.max;
+  // Median splits stay far from the traversal stack's depth limit, but it
+  // holds here too
+  if (count <= 2 || depth >= kStackSize) {
+    m_nodes[node].leftFirst = first;
+    m_nodes[node].count = count;
+    return;
+  }
+
+  glm::vec3 extent = centroids.max - centroids.min;
+  int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2)
+                                 : (extent.y > extent.z ? 1 : 2);
+  uint32_t half = count / 2;
+  std::nth_element(items.begin() + first, items.begin() + first + half,
+                   items.begin() + first + count,
+                   [axis](const BuildItem &a, const BuildItem &b) {
+                     return a.centroid[axis] < b.centroid[axis];
+                   });
+
+  uint32_t left = (uint32_t)m_nodes.size();
+  m_nodes.resize(left + 2);
+  m_nodes[node].leftFirst = left;
+  m_nodes[node].count = 0;
+  buildRange(items, left, first, half, depth + 1);
+  buildRange(items, left + 1, first + half, count - half, depth + 1);
+}
+
+bool InstanceBvh::intersect(const Ray &ray, InstanceHit &hit) const {
+  if (m_nodes.empty())
+    return false;
+  const glm::vec3 invDir = 1.0f / ray.direction;
+  float tBest = std::min(hit.t, ray.tMax);
+  bool found = false;
+
+  uint32_t stack[kStackSize];
+  int top = 0;
+  uint32_t current = 0;
+  bool active = slabEntry(m_nodes[0].min, m_nodes[0].max, ray.origin, invDir,
+                          tBest) != FLT_MAX;
+  while (active) {
+    const BvhNode &node = m_nodes[current];
+    if (node.count > 0) {
+      for (uint32_t i = node.leftFirst; i < node.leftFirst + node.count;
+           ++i) {
+        const Placed &instance = m_instances[i];
+        Ray local;
+        local.origin =
+            glm::vec3(instance.worldToObject * glm::vec4(ray.origin, 1.0f));
+        local.direction =
+            glm::vec3(instance.worldToObject * glm::vec4(ray.direction, 0.0f));
+        local.tMax = tBest;
+        RayHit localHit;
+        if (instance.blas->intersect(local, localHit)) {
+          tBest = localHit.t;
+          hit.t = localHit.t;
+          hit.u = localHit.u;
+          hit.v = localHit.v;
+          hit.triangle = localHit.triangle;
+          hit.instance = instance.id;
+          found = true;
+        }
+      }
+    } else {
+      uint32_t near = node.leftFirst, far = near + 1;
+      float tNear = slabEntry(m_nodes[near].min, m_nodes[near].max,
+                              ray.origin, invDir, tBest);
+      float tFar = slabEntry(m_nodes[far].min, m_nodes[far].max, ray.origin,
+                             invDir, tBest);
+      if (tFar < tNear) {
+        std::swap(near, far);
+        std::swap(tNear, tFar);
+      }
+      if (tNear != FLT_MAX) {
+        if (tFar != FLT_MAX) {
+          assert(top < kStackSize); // Bounded by the build's depth limit
+          stack[top++] = far;
+        }
+        current = near;
+        continue;
+      }
+    }
+    active = false;
+    while (top > 0) {
+      current = stack[--top];
+      if (slabEntry(m_nodes[current].min, m_nodes[current].max, ray.origin,
+                    invDir, tBest) != FLT_MAX) {
+        active = true;
+        break;
+      }
+    }
+  }
+  return found;
+}
@@ -0,0 +1,323 @@
+#include "chunk_streamer.hpp"
+#include "profiler.hpp"
+#include "render_stats.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+// Reads queued or in flight at once: enough to keep the disk busy, few
+// enough that the nearest chunks are not stuck behind far ones
+const uint32_t kMaxPendingReads = 8;
+} // namespace
+
+ChunkStreamer::ChunkStreamer() {}
+
+ChunkStreamer::~ChunkStreamer() {
+  if (m_ioThread.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stop = true;
+    }
+    m_wake.notify_one();
+    m_ioThread.join();
+  }
+  for (Chunk &chunk : m_chunks)
+    for (uint32_t lod = 0; lod < kChunkLodCount; ++lod)
+      evict(chunk, lod);
+  if (m_file)
+    std::fclose(m_file);
+}
+
+bool ChunkStreamer::open(const std::string &path) {
+  PROFILE_FUNCTION();
+  if (m_file)
+    return false; // One file per streamer
+  m_file = std::fopen(path.c_str(), "rb");
+  if (!m_file)
+    return false;
+  ChunkFileHeader header;
+  std::vector<ChunkRecord> records;
+  if (!readChunkTable(m_file, header, records)) {
+    std::fprintf(stderr, "[chunks] %s is not a chunk file\n", path.c_str());
+    std::fclose(m_file);
+    m_file = nullptr;
+    return false;
+  }
+  m_chunks.resize(records.size());
+  for (size_t c = 0; c < records.size(); ++c) {
+    Chunk &chunk = m_chunks[c];
+    chunk.boundsMin = glm::vec3(records[c].boundsMin[0],
+                                records[c].boundsMin[1],
+                                records[c].boundsMin[2]);
+    chunk.boundsMax = glm::vec3(records[c].boundsMax[0],
+                                records[c].boundsMax[1],
+                                records[c].boundsMax[2]);
+    for (uint32_t lod = 0; lod < kChunkLodCount; ++lod)
+      chunk.lods[lod] = records[c].lods[lod];
+  }
+  m_stats.chunks = (uint32_t)m_chunks.size();
+  m_ioThread = std::thread(&ChunkStreamer::ioThreadMain, this);
+  return true;
+}
+
+void ChunkStreamer::ioThreadMain() {
+  Profiler::setThreadName("chunk io");
+  for (;;) {
+    Request request;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_wake.wait(lock, [&] { return m_stop || !m_requests.empty(); });
+      if (m_stop)
+        return;
+      request = m_requests.front();
+      m_requests.pop_front();
+    }
+    Result result;
+    result.chunk = request.chunk;
+    result.lod = request.lod;
+    {
+      PROFILE_ZONE("read chunk");
+      // The table is never written after open(), so reading it here is safe
+      result.ok = readChunkLod(m_file,
+                               m_chunks[request.chunk].lods[request.lod],
+                               result.vertices, result.indices);
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_results.push_back(std::move(result));
+  }
+}
+
+void ChunkStreamer::upload(Result &result) {
+  Slot &slot = m_chunks[result.chunk].slots[result.lod];
+  glGenVertexArrays(1, &slot.vao);
+  glGenBuffers(1, &slot.vbo);
+  glGenBuffers(1, &slot.ebo);
+  glBindVertexArray(slot.vao);
+  glBindBuffer(GL_ARRAY_BUFFER, slot.vbo);
+  countedBufferData(GL_ARRAY_BUFFER, result.vertices.size() * sizeof(Vertex),
+                    result.vertices.data(), GL_STATIC_DRAW);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, slot.ebo);
+  countedBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                    result.indices.size() * sizeof(uint32_t),
+                    result.indices.data(), GL_STATIC_DRAW);
+  // Same attributes as Mesh
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)0);
+  glEnableVertexAttribArray(1);
+  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                        (void *)offsetof(Vertex, Normal));
+  glEnableVertexAttribArray(2);
+  glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                        (void *)offsetof(Vertex, TexCoords));
+  glBindVertexArray(0);
+  slot.resident = true;
+  m_residentBytes += chunkLodBytes(m_chunks[result.chunk].lods[result.lod]);
+  m_stats.loads++;
+}
+
+void ChunkStreamer::evict(Chunk &chunk, uint32_t lod) {
+  Slot &slot = chunk.slots[lod];
+  if (!slot.resident)
+    return;
+  glDeleteVertexArrays(1, &slot.vao);
+  glDeleteBuffers(1, &slot.vbo);
+  glDeleteBuffers(1, &slot.ebo);
+  slot.vao = slot.vbo = slot.ebo = 0;
+  slot.resident = false;
+  m_residentBytes -= chunkLodBytes(chunk.lods[lod]);
+  m_stats.evictions++;
+}
+
+bool ChunkStreamer::makeRoom(uint64_t bytes) {
+  if (m_budget == 0)
+    return true;
+  for (auto it = m_order.rbegin();
+       it != m_order.rend() &&
+       m_residentBytes + m_pendingBytes + bytes > m_budget;
+       ++it) {
+    Chunk &chunk = m_chunks[*it];
+    for (uint32_t lod = 0; lod < kChunkLodCount; ++lod)
+      if ((int)lod != chunk.wanted)
+        evict(chunk, lod);
+  }
+  return m_residentBytes + m_pendingBytes + bytes <= m_budget;
+}
+
+void ChunkStreamer::update(const glm::vec3 &cameraPos, float pixelScale) {
+  PROFILE_FUNCTION();
+  m_stats.loads = 0;
+  m_stats.evictions = 0;
+  if (m_chunks.empty())
+    return;
+
+  // 1. Upload finished reads still wanted; drop the rest
+  std::deque<Result> results;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    results.swap(m_results);
+  }
+  for (Result &result : results) {
+    Chunk &chunk = m_chunks[result.chunk];
+    chunk.slots[result.lod].pending = false;
+    m_pendingBytes -= chunkLodBytes(chunk.lods[result.lod]);
+    m_pendingReads--;
+    if (!result.ok)
+      std::fprintf(stderr, "[chunks] cannot read chunk %u LOD %u\n",
+                   result.chunk, result.lod);
+    else if (chunk.wanted == (int)result.lod)
+      upload(result);
+  }
+
+  // 2. Screen-space error: the coarsest LOD within maxPixelError
+  std::vector<int> desired(m_chunks.size());
+  for (size_t c = 0; c < m_chunks.size(); ++c) {
+    Chunk &chunk = m_chunks[c];
+    glm::vec3 nearest = glm::clamp(cameraPos, chunk.boundsMin,
+                                   chunk.boundsMax);
+    chunk.distance = glm::length(cameraPos - nearest);
+    float pixelsPerUnit = pixelScale / std::max(chunk.distance, 1e-3f);
+    int lod = 0;
+    while (lod + 1 < (int)kChunkLodCount &&
+           chunk.lods[lod + 1].error * pixelsPerUnit <= m_maxPixelError)
+      ++lod;
+    desired[c] = lod;
+  }
+
+  // 3. Budget: every chunk first gets its coarsest LOD (nearest first,
+  // dropping the farthest if even that does not fit), then the nearest
+  // chunks are refined towards their desired LOD with what is left
+  m_order.resize(m_chunks.size());
+  for (size_t c = 0; c < m_order.size(); ++c)
+    m_order[c] = (uint32_t)c;
+  std::sort(m_order.begin(), m_order.end(), [&](uint32_t a, uint32_t b) {
+    return m_chunks[a].distance < m_chunks[b].distance;
+  });
+  const int coarsest = (int)kChunkLodCount - 1;
+  uint64_t planned = 0;
+  for (uint32_t c : m_order) {
+    Chunk &chunk = m_chunks[c];
+    uint64_t bytes = chunkLodBytes(chunk.lods[coarsest]);
+    if (m_budget && planned + bytes > m_budget) {
+      chunk.wanted = -1;
+      continue;
+    }
+    chunk.wanted = coarsest;
+    planned += bytes;
+  }
+  for (uint32_t c : m_order) {
+    Chunk &chunk = m_chunks[c];
+    if (chunk.wanted < 0)
+      continue;
+    uint64_t base = planned - chunkLodBytes(chunk.lods[coarsest]);
+    int lod = desired[c];
+    while (m_budget && lod < coarsest &&
+           base + chunkLodBytes(chunk.lods[lod]) > m_budget)
+      ++lod;
+    chunk.wanted = lod;
+    planned = base + chunkLodBytes(chunk.lods[lod]);
+  }
+
+  // 4. Other LODs go once the wanted one is drawable; they stay as a
+  // fallback meanwhile, while memory allows
+  for (Chunk &chunk : m_chunks) {
+    bool wantedReady =
+        chunk.wanted < 0 || chunk.slots[chunk.wanted].resident;
+    if (!wantedReady)
+      continue;
+    for (uint32_t lod = 0; lod < kChunkLodCount; ++lod)
+      if ((int)lod != chunk.wanted)
+        evict(chunk, lod);
+  }
+
+  // 5. Queue reads of missing wanted LODs, nearest first
+  std::vector<Request> requests;
+  for (uint32_t c : m_order) {
+    if (m_pendingReads >= kMaxPendingReads)
+      break;
+    Chunk &chunk = m_chunks[c];
+    if (chunk.wanted < 0)
+      continue;
+    Slot &slot = chunk.slots[chunk.wanted];
+    if (slot.resident || slot.pending)
+      continue;
+    uint64_t bytes = chunkLodBytes(chunk.lods[chunk.wanted]);
+    if (!makeRoom(bytes))
+      break; // Wait for reads in flight to land
+    slot.pending = true;
+    m_pendingBytes += bytes;
+    m_pendingReads++;
+    requests.push_back(Request{c, (uint32_t)chunk.wanted});
+  }
+  if (!requests.empty()) {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_requests.insert(m_requests.end(), requests.begin(), requests.end());
+    }
+    m_wake.notify_one();
+  }
+
+  m_stats.pending = m_pendingReads;
+  m_stats.residentBytes = m_residentBytes;
+  m_stats.budgetBytes = m_budget;
+}
+
+void ChunkStreamer::evictAll() {
+  if (m_residentBytes == 0 && m_pendingReads == 0)
+    return;
+  std::deque<Result> results;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    results.swap(m_results);
+  }
+  for (const Result &result : results) {
+    Chunk &chunk = m_chunks[result.chunk];
+    chunk.slots[result.lod].pending = false;
+    m_pendingBytes -= chunkLodBytes(chunk.lods[result.lod]);
+    m_pendingReads--;
+  }
+  for (Chunk &chunk : m_chunks) {
+    chunk.wanted = -1;
+    for (uint32_t lod = 0; lod < kChunkLodCount; ++lod)
+      evict(chunk, lod);
+  }
+  m_stats.pending = m_pendingReads;
+  m_stats.residentBytes = m_residentBytes;
+}
+
+void ChunkStreamer::collectDraws(const Frustum &frustum,
+                                 std::vector<ChunkDraw> &draws) {
+  PROFILE_FUNCTION();
+  m_stats.drawn = 0;
+  m_stats.missing = 0;
+  for (uint32_t lod = 0; lod < kChunkLodCount; ++lod)
+    m_stats.drawnPerLod[lod] = 0;
+  for (const Chunk &chunk : m_chunks) {
+    glm::vec3 center = (chunk.boundsMin + chunk.boundsMax) * 0.5f;
+    float radius = glm::length(chunk.boundsMax - center);
+    if (!sphereInFrustum(frustum, center, radius))
+      continue;
+    // The wanted LOD, else the resident one nearest to it
+    int best = -1;
+    for (int lod = 0; lod < (int)kChunkLodCount; ++lod) {
+      if (!chunk.slots[lod].resident)
+        continue;
+      int target = chunk.wanted < 0 ? (int)kChunkLodCount - 1 : chunk.wanted;
+      if (best < 0 || std::abs(lod - target) < std::abs(best - target))
+        best = lod;
+    }
+    if (best < 0) {
+      m_stats.missing++;
+      continue;
+    }
+    m_stats.drawn++;
+    m_stats.drawnPerLod[best]++;
+    if (chunk.lods[best].indexCount == 0)
+      continue; // Collapsed entirely at this LOD
+    ChunkDraw draw;
+    draw.vao = chunk.slots[best].vao;
+    draw.indexCount = (GLsizei)chunk.lods[best].indexCount;
+    draw.lod = (uint32_t)best;
+    draw.distance = chunk.distance;
+    draws.push_back(draw);
+  }
+}
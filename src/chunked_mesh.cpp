@@ -0,0 +1,605 @@
+#include "chunked_mesh.hpp"
+#include "job_system.hpp"
+#include "profiler.hpp"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+
+namespace {
+const char kMagic[4] = {'T', 'P', '2', 'C'};
+const uint32_t kVersion = 2;
+
+// Most buckets one set of triangles is binned into (open files at once)
+const uint32_t kMaxBuckets = 256;
+// Triangles gathered before the jobs of the binning pass run
+const size_t kPassBlock = 1u << 16;
+
+// 64-bit seeks: chunk files can be far larger than 2 GB
+bool seekTo(FILE *file, uint64_t offset) {
+#ifdef _WIN32
+  return _fseeki64(file, (__int64)offset, SEEK_SET) == 0;
+#else
+  return fseeko(file, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+uint64_t alignToPage(uint64_t offset) {
+  return (offset + kChunkPageSize - 1) / kChunkPageSize * kChunkPageSize;
+}
+
+// Vertex welded by exact value (LOD 0)
+struct VertexKey {
+  Vertex v;
+  bool operator==(const VertexKey &o) const {
+    return std::memcmp(&v, &o.v, sizeof(Vertex)) == 0;
+  }
+};
+struct VertexKeyHash {
+  size_t operator()(const VertexKey &key) const {
+    // FNV-1a over the bytes
+    const unsigned char *bytes = (const unsigned char *)&key.v;
+    uint64_t hash = 1469598103934665603ull;
+    for (size_t i = 0; i < sizeof(Vertex); ++i)
+      hash = (hash ^ bytes[i]) * 1099511628211ull;
+    return (size_t)hash;
+  }
+};
+
+// Cell of the clustering grid of one LOD, three 21-bit coordinates
+struct LodGrid {
+  glm::vec3 origin;
+  float cellSize;
+
+  uint64_t cell(const glm::vec3 &p) const {
+    glm::vec3 q = (p - origin) / cellSize;
+    uint64_t x = (uint64_t)std::min(std::max(q.x, 0.0f), 2097151.0f);
+    uint64_t y = (uint64_t)std::min(std::max(q.y, 0.0f), 2097151.0f);
+    uint64_t z = (uint64_t)std::min(std::max(q.z, 0.0f), 2097151.0f);
+    return x << 42 | y << 21 | z;
+  }
+};
+
+// Chunk geometry as built, before it is written
+struct ChunkData {
+  glm::vec3 boundsMin, boundsMax;
+  struct Lod {
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    float error = 0.0f;
+  } lods[kChunkLodCount];
+};
+
+// Running sums of the vertices that fall in each cell of a LOD grid
+struct CellSum {
+  glm::vec3 position = glm::vec3(0.0f), normal = glm::vec3(0.0f);
+  glm::vec2 uv = glm::vec2(0.0f);
+  float count = 0.0f;
+};
+typedef std::unordered_map<uint64_t, CellSum> CellSums;
+
+void addToCells(const std::vector<Vertex> &vertices, const LodGrid &grid,
+                CellSums &sums) {
+  for (const Vertex &v : vertices) {
+    CellSum &sum = sums[grid.cell(v.Position)];
+    sum.position += v.Position;
+    sum.normal += v.Normal;
+    sum.uv += v.TexCoords;
+    sum.count += 1.0f;
+  }
+}
+
+// Each cell's representative: the average of the vertices in it
+void finishClusters(const CellSums &sums,
+                    std::unordered_map<uint64_t, Vertex> &clusters) {
+  clusters.clear();
+  clusters.reserve(sums.size());
+  for (const auto &entry : sums) {
+    const CellSum &sum = entry.second;
+    Vertex v;
+    v.Position = sum.position / sum.count;
+    float length = glm::length(sum.normal);
+    v.Normal = length > 0.0f ? sum.normal / length : glm::vec3(0, 1, 0);
+    v.TexCoords = sum.uv / sum.count;
+    clusters[entry.first] = v;
+  }
+}
+
+// Triangles parked on disk until they are refined
+struct Bucket {
+  std::string path;
+  uint64_t triangles = 0;
+  glm::vec3 lo = glm::vec3(FLT_MAX), hi = glm::vec3(-FLT_MAX); // Centroids
+};
+
+// Bins triangles by centroid into equal slabs of [lo, hi] along its
+// longest axis, one file per non-empty slab
+class BucketWriter {
+public:
+  BucketWriter(const std::string &prefix, const glm::vec3 &lo,
+               const glm::vec3 &hi, uint32_t slabs, uint32_t &counter)
+      : m_prefix(prefix), m_counter(counter), m_buckets(slabs),
+        m_files(slabs, nullptr) {
+    glm::vec3 extent = hi - lo;
+    m_axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2)
+                                 : (extent.y > extent.z ? 1 : 2);
+    m_lo = lo[m_axis];
+    m_extent = extent[m_axis];
+  }
+
+  ~BucketWriter() {
+    for (size_t b = 0; b < m_files.size(); ++b)
+      if (m_files[b]) {
+        std::fclose(m_files[b]);
+        std::remove(m_buckets[b].path.c_str());
+      }
+  }
+
+  void add(const Vertex *triangle) {
+    glm::vec3 centroid = (triangle[0].Position + triangle[1].Position +
+                          triangle[2].Position) /
+                         3.0f;
+    float t = m_extent > 0.0f ? (centroid[m_axis] - m_lo) / m_extent : 0.0f;
+    size_t b = (size_t)std::min(std::max(t * (float)m_buckets.size(), 0.0f),
+                                (float)(m_buckets.size() - 1));
+    Bucket &bucket = m_buckets[b];
+    if (!m_files[b]) {
+      bucket.path = m_prefix + std::to_string(m_counter++);
+      m_files[b] = std::fopen(bucket.path.c_str(), "wb");
+      if (!m_files[b]) {
+        std::fprintf(stderr, "[chunks] cannot create %s\n",
+                     bucket.path.c_str());
+        m_ok = false;
+        return;
+      }
+    }
+    if (std::fwrite(triangle, sizeof(Vertex), 3, m_files[b]) != 3)
+      m_ok = false;
+    bucket.triangles++;
+    bucket.lo = glm::min(bucket.lo, centroid);
+    bucket.hi = glm::max(bucket.hi, centroid);
+  }
+
+  // Closes the files and appends the non-empty buckets
+  bool finish(std::vector<Bucket> &buckets) {
+    for (size_t b = 0; b < m_files.size(); ++b) {
+      if (!m_files[b])
+        continue;
+      m_ok = std::fclose(m_files[b]) == 0 && m_ok;
+      m_files[b] = nullptr;
+      buckets.push_back(m_buckets[b]);
+    }
+    return m_ok;
+  }
+
+private:
+  std::string m_prefix;
+  uint32_t &m_counter;
+  int m_axis;
+  float m_lo, m_extent;
+  std::vector<Bucket> m_buckets;
+  std::vector<FILE *> m_files;
+  bool m_ok = true;
+};
+
+// Slabs for `triangles` so that evenly spread ones fill buckets of at most
+// `bucketTriangles`; a power of two, so the slabs fall where the median
+// splits of the whole mesh would
+uint32_t slabCount(uint64_t triangles, size_t bucketTriangles) {
+  uint32_t slabs = 1;
+  while (slabs < kMaxBuckets && triangles > slabs * (uint64_t)bucketTriangles)
+    slabs *= 2;
+  return slabs;
+}
+
+bool readBucket(const Bucket &bucket, std::vector<Vertex> &triangles) {
+  FILE *file = std::fopen(bucket.path.c_str(), "rb");
+  if (!file)
+    return false;
+  triangles.resize((size_t)bucket.triangles * 3);
+  bool ok = std::fread(triangles.data(), sizeof(Vertex), triangles.size(),
+                       file) == triangles.size();
+  std::fclose(file);
+  return ok;
+}
+
+// A bucket too large to refine is read back in blocks and binned again
+bool rebinBucket(const Bucket &bucket, BucketWriter &writer) {
+  FILE *file = std::fopen(bucket.path.c_str(), "rb");
+  if (!file)
+    return false;
+  std::vector<Vertex> block(kPassBlock * 3);
+  uint64_t left = bucket.triangles;
+  bool ok = true;
+  while (ok && left > 0) {
+    size_t count = (size_t)std::min<uint64_t>(left, kPassBlock);
+    ok = std::fread(block.data(), sizeof(Vertex), count * 3, file) ==
+         count * 3;
+    for (size_t t = 0; ok && t < count; ++t)
+      writer.add(&block[3 * t]);
+    left -= count;
+  }
+  std::fclose(file);
+  return ok;
+}
+
+// Triangles of [begin, end) of `order` welded into an indexed mesh
+void buildLod0(const std::vector<Vertex> &triangles,
+               const uint32_t *order, size_t count, ChunkData::Lod &lod) {
+  std::unordered_map<VertexKey, uint32_t, VertexKeyHash> welded;
+  welded.reserve(count * 3);
+  lod.indices.reserve(count * 3);
+  for (size_t t = 0; t < count; ++t) {
+    for (int k = 0; k < 3; ++k) {
+      VertexKey key = {triangles[3 * (size_t)order[t] + k]};
+      auto inserted = welded.emplace(key, (uint32_t)lod.vertices.size());
+      if (inserted.second)
+        lod.vertices.push_back(key.v);
+      lod.indices.push_back(inserted.first->second);
+    }
+  }
+  lod.error = 0.0f;
+}
+
+// Triangles snapped to their cells' shared vertices; those whose corners
+// share a cell collapse and are dropped
+void buildClusteredLod(const std::vector<Vertex> &triangles,
+                       const uint32_t *order, size_t count,
+                       const LodGrid &grid,
+                       const std::unordered_map<uint64_t, Vertex> &clusters,
+                       ChunkData::Lod &lod) {
+  std::unordered_map<uint64_t, uint32_t> local;
+  for (size_t t = 0; t < count; ++t) {
+    uint64_t cells[3];
+    for (int k = 0; k < 3; ++k)
+      cells[k] = grid.cell(triangles[3 * (size_t)order[t] + k].Position);
+    if (cells[0] == cells[1] || cells[1] == cells[2] || cells[0] == cells[2])
+      continue;
+    for (int k = 0; k < 3; ++k) {
+      auto inserted = local.emplace(cells[k], (uint32_t)lod.vertices.size());
+      if (inserted.second)
+        lod.vertices.push_back(clusters.at(cells[k]));
+      lod.indices.push_back(inserted.first->second);
+    }
+  }
+  // A vertex moves at most to the far corner of its cell
+  lod.error = grid.cellSize * std::sqrt(3.0f);
+}
+
+// Split one bucket's triangles into chunks by recursive median splits
+// along the longest axis of the centroids' bounds (the leaves, in
+// depth-first order, are the chunks), then build every chunk's LODs, one
+// chunk per job
+void buildBucketChunks(
+    const std::vector<Vertex> &triangles, size_t maxTriangles,
+    const LodGrid *grids,
+    const std::unordered_map<uint64_t, Vertex> *clusters,
+    std::vector<ChunkData> &chunks, JobSystem *jobs) {
+  PROFILE_FUNCTION();
+  const size_t triangleCount = triangles.size() / 3;
+  std::vector<glm::vec3> centroids(triangleCount);
+  std::vector<uint32_t> order(triangleCount);
+  for (size_t t = 0; t < triangleCount; ++t) {
+    const Vertex *v = &triangles[3 * t];
+    centroids[t] = (v[0].Position + v[1].Position + v[2].Position) / 3.0f;
+    order[t] = (uint32_t)t;
+  }
+
+  struct Range {
+    size_t begin, end;
+  };
+  std::vector<Range> leaves;
+  std::vector<Range> stack(1, Range{0, triangleCount});
+  while (!stack.empty()) {
+    Range range = stack.back();
+    stack.pop_back();
+    size_t count = range.end - range.begin;
+    if (count <= maxTriangles) {
+      if (count > 0)
+        leaves.push_back(range);
+      continue;
+    }
+    glm::vec3 lo(FLT_MAX), hi(-FLT_MAX);
+    for (size_t i = range.begin; i < range.end; ++i) {
+      lo = glm::min(lo, centroids[order[i]]);
+      hi = glm::max(hi, centroids[order[i]]);
+    }
+    glm::vec3 extent = hi - lo;
+    int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2)
+                                   : (extent.y > extent.z ? 1 : 2);
+    size_t mid = range.begin + count / 2;
+    std::nth_element(order.begin() + range.begin, order.begin() + mid,
+                     order.begin() + range.end, [&](uint32_t a, uint32_t b) {
+                       return centroids[a][axis] < centroids[b][axis];
+                     });
+    stack.push_back(Range{mid, range.end});
+    stack.push_back(Range{range.begin, mid});
+  }
+
+  chunks.clear();
+  chunks.resize(leaves.size());
+  auto buildRange = [&](size_t begin, size_t end) {
+    for (size_t c = begin; c < end; ++c) {
+      const uint32_t *chunkOrder = &order[leaves[c].begin];
+      size_t count = leaves[c].end - leaves[c].begin;
+      glm::vec3 lo(FLT_MAX), hi(-FLT_MAX);
+      for (size_t t = 0; t < count; ++t)
+        for (int k = 0; k < 3; ++k) {
+          const glm::vec3 &p =
+              triangles[3 * (size_t)chunkOrder[t] + k].Position;
+          lo = glm::min(lo, p);
+          hi = glm::max(hi, p);
+        }
+      chunks[c].boundsMin = lo;
+      chunks[c].boundsMax = hi;
+      buildLod0(triangles, chunkOrder, count, chunks[c].lods[0]);
+      for (uint32_t lod = 1; lod < kChunkLodCount; ++lod)
+        buildClusteredLod(triangles, chunkOrder, count, grids[lod],
+                          clusters[lod], chunks[c].lods[lod]);
+    }
+  };
+  if (jobs)
+    jobs->parallelFor(chunks.size(), 1, buildRange);
+  else
+    buildRange(0, chunks.size());
+}
+
+// Appends one chunk's LOD blobs at `offset` (page aligned) and fills its
+// table entry
+bool writeChunk(FILE *file, const ChunkData &chunk, uint64_t &offset,
+                ChunkRecord &record) {
+  for (int i = 0; i < 3; ++i) {
+    record.boundsMin[i] = chunk.boundsMin[i];
+    record.boundsMax[i] = chunk.boundsMax[i];
+  }
+  for (uint32_t lod = 0; lod < kChunkLodCount; ++lod) {
+    const ChunkData::Lod &data = chunk.lods[lod];
+    ChunkLod &entry = record.lods[lod];
+    entry.offset = offset;
+    entry.vertexCount = (uint32_t)data.vertices.size();
+    entry.indexCount = (uint32_t)data.indices.size();
+    entry.error = data.error;
+    entry.padding = 0;
+    bool ok = seekTo(file, offset) &&
+              (data.vertices.empty() ||
+               std::fwrite(data.vertices.data(), sizeof(Vertex),
+                           data.vertices.size(),
+                           file) == data.vertices.size()) &&
+              (data.indices.empty() ||
+               std::fwrite(data.indices.data(), sizeof(uint32_t),
+                           data.indices.size(), file) == data.indices.size());
+    if (!ok)
+      return false;
+    offset = alignToPage(offset + chunkLodBytes(entry));
+  }
+  return true;
+}
+} // namespace
+
+bool buildChunkFile(const std::string &path, const TriangleSource &source,
+                    const ChunkBuildOptions &options, ChunkBuildStats &stats,
+                    JobSystem *jobs) {
+  PROFILE_FUNCTION();
+  stats = ChunkBuildStats();
+  const size_t maxTriangles = std::max<size_t>(options.maxTriangles, 1);
+  const size_t bucketTriangles =
+      std::max(options.bucketTriangles, maxTriangles);
+
+  // 1. Bounds, and the mean edge length that sizes the LOD grids
+  glm::vec3 meshMin(FLT_MAX), meshMax(-FLT_MAX);
+  glm::vec3 centroidMin(FLT_MAX), centroidMax(-FLT_MAX);
+  double edgeSum = 0.0;
+  {
+    PROFILE_ZONE("buildChunkFile::bounds");
+    bool ok = source([&](const Vertex *triangle) {
+      glm::vec3 centroid(0.0f);
+      for (int k = 0; k < 3; ++k) {
+        const glm::vec3 &p = triangle[k].Position;
+        meshMin = glm::min(meshMin, p);
+        meshMax = glm::max(meshMax, p);
+        centroid += p / 3.0f;
+        edgeSum += glm::length(triangle[(k + 1) % 3].Position - p);
+      }
+      centroidMin = glm::min(centroidMin, centroid);
+      centroidMax = glm::max(centroidMax, centroid);
+      stats.triangles++;
+    });
+    if (!ok)
+      return false;
+  }
+  if (stats.triangles == 0) {
+    std::fprintf(stderr, "[chunks] no triangles to write to %s\n",
+                 path.c_str());
+    return false;
+  }
+
+  // A cell about two edges across keeps roughly a quarter of a surface's
+  // vertices at LOD 1, and each doubling of the cell quarters them again
+  float lod1Cell = (float)(2.0 * edgeSum / (3.0 * (double)stats.triangles));
+  if (!(lod1Cell > 0.0f))
+    lod1Cell = 1.0f;
+  LodGrid grids[kChunkLodCount];
+  for (uint32_t lod = 1; lod < kChunkLodCount; ++lod) {
+    grids[lod].origin = meshMin;
+    grids[lod].cellSize = lod1Cell * (float)(1u << (lod - 1));
+  }
+
+  // 2. Bin the triangles into buckets and sum the LOD grid cells. Per
+  // block of triangles, the binning and each LOD's sums are one job each.
+  const std::string prefix = path + ".bucket";
+  uint32_t bucketCounter = 0;
+  std::vector<Bucket> buckets;
+  std::unordered_map<uint64_t, Vertex> clusters[kChunkLodCount];
+  {
+    PROFILE_ZONE("buildChunkFile::bin");
+    CellSums sums[kChunkLodCount];
+    BucketWriter writer(prefix, centroidMin, centroidMax,
+                        slabCount(stats.triangles, bucketTriangles),
+                        bucketCounter);
+    std::vector<Vertex> block;
+    block.reserve(kPassBlock * 3);
+    auto passRange = [&](size_t begin, size_t end) {
+      for (size_t job = begin; job < end; ++job) {
+        if (job == 0) {
+          for (size_t v = 0; v < block.size(); v += 3)
+            writer.add(&block[v]);
+        } else {
+          addToCells(block, grids[job], sums[job]);
+        }
+      }
+    };
+    auto flush = [&] {
+      if (jobs)
+        jobs->parallelFor(kChunkLodCount, 1, passRange);
+      else
+        passRange(0, kChunkLodCount);
+      block.clear();
+    };
+    bool ok = source([&](const Vertex *triangle) {
+      block.insert(block.end(), triangle, triangle + 3);
+      if (block.size() == kPassBlock * 3)
+        flush();
+    });
+    flush();
+    ok = writer.finish(buckets) && ok;
+    if (!ok) {
+      for (const Bucket &bucket : buckets)
+        std::remove(bucket.path.c_str());
+      return false;
+    }
+    auto clusterRange = [&](size_t begin, size_t end) {
+      for (size_t lod = begin; lod < end; ++lod) {
+        finishClusters(sums[lod], clusters[lod]);
+        CellSums().swap(sums[lod]);
+      }
+    };
+    if (jobs)
+      jobs->parallelFor(kChunkLodCount - 1, 1, [&](size_t begin, size_t end) {
+        clusterRange(begin + 1, end + 1);
+      });
+    else
+      clusterRange(1, kChunkLodCount);
+  }
+
+  // 3. Refine the buckets one at a time, depth first so that chunks near
+  // each other in space stay near each other in the file
+  FILE *file = std::fopen(path.c_str(), "wb");
+  if (!file) {
+    std::fprintf(stderr, "[chunks] cannot create %s\n", path.c_str());
+    for (const Bucket &bucket : buckets)
+      std::remove(bucket.path.c_str());
+    return false;
+  }
+  ChunkFileHeader header = {};
+  bool ok = std::fwrite(&header, sizeof header, 1, file) == 1;
+  uint64_t offset = alignToPage(sizeof header);
+  std::vector<ChunkRecord> records;
+  std::vector<Bucket> pending(buckets.rbegin(), buckets.rend());
+  while (ok && !pending.empty()) {
+    Bucket bucket = pending.back();
+    pending.pop_back();
+    bool splittable = bucket.hi.x > bucket.lo.x ||
+                      bucket.hi.y > bucket.lo.y || bucket.hi.z > bucket.lo.z;
+    if (bucket.triangles > bucketTriangles && splittable) {
+      PROFILE_ZONE("buildChunkFile::rebin");
+      std::vector<Bucket> parts;
+      {
+        BucketWriter writer(
+            prefix, bucket.lo, bucket.hi,
+            std::max(slabCount(bucket.triangles, bucketTriangles), 2u),
+            bucketCounter);
+        ok = rebinBucket(bucket, writer);
+        ok = writer.finish(parts) && ok;
+      }
+      std::remove(bucket.path.c_str());
+      pending.insert(pending.end(), parts.rbegin(), parts.rend());
+      continue;
+    }
+
+    std::vector<Vertex> triangles;
+    ok = readBucket(bucket, triangles);
+    std::remove(bucket.path.c_str());
+    if (!ok)
+      break;
+    stats.buckets++;
+    stats.largestBucket = std::max(stats.largestBucket, bucket.triangles);
+    std::vector<ChunkData> chunks;
+    buildBucketChunks(triangles, maxTriangles, grids, clusters, chunks, jobs);
+    std::vector<Vertex>().swap(triangles);
+
+    PROFILE_ZONE("buildChunkFile::write");
+    for (size_t c = 0; c < chunks.size() && ok; ++c) {
+      ChunkRecord record;
+      ok = writeChunk(file, chunks[c], offset, record);
+      records.push_back(record);
+      for (uint32_t lod = 0; lod < kChunkLodCount; ++lod) {
+        stats.lodTriangles[lod] += record.lods[lod].indexCount / 3;
+        stats.lodVertices[lod] += record.lods[lod].vertexCount;
+        stats.lodError[lod] = record.lods[lod].error;
+      }
+      chunks[c] = ChunkData(); // Written: free it now
+    }
+  }
+  for (const Bucket &bucket : pending)
+    std::remove(bucket.path.c_str());
+
+  // 4. The table after the last blob, then the header pointing at it
+  std::memcpy(header.magic, kMagic, 4);
+  header.version = kVersion;
+  header.vertexSize = (uint32_t)sizeof(Vertex);
+  header.lodCount = kChunkLodCount;
+  header.chunkCount = (uint32_t)records.size();
+  header.pageSize = kChunkPageSize;
+  for (int i = 0; i < 3; ++i) {
+    header.boundsMin[i] = meshMin[i];
+    header.boundsMax[i] = meshMax[i];
+  }
+  header.tableOffset = offset;
+  ok = ok && seekTo(file, offset) &&
+       (records.empty() ||
+        std::fwrite(records.data(), sizeof(ChunkRecord), records.size(),
+                    file) == records.size()) &&
+       seekTo(file, 0) && std::fwrite(&header, sizeof header, 1, file) == 1;
+  ok = std::fclose(file) == 0 && ok;
+  if (!ok) {
+    std::fprintf(stderr, "[chunks] cannot write %s\n", path.c_str());
+    std::remove(path.c_str());
+    return false;
+  }
+  stats.chunks = (uint32_t)records.size();
+  return true;
+}
+
+bool readChunkTable(FILE *file, ChunkFileHeader &header,
+                    std::vector<ChunkRecord> &records) {
+  if (!seekTo(file, 0) || std::fread(&header, sizeof header, 1, file) != 1)
+    return false;
+  if (std::memcmp(header.magic, kMagic, 4) || header.version != kVersion ||
+      header.vertexSize != sizeof(Vertex) ||
+      header.lodCount != kChunkLodCount || header.chunkCount > (1u << 24))
+    return false;
+  records.resize(header.chunkCount);
+  return records.empty() ||
+         (seekTo(file, header.tableOffset) &&
+          std::fread(records.data(), sizeof(ChunkRecord), records.size(),
+                     file) == records.size());
+}
+
+bool readChunkLod(FILE *file, const ChunkLod &lod,
+                  std::vector<Vertex> &vertices,
+                  std::vector<uint32_t> &indices) {
+  vertices.resize(lod.vertexCount);
+  indices.resize(lod.indexCount);
+  bool ok = seekTo(file, lod.offset) &&
+            (vertices.empty() ||
+             std::fread(vertices.data(), sizeof(Vertex), vertices.size(),
+                        file) == vertices.size()) &&
+            (indices.empty() ||
+             std::fread(indices.data(), sizeof(uint32_t), indices.size(),
+                        file) == indices.size());
+  for (size_t i = 0; ok && i < indices.size(); ++i)
+    ok = indices[i] < vertices.size(); // Never hand GL a bad index
+  return ok;
+}
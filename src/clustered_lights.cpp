@@ -0,0 +1,230 @@
+#include "clustered_lights.hpp"
+#include "job_system.hpp"
+#include "profiler.hpp"
+#include "render_stats.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace {
+const int kTilesPerSlice = LightClusters::kTilesX * LightClusters::kTilesY;
+// Lights per job of the eye-space pass
+const size_t kLightGrain = 256;
+
+// Squared distance from p to the box [lo, hi]
+float distanceSquared(const glm::vec3 &p, const glm::vec3 &lo,
+                      const glm::vec3 &hi) {
+  glm::vec3 d = glm::max(lo - p, glm::max(p - hi, glm::vec3(0.0f)));
+  return glm::dot(d, d);
+}
+
+// Tile range covered by [lo, hi] (tangents at depth 1) along one axis
+void tileRange(float lo, float hi, float tanHalf, int tiles, int &first,
+               int &last) {
+  first = (int)std::floor((lo / tanHalf * 0.5f + 0.5f) * tiles);
+  last = (int)std::floor((hi / tanHalf * 0.5f + 0.5f) * tiles);
+  first = std::max(first, 0);
+  last = std::min(last, tiles - 1);
+}
+} // namespace
+
+float LightClusters::sliceDepth(int slice) const {
+  if (slice <= 0)
+    return 0.0f; // Slice 0 also takes everything nearer than zNear
+  return m_camera.zNear *
+         std::exp(m_logRatio * (float)slice / (float)kSlices);
+}
+
+void LightClusters::build(const PointLight *lights, size_t lightCount,
+                          const ClusterCamera &camera, ClusterLists &out,
+                          JobSystem *jobs) {
+  PROFILE_FUNCTION();
+  uint64_t startNs = Profiler::nowNs();
+  m_camera = camera;
+  m_tanY = std::tan(0.5f * camera.fovY);
+  m_tanX = m_tanY * camera.aspect;
+  m_logRatio = std::log(camera.zFar / camera.zNear);
+
+  size_t count = std::min(lightCount, (size_t)kMaxLights);
+  if (count < lightCount)
+    std::fprintf(stderr, "[clusters] %zu lights, only %u are binned\n",
+                 lightCount, kMaxLights);
+
+  // Eye space, depth range and texels of every light
+  m_eyeLights.resize(count);
+  out.lights.resize(2 * count);
+  auto toEye = [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      const PointLight &light = lights[i];
+      EyeLight &eye = m_eyeLights[i];
+      eye.center = glm::vec3(camera.view * glm::vec4(light.position, 1.0f));
+      eye.radius = light.radius;
+      out.lights[2 * i] = glm::vec4(eye.center, light.radius);
+      out.lights[2 * i + 1] = glm::vec4(light.color, 0.0f);
+
+      float nearest = -eye.center.z - light.radius;
+      float farthest = -eye.center.z + light.radius;
+      if (farthest <= 0.0f || nearest > camera.zFar) {
+        eye.firstSlice = eye.lastSlice = -1;
+        continue;
+      }
+      auto sliceOf = [&](float depth) {
+        if (depth <= camera.zNear)
+          return 0;
+        int slice = (int)(std::log(depth / camera.zNear) / m_logRatio *
+                          (float)kSlices);
+        return std::min(slice, kSlices - 1);
+      };
+      eye.firstSlice = sliceOf(nearest);
+      eye.lastSlice = sliceOf(farthest);
+    }
+  };
+  if (jobs && count > kLightGrain)
+    jobs->parallelFor(count, kLightGrain, toEye);
+  else
+    toEye(0, count);
+
+  // One job per depth slice; each only writes its own clusters
+  m_counts.assign(kClusterCount, 0);
+  m_slicePairs.resize(kSlices);
+  m_sliceIndices.resize(kSlices);
+  if (jobs)
+    jobs->parallelFor(kSlices, 1, [&](size_t begin, size_t end) {
+      for (size_t slice = begin; slice < end; ++slice)
+        binSlice((int)slice);
+    });
+  else
+    for (int slice = 0; slice < kSlices; ++slice)
+      binSlice(slice);
+
+  // Concatenate the slices
+  out.grid.resize(2 * kClusterCount);
+  out.indices.clear();
+  out.maxPerCluster = 0;
+  uint32_t offset = 0;
+  for (int slice = 0; slice < kSlices; ++slice) {
+    out.indices.insert(out.indices.end(), m_sliceIndices[slice].begin(),
+                       m_sliceIndices[slice].end());
+    for (int tile = 0; tile < kTilesPerSlice; ++tile) {
+      int cluster = slice * kTilesPerSlice + tile;
+      out.grid[2 * cluster] = offset;
+      out.grid[2 * cluster + 1] = m_counts[cluster];
+      offset += m_counts[cluster];
+      out.maxPerCluster = std::max(out.maxPerCluster, m_counts[cluster]);
+    }
+  }
+  out.binMs = (float)(Profiler::nowNs() - startNs) * 1e-6f;
+}
+
+void LightClusters::binSlice(int slice) {
+  float z0 = sliceDepth(slice);
+  float z1 = slice == kSlices - 1 ? m_camera.zFar : sliceDepth(slice + 1);
+  uint32_t *counts = &m_counts[slice * kTilesPerSlice];
+
+  // (tile << 16 | light) for every overlap, in light order
+  std::vector<uint32_t> &pairs = m_slicePairs[slice];
+  pairs.clear();
+  for (uint32_t i = 0; i < (uint32_t)m_eyeLights.size(); ++i) {
+    const EyeLight &light = m_eyeLights[i];
+    if (light.firstSlice < 0 || slice < light.firstSlice ||
+        slice > light.lastSlice)
+      continue;
+
+    // Screen bounds of the light's box cut to this slice; x / z is
+    // monotonic in both, so the corners give the extremes
+    float depth = -light.center.z;
+    float zLo = std::max(std::max(z0, depth - light.radius), 1e-4f);
+    float zHi = std::min(z1, depth + light.radius);
+    if (zHi < zLo)
+      continue;
+    float loX = light.center.x - light.radius;
+    float hiX = light.center.x + light.radius;
+    float loY = light.center.y - light.radius;
+    float hiY = light.center.y + light.radius;
+    int tx0, tx1, ty0, ty1;
+    tileRange(std::min(loX / zLo, loX / zHi), std::max(hiX / zLo, hiX / zHi),
+              m_tanX, kTilesX, tx0, tx1);
+    tileRange(std::min(loY / zLo, loY / zHi), std::max(hiY / zLo, hiY / zHi),
+              m_tanY, kTilesY, ty0, ty1);
+
+    // Then the sphere against each cluster's eye-space box
+    float radius2 = light.radius * light.radius;
+    for (int ty = ty0; ty <= ty1; ++ty) {
+      float tb = ((float)ty / kTilesY * 2.0f - 1.0f) * m_tanY;
+      float tt = ((float)(ty + 1) / kTilesY * 2.0f - 1.0f) * m_tanY;
+      for (int tx = tx0; tx <= tx1; ++tx) {
+        float tl = ((float)tx / kTilesX * 2.0f - 1.0f) * m_tanX;
+        float tr = ((float)(tx + 1) / kTilesX * 2.0f - 1.0f) * m_tanX;
+        glm::vec3 boxLo(std::min(tl * z0, tl * z1),
+                        std::min(tb * z0, tb * z1), -z1);
+        glm::vec3 boxHi(std::max(tr * z0, tr * z1),
+                        std::max(tt * z0, tt * z1), -z0);
+        if (distanceSquared(light.center, boxLo, boxHi) > radius2)
+          continue;
+        uint32_t tile = (uint32_t)(ty * kTilesX + tx);
+        pairs.push_back(tile << 16 | i);
+        counts[tile]++;
+      }
+    }
+  }
+
+  // Counting sort by tile; lights stay in order within a tile
+  uint32_t offsets[kTilesPerSlice];
+  uint32_t offset = 0;
+  for (int tile = 0; tile < kTilesPerSlice; ++tile) {
+    offsets[tile] = offset;
+    offset += counts[tile];
+  }
+  std::vector<uint32_t> &indices = m_sliceIndices[slice];
+  indices.resize(pairs.size());
+  for (uint32_t pair : pairs)
+    indices[offsets[pair >> 16]++] = pair & 0xffffu;
+}
+
+ClusterBuffers::ClusterBuffers() {
+  static const GLenum formats[3] = {GL_RGBA32F, GL_RG32UI, GL_R32UI};
+  glGenBuffers(3, m_buffers);
+  glGenTextures(3, m_textures);
+  for (int i = 0; i < 3; ++i) {
+    glBindBuffer(GL_TEXTURE_BUFFER, m_buffers[i]);
+    glBufferData(GL_TEXTURE_BUFFER, 16, NULL, GL_STREAM_DRAW);
+    glBindTexture(GL_TEXTURE_BUFFER, m_textures[i]);
+    glTexBuffer(GL_TEXTURE_BUFFER, formats[i], m_buffers[i]);
+  }
+  glBindTexture(GL_TEXTURE_BUFFER, 0);
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+ClusterBuffers::~ClusterBuffers() {
+  glDeleteTextures(3, m_textures);
+  glDeleteBuffers(3, m_buffers);
+}
+
+void ClusterBuffers::upload(const ClusterLists &lists) {
+  PROFILE_FUNCTION();
+  const void *data[3] = {lists.lights.data(), lists.grid.data(),
+                         lists.indices.data()};
+  size_t sizes[3] = {lists.lights.size() * sizeof(glm::vec4),
+                     lists.grid.size() * sizeof(uint32_t),
+                     lists.indices.size() * sizeof(uint32_t)};
+  static const GLint units[3] = {kLightDataUnit, kGridUnit, kIndexUnit};
+  for (int i = 0; i < 3; ++i) {
+    // Fresh storage each frame, so the GPU can still read the old lists
+    glBindBuffer(GL_TEXTURE_BUFFER, m_buffers[i]);
+    if (sizes[i] > 0)
+      countedBufferData(GL_TEXTURE_BUFFER, (GLsizeiptr)sizes[i], data[i],
+                        GL_STREAM_DRAW);
+    glActiveTexture(GL_TEXTURE0 + units[i]);
+    glBindTexture(GL_TEXTURE_BUFFER, m_textures[i]);
+  }
+  glActiveTexture(GL_TEXTURE0);
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void ClusterBuffers::setupProgram(GLuint program) {
+  glUseProgram(program);
+  glUniform1i(glGetUniformLocation(program, "ClusterLights"), kLightDataUnit);
+  glUniform1i(glGetUniformLocation(program, "ClusterGrid"), kGridUnit);
+  glUniform1i(glGetUniformLocation(program, "ClusterIndices"), kIndexUnit);
+  glUseProgram(0);
+}
@@ -0,0 +1,97 @@
+#include "dynamic_resolution.hpp"
+#include "profiler.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace {
+// Weight of each new GPU time in the smoothed value
+const float kSmoothing = 0.2f;
+} // namespace
+
+DynamicResolution::DynamicResolution() : DynamicResolution(Settings()) {}
+
+DynamicResolution::DynamicResolution(const Settings &settings)
+    : m_settings(settings), m_scale(settings.maxScale) {
+  glGenFramebuffers(1, &m_fbo);
+  glGenRenderbuffers(1, &m_color);
+  glGenRenderbuffers(1, &m_depth);
+}
+
+DynamicResolution::~DynamicResolution() {
+  glDeleteFramebuffers(1, &m_fbo);
+  glDeleteRenderbuffers(1, &m_color);
+  glDeleteRenderbuffers(1, &m_depth);
+}
+
+void DynamicResolution::allocate(int width, int height) {
+  m_outputWidth = width;
+  m_outputHeight = height;
+  int storageWidth = std::max(1, (int)std::ceil(width * m_settings.maxScale));
+  int storageHeight =
+      std::max(1, (int)std::ceil(height * m_settings.maxScale));
+
+  glBindRenderbuffer(GL_RENDERBUFFER, m_color);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, storageWidth,
+                        storageHeight);
+  glBindRenderbuffer(GL_RENDERBUFFER, m_depth);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, storageWidth,
+                        storageHeight);
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                            GL_RENDERBUFFER, m_color);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+                            GL_RENDERBUFFER, m_depth);
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    std::fprintf(stderr, "[dynres] offscreen framebuffer incomplete\n");
+}
+
+void DynamicResolution::begin(int width, int height) {
+  if (width != m_outputWidth || height != m_outputHeight)
+    allocate(width, height);
+
+  m_renderWidth = std::max(1, (int)std::lround(width * m_scale));
+  m_renderHeight = std::max(1, (int)std::lround(height * m_scale));
+  glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+  glViewport(0, 0, m_renderWidth, m_renderHeight);
+}
+
+void DynamicResolution::resolve() {
+  PROFILE_ZONE("upscale blit");
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, m_fbo);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+  glBlitFramebuffer(0, 0, m_renderWidth, m_renderHeight, 0, 0,
+                    m_outputWidth, m_outputHeight, GL_COLOR_BUFFER_BIT,
+                    GL_LINEAR);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glViewport(0, 0, m_outputWidth, m_outputHeight);
+}
+
+void DynamicResolution::update(float gpuMs) {
+  if (gpuMs <= 0.0f)
+    return;
+  m_smoothedMs = m_smoothedMs == 0.0f
+                     ? gpuMs
+                     : m_smoothedMs + (gpuMs - m_smoothedMs) * kSmoothing;
+
+  const float budget = m_settings.budgetMs;
+  if (m_smoothedMs > budget)
+    m_outsideBand = std::max(m_outsideBand, 0) + 1;
+  else if (m_smoothedMs < budget * m_settings.lowerBand)
+    m_outsideBand = std::min(m_outsideBand, 0) - 1;
+  else
+    m_outsideBand = 0;
+
+  if (std::abs(m_outsideBand) < m_settings.holdFrames)
+    return;
+  m_outsideBand = 0;
+
+  float step = std::sqrt(budget / m_smoothedMs);
+  step = std::min(std::max(step, m_settings.maxStepDown),
+                  m_settings.maxStepUp);
+  m_scale = std::min(std::max(m_scale * step, m_settings.minScale),
+                     m_settings.maxScale);
+  m_smoothedMs = 0.0f; // Smoothing starts over at the new scale
+}
@@ -0,0 +1,261 @@
+#include "entity_store.hpp"
+#include "job_system.hpp"
+#include "profiler.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+// Entities per job; a multiple of 4 so SSE blocks never straddle two jobs
+const uint32_t kChunkEntities = 1024;
+// Below this many entities a single thread is faster than splitting
+const uint32_t kParallelMinEntities = 4096;
+
+// Move the last element into `index` and drop the last slot
+template <typename T> void removeSwap(std::vector<T> &v, uint32_t index) {
+  v[index] = v.back();
+  v.pop_back();
+}
+} // namespace
+
+EntityId EntityStore::create(uint32_t mesh, uint32_t material,
+                             const glm::vec3 &boundsCenter,
+                             float boundsRadius) {
+  EntityId entity;
+  if (!m_freeIds.empty()) {
+    entity = m_freeIds.back();
+    m_freeIds.pop_back();
+  } else {
+    entity = (EntityId)m_index.size();
+    m_index.push_back(0);
+  }
+  m_index[entity] = (uint32_t)m_ids.size();
+  m_ids.push_back(entity);
+
+  m_posX.push_back(0.0f);
+  m_posY.push_back(0.0f);
+  m_posZ.push_back(0.0f);
+  m_rotX.push_back(0.0f);
+  m_rotY.push_back(0.0f);
+  m_rotZ.push_back(0.0f);
+  m_rotW.push_back(1.0f);
+  m_scaleX.push_back(1.0f);
+  m_scaleY.push_back(1.0f);
+  m_scaleZ.push_back(1.0f);
+  m_localX.push_back(boundsCenter.x);
+  m_localY.push_back(boundsCenter.y);
+  m_localZ.push_back(boundsCenter.z);
+  m_localR.push_back(boundsRadius);
+  m_world.push_back(glm::mat4(1.0f));
+  m_sphereX.push_back(boundsCenter.x);
+  m_sphereY.push_back(boundsCenter.y);
+  m_sphereZ.push_back(boundsCenter.z);
+  m_sphereR.push_back(boundsRadius);
+  m_mesh.push_back(mesh);
+  m_material.push_back(material);
+  m_dirty = true;
+  return entity;
+}
+
+void EntityStore::destroy(EntityId entity) {
+  uint32_t index = m_index[entity];
+  if (index == ~0u)
+    return;
+
+  removeSwap(m_posX, index);
+  removeSwap(m_posY, index);
+  removeSwap(m_posZ, index);
+  removeSwap(m_rotX, index);
+  removeSwap(m_rotY, index);
+  removeSwap(m_rotZ, index);
+  removeSwap(m_rotW, index);
+  removeSwap(m_scaleX, index);
+  removeSwap(m_scaleY, index);
+  removeSwap(m_scaleZ, index);
+  removeSwap(m_localX, index);
+  removeSwap(m_localY, index);
+  removeSwap(m_localZ, index);
+  removeSwap(m_localR, index);
+  removeSwap(m_world, index);
+  removeSwap(m_sphereX, index);
+  removeSwap(m_sphereY, index);
+  removeSwap(m_sphereZ, index);
+  removeSwap(m_sphereR, index);
+  removeSwap(m_mesh, index);
+  removeSwap(m_material, index);
+  removeSwap(m_ids, index);
+
+  if (index < m_ids.size())
+    m_index[m_ids[index]] = index;
+  m_index[entity] = ~0u;
+  m_freeIds.push_back(entity);
+}
+
+void EntityStore::setPosition(EntityId entity, const glm::vec3 &position) {
+  uint32_t i = m_index[entity];
+  m_posX[i] = position.x;
+  m_posY[i] = position.y;
+  m_posZ[i] = position.z;
+  m_dirty = true;
+}
+
+void EntityStore::setRotation(EntityId entity, const glm::vec3 &eulerDegrees) {
+  setRotation(entity, Transform::eulerToQuat(eulerDegrees));
+}
+
+void EntityStore::setRotation(EntityId entity, const glm::quat &rotation) {
+  uint32_t i = m_index[entity];
+  m_rotX[i] = rotation.x;
+  m_rotY[i] = rotation.y;
+  m_rotZ[i] = rotation.z;
+  m_rotW[i] = rotation.w;
+  m_dirty = true;
+}
+
+void EntityStore::setScale(EntityId entity, const glm::vec3 &scale) {
+  uint32_t i = m_index[entity];
+  m_scaleX[i] = scale.x;
+  m_scaleY[i] = scale.y;
+  m_scaleZ[i] = scale.z;
+  m_dirty = true;
+}
+
+void EntityStore::updateScalar(uint32_t i) {
+  const float sx = m_scaleX[i], sy = m_scaleY[i], sz = m_scaleZ[i];
+  glm::mat4 &m = m_world[i];
+  Transform::composeTRS(glm::vec3(m_posX[i], m_posY[i], m_posZ[i]),
+                        glm::quat(m_rotW[i], m_rotX[i], m_rotY[i], m_rotZ[i]),
+                        glm::vec3(sx, sy, sz), m);
+
+  const float lx = m_localX[i], ly = m_localY[i], lz = m_localZ[i];
+  m_sphereX[i] = m[0][0] * lx + m[1][0] * ly + m[2][0] * lz + m[3][0];
+  m_sphereY[i] = m[0][1] * lx + m[1][1] * ly + m[2][1] * lz + m[3][1];
+  m_sphereZ[i] = m[0][2] * lx + m[1][2] * ly + m[2][2] * lz + m[3][2];
+  // Rotation keeps lengths, so only the largest scale grows the sphere
+  m_sphereR[i] = m_localR[i] * std::max(std::fabs(sx),
+                                        std::max(std::fabs(sy), std::fabs(sz)));
+}
+
+#ifdef TRANSFORM_USE_SSE
+void EntityStore::update4(uint32_t i) {
+  // Straight loads: four entities are four consecutive floats of each array
+  const __m128 sx = _mm_loadu_ps(&m_scaleX[i]);
+  const __m128 sy = _mm_loadu_ps(&m_scaleY[i]);
+  const __m128 sz = _mm_loadu_ps(&m_scaleZ[i]);
+  const __m128 px = _mm_loadu_ps(&m_posX[i]), py = _mm_loadu_ps(&m_posY[i]);
+  const __m128 pz = _mm_loadu_ps(&m_posZ[i]);
+  __m128 m[9];
+  Transform::composeRotationScale4(
+      _mm_loadu_ps(&m_rotX[i]), _mm_loadu_ps(&m_rotY[i]),
+      _mm_loadu_ps(&m_rotZ[i]), _mm_loadu_ps(&m_rotW[i]), sx, sy, sz, m);
+
+  // World bounding spheres while the matrices are still one row per register
+  const __m128 lx = _mm_loadu_ps(&m_localX[i]);
+  const __m128 ly = _mm_loadu_ps(&m_localY[i]);
+  const __m128 lz = _mm_loadu_ps(&m_localZ[i]);
+  __m128 cx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[0], lx), _mm_mul_ps(m[3], ly)),
+                         _mm_add_ps(_mm_mul_ps(m[6], lz), px));
+  __m128 cy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[1], lx), _mm_mul_ps(m[4], ly)),
+                         _mm_add_ps(_mm_mul_ps(m[7], lz), py));
+  __m128 cz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[2], lx), _mm_mul_ps(m[5], ly)),
+                         _mm_add_ps(_mm_mul_ps(m[8], lz), pz));
+  // |s| = max(s, -s)
+  const __m128 zero = _mm_setzero_ps();
+  __m128 maxScale = _mm_max_ps(
+      _mm_max_ps(_mm_max_ps(sx, _mm_sub_ps(zero, sx)),
+                 _mm_max_ps(sy, _mm_sub_ps(zero, sy))),
+      _mm_max_ps(sz, _mm_sub_ps(zero, sz)));
+  _mm_storeu_ps(&m_sphereX[i], cx);
+  _mm_storeu_ps(&m_sphereY[i], cy);
+  _mm_storeu_ps(&m_sphereZ[i], cz);
+  _mm_storeu_ps(&m_sphereR[i],
+                _mm_mul_ps(_mm_loadu_ps(&m_localR[i]), maxScale));
+
+  glm::mat4 *const out[4] = {&m_world[i], &m_world[i + 1], &m_world[i + 2],
+                             &m_world[i + 3]};
+  Transform::storeTRS4(m, px, py, pz, out);
+}
+#endif
+
+void EntityStore::updateSpan(uint32_t begin, uint32_t end) {
+  uint32_t i = begin;
+#ifdef TRANSFORM_USE_SSE
+  for (; i + 4 <= end; i += 4)
+    update4(i);
+#endif
+  for (; i < end; ++i)
+    updateScalar(i);
+}
+
+void EntityStore::update(JobSystem *jobs) {
+  if (!m_dirty)
+    return;
+  PROFILE_ZONE("EntityStore::update");
+  const uint32_t count = (uint32_t)m_ids.size();
+  if (jobs && count >= kParallelMinEntities)
+    jobs->parallelFor(count, kChunkEntities, [&](size_t begin, size_t end) {
+      updateSpan((uint32_t)begin, (uint32_t)end);
+    });
+  else
+    updateSpan(0, count);
+  m_dirty = false;
+}
+
+void EntityStore::cullSpan(const Frustum &frustum, uint32_t begin,
+                           uint32_t end, std::vector<uint32_t> &visible) const {
+  uint32_t i = begin;
+#ifdef TRANSFORM_USE_SSE
+  __m128 nx[6], ny[6], nz[6], nw[6];
+  for (int p = 0; p < 6; ++p) {
+    nx[p] = _mm_set1_ps(frustum.planes[p].x);
+    ny[p] = _mm_set1_ps(frustum.planes[p].y);
+    nz[p] = _mm_set1_ps(frustum.planes[p].z);
+    nw[p] = _mm_set1_ps(frustum.planes[p].w);
+  }
+  const __m128 zero = _mm_setzero_ps();
+  for (; i + 4 <= end; i += 4) {
+    const __m128 cx = _mm_loadu_ps(&m_sphereX[i]);
+    const __m128 cy = _mm_loadu_ps(&m_sphereY[i]);
+    const __m128 cz = _mm_loadu_ps(&m_sphereZ[i]);
+    const __m128 negR = _mm_sub_ps(zero, _mm_loadu_ps(&m_sphereR[i]));
+    __m128 outside = zero;
+    for (int p = 0; p < 6; ++p) {
+      __m128 d = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(nx[p], cx), _mm_mul_ps(ny[p], cy)),
+          _mm_add_ps(_mm_mul_ps(nz[p], cz), nw[p]));
+      outside = _mm_or_ps(outside, _mm_cmplt_ps(d, negR));
+    }
+    const int outsideMask = _mm_movemask_ps(outside);
+    for (int lane = 0; lane < 4; ++lane)
+      if (!(outsideMask & (1 << lane)))
+        visible.push_back(i + lane);
+  }
+#endif
+  for (; i < end; ++i)
+    if (sphereInFrustum(frustum,
+                        glm::vec3(m_sphereX[i], m_sphereY[i], m_sphereZ[i]),
+                        m_sphereR[i]))
+      visible.push_back(i);
+}
+
+size_t EntityStore::cull(const Frustum &frustum, std::vector<uint32_t> &visible,
+                         JobSystem *jobs) const {
+  PROFILE_ZONE("EntityStore::cull");
+  const size_t before = visible.size();
+  const uint32_t count = (uint32_t)m_ids.size();
+  if (!jobs || count < kParallelMinEntities) {
+    cullSpan(frustum, 0, count, visible);
+    return visible.size() - before;
+  }
+
+  // Every chunk collects its own list; appending them in chunk order keeps
+  // the result identical to the serial loop
+  std::vector<std::vector<uint32_t>> chunks(
+      (count + kChunkEntities - 1) / kChunkEntities);
+  jobs->parallelFor(count, kChunkEntities, [&](size_t begin, size_t end) {
+    cullSpan(frustum, (uint32_t)begin, (uint32_t)end,
+             chunks[begin / kChunkEntities]);
+  });
+  for (const std::vector<uint32_t> &chunk : chunks)
+    visible.insert(visible.end(), chunk.begin(), chunk.end());
+  return visible.size() - before;
+}
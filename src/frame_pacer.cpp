@@ -0,0 +1,115 @@
+#include "frame_pacer.hpp"
+#include "profiler.hpp"
+#include <GLFW/glfw3.h>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+namespace {
+// Sleep only until this long before a deadline, then spin
+const uint64_t kSpinMarginNs = 2000000;
+// Weight of each new sample in the smoothed latency
+const float kLatencySmoothing = 0.1f;
+} // namespace
+
+const char *presentModeName(PresentMode mode) {
+  switch (mode) {
+  case PRESENT_VSYNC:
+    return "VSYNC";
+  case PRESENT_ADAPTIVE:
+    return "ADAPTIVE";
+  case PRESENT_UNCAPPED:
+    return "UNCAPPED";
+  case PRESENT_LIMITED:
+    return "LIMITED";
+  default:
+    return "?";
+  }
+}
+
+FramePacer::~FramePacer() {
+  for (const PendingFrame &frame : m_pending)
+    glDeleteSync(frame.fence);
+}
+
+void FramePacer::configure(PresentMode mode, float fpsCap) {
+  if (mode == PRESENT_LIMITED && fpsCap != m_fpsCap) {
+    m_fpsCap = fpsCap;
+    m_periodNs = fpsCap > 0.0f ? (uint64_t)(1e9 / fpsCap) : 0;
+    m_deadlineNs = 0; // Restart the cadence
+  }
+  if (mode == m_mode)
+    return;
+  m_mode = mode;
+
+  int interval = 1;
+  if (mode == PRESENT_ADAPTIVE) {
+    // Negative intervals need the swap_control_tear extension
+    if (glfwExtensionSupported("WGL_EXT_swap_control_tear") ||
+        glfwExtensionSupported("GLX_EXT_swap_control_tear"))
+      interval = -1;
+    else
+      std::printf("[pacer] adaptive vsync not supported, using vsync\n");
+  } else if (mode == PRESENT_UNCAPPED || mode == PRESENT_LIMITED) {
+    interval = 0;
+  }
+  glfwSwapInterval(interval);
+  m_deadlineNs = 0;
+}
+
+void FramePacer::waitForNextFrame() {
+  if (m_mode != PRESENT_LIMITED || m_periodNs == 0)
+    return;
+  PROFILE_ZONE("frame limiter");
+
+  uint64_t now = Profiler::nowNs();
+  // First frame, or more than a period late: restart from now instead of
+  // rushing through the missed deadlines
+  if (m_deadlineNs == 0 || now > m_deadlineNs + m_periodNs) {
+    m_deadlineNs = now + m_periodNs;
+    return;
+  }
+
+  if (m_deadlineNs > now + kSpinMarginNs)
+    std::this_thread::sleep_for(
+        std::chrono::nanoseconds(m_deadlineNs - now - kSpinMarginNs));
+  while (Profiler::nowNs() < m_deadlineNs)
+    std::this_thread::yield();
+  m_deadlineNs += m_periodNs;
+}
+
+void FramePacer::frameSubmitted(uint64_t inputNs, bool waitForGpu) {
+  if (m_pending.size() >= kMaxPending) {
+    glDeleteSync(m_pending.front().fence);
+    m_pending.pop_front();
+  }
+  PendingFrame frame;
+  frame.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  frame.inputNs = inputNs;
+  m_pending.push_back(frame);
+
+  if (waitForGpu) {
+    // Low-latency mode: nothing is queued ahead of the next input sample
+    PROFILE_ZONE("wait for GPU");
+    glClientWaitSync(frame.fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                     1000000000ull);
+  }
+  pollFences();
+}
+
+void FramePacer::pollFences() {
+  // Fences signal in order, so stop at the first one still pending
+  while (!m_pending.empty()) {
+    PendingFrame &frame = m_pending.front();
+    GLenum status = glClientWaitSync(frame.fence, 0, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+      break;
+    float sampleMs = (float)(Profiler::nowNs() - frame.inputNs) * 1e-6f;
+    m_latencyMs = m_latencyMs == 0.0f
+                      ? sampleMs
+                      : m_latencyMs + (sampleMs - m_latencyMs) *
+                                          kLatencySmoothing;
+    glDeleteSync(frame.fence);
+    m_pending.pop_front();
+  }
+}
@@ -0,0 +1,131 @@
+#include "gbuffer.hpp"
+#include "profiler.hpp"
+#include "render_stats.hpp"
+#include <algorithm>
+#include <cstdio>
+
+namespace {
+void setupTexture(GLuint texture, GLint internalFormat, GLenum format,
+                  GLenum type, int width, int height) {
+  glBindTexture(GL_TEXTURE_2D, texture);
+  glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format,
+               type, NULL);
+  // Read with texelFetch only
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+}
+} // namespace
+
+GBuffer::GBuffer() {
+  glGenFramebuffers(1, &m_fbo);
+  glGenTextures(1, &m_normal);
+  glGenTextures(1, &m_material);
+  glGenTextures(1, &m_depth);
+  glGenBuffers(1, &m_materialBuffer);
+  glGenTextures(1, &m_materialTexture);
+  glGenVertexArrays(1, &m_emptyVao);
+
+  glBindBuffer(GL_TEXTURE_BUFFER, m_materialBuffer);
+  glBufferData(GL_TEXTURE_BUFFER, 3 * sizeof(glm::vec4), NULL, GL_STATIC_DRAW);
+  glBindTexture(GL_TEXTURE_BUFFER, m_materialTexture);
+  glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, m_materialBuffer);
+  glBindTexture(GL_TEXTURE_BUFFER, 0);
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+GBuffer::~GBuffer() {
+  glDeleteFramebuffers(1, &m_fbo);
+  glDeleteTextures(1, &m_normal);
+  glDeleteTextures(1, &m_material);
+  glDeleteTextures(1, &m_depth);
+  glDeleteBuffers(1, &m_materialBuffer);
+  glDeleteTextures(1, &m_materialTexture);
+  glDeleteVertexArrays(1, &m_emptyVao);
+}
+
+void GBuffer::setMaterials(const std::vector<Material> &materials) {
+  if (materials.size() > kMaxMaterials)
+    std::fprintf(stderr, "[gbuffer] %zu materials, only %zu are indexable\n",
+                 materials.size(), kMaxMaterials);
+  std::vector<glm::vec4> texels;
+  for (const Material &mat : materials) {
+    texels.push_back(glm::vec4(mat.Ka, 0.0f));
+    texels.push_back(glm::vec4(mat.Kd, 0.0f));
+    texels.push_back(glm::vec4(mat.Ks, mat.Ns));
+  }
+  glBindBuffer(GL_TEXTURE_BUFFER, m_materialBuffer);
+  countedBufferData(GL_TEXTURE_BUFFER, texels.size() * sizeof(glm::vec4),
+                    texels.data(), GL_STATIC_DRAW);
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void GBuffer::allocate(int width, int height) {
+  m_storageWidth = width;
+  m_storageHeight = height;
+  setupTexture(m_normal, GL_RG16F, GL_RG, GL_HALF_FLOAT, width, height);
+  setupTexture(m_material, GL_R8UI, GL_RED_INTEGER, GL_UNSIGNED_BYTE, width,
+               height);
+  setupTexture(m_depth, GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_FLOAT,
+               width, height);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                         m_normal, 0);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D,
+                         m_material, 0);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D,
+                         m_depth, 0);
+  const GLenum drawBuffers[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+  glDrawBuffers(2, drawBuffers);
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    std::fprintf(stderr, "[gbuffer] framebuffer incomplete\n");
+}
+
+void GBuffer::begin(int width, int height) {
+  PROFILE_FUNCTION();
+  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &m_previousFbo);
+  if (width > m_storageWidth || height > m_storageHeight)
+    allocate(std::max(width, m_storageWidth),
+             std::max(height, m_storageHeight));
+  m_width = width;
+  m_height = height;
+
+  glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+  glViewport(0, 0, width, height);
+  // Material 0 and a zero normal under empty pixels; depth 1 marks them
+  const GLfloat zeroNormal[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+  const GLuint zeroMaterial[4] = {0, 0, 0, 0};
+  const GLfloat farDepth = 1.0f;
+  glClearBufferfv(GL_COLOR, 0, zeroNormal);
+  glClearBufferuiv(GL_COLOR, 1, zeroMaterial);
+  glClearBufferfv(GL_DEPTH, 0, &farDepth);
+}
+
+void GBuffer::end() {
+  glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)m_previousFbo);
+  glActiveTexture(GL_TEXTURE0 + kNormalUnit);
+  glBindTexture(GL_TEXTURE_2D, m_normal);
+  glActiveTexture(GL_TEXTURE0 + kMaterialUnit);
+  glBindTexture(GL_TEXTURE_2D, m_material);
+  glActiveTexture(GL_TEXTURE0 + kDepthUnit);
+  glBindTexture(GL_TEXTURE_2D, m_depth);
+  glActiveTexture(GL_TEXTURE0 + kMaterialTableUnit);
+  glBindTexture(GL_TEXTURE_BUFFER, m_materialTexture);
+  glActiveTexture(GL_TEXTURE0);
+}
+
+void GBuffer::drawLighting() {
+  countedBindVertexArray(m_emptyVao);
+  countedDrawArrays(GL_TRIANGLES, 0, 3);
+}
+
+void GBuffer::setupProgram(GLuint program) {
+  glUseProgram(program);
+  glUniform1i(glGetUniformLocation(program, "GNormal"), kNormalUnit);
+  glUniform1i(glGetUniformLocation(program, "GMaterial"), kMaterialUnit);
+  glUniform1i(glGetUniformLocation(program, "GDepth"), kDepthUnit);
+  glUniform1i(glGetUniformLocation(program, "Materials"), kMaterialTableUnit);
+  glUseProgram(0);
+}
@@ -0,0 +1,262 @@
+#include "geometry_arena.hpp"
+#include "profiler.hpp"
+#include "render_stats.hpp"
+#include <cstdio>
+#include <cstring>
+
+GeometryArena::GeometryArena(size_t maxVertices, size_t maxIndices,
+                             size_t maxDraws)
+    : m_maxVertices(maxVertices), m_maxIndices(maxIndices),
+      m_maxDraws(maxDraws) {
+  m_indirect = GLAD_GL_VERSION_4_3 != 0;
+  GLint alignment = 256;
+  glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+  m_uniformAlignment = (size_t)alignment;
+
+  glGenVertexArrays(1, &m_vao);
+  glGenBuffers(1, &m_vbo);
+  glGenBuffers(1, &m_ebo);
+  glGenBuffers(1, &m_drawIndexBuffer);
+
+  glBindVertexArray(m_vao);
+  glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+  glBufferData(GL_ARRAY_BUFFER, maxVertices * sizeof(Vertex), NULL,
+               GL_STATIC_DRAW);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, maxIndices * sizeof(unsigned int),
+               NULL, GL_STATIC_DRAW);
+
+  // Same vertex layout as Mesh
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)0);
+  glEnableVertexAttribArray(1);
+  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                        (void *)offsetof(Vertex, Normal));
+
+  // DrawIndex = baseInstance + gl_InstanceID on the indirect path
+  std::vector<GLuint> drawIndices(maxDraws);
+  for (size_t i = 0; i < maxDraws; ++i)
+    drawIndices[i] = (GLuint)i;
+  glBindBuffer(GL_ARRAY_BUFFER, m_drawIndexBuffer);
+  glBufferData(GL_ARRAY_BUFFER, drawIndices.size() * sizeof(GLuint),
+               drawIndices.data(), GL_STATIC_DRAW);
+  glVertexAttribIPointer(kDrawIndexAttrib, 1, GL_UNSIGNED_INT, sizeof(GLuint),
+                         (void *)0);
+  glVertexAttribDivisor(kDrawIndexAttrib, 1);
+  if (m_indirect)
+    glEnableVertexAttribArray(kDrawIndexAttrib);
+  glBindVertexArray(0);
+
+  // Per-draw data (in the stream buffer, attached at submit time) and
+  // materials are fetched with texelFetch(samplerBuffer)
+  glGenTextures(1, &m_drawDataTexture);
+  glGenBuffers(1, &m_materialBuffer);
+  glGenTextures(1, &m_materialTexture);
+  glBindBuffer(GL_TEXTURE_BUFFER, m_materialBuffer);
+  glBufferData(GL_TEXTURE_BUFFER, 3 * sizeof(glm::vec4), NULL, GL_STATIC_DRAW);
+  glBindTexture(GL_TEXTURE_BUFFER, m_materialTexture);
+  glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, m_materialBuffer);
+  glBindTexture(GL_TEXTURE_BUFFER, 0);
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+  std::printf("Geometry arena: %s path\n",
+              m_indirect ? "glMultiDrawElementsIndirect"
+                         : "glMultiDrawElementsBaseVertex");
+}
+
+GeometryArena::~GeometryArena() {
+  GLuint buffers[] = {m_vbo, m_ebo, m_drawIndexBuffer, m_materialBuffer};
+  glDeleteBuffers(4, buffers);
+  GLuint textures[] = {m_drawDataTexture, m_materialTexture};
+  glDeleteTextures(2, textures);
+  glDeleteVertexArrays(1, &m_vao);
+}
+
+int GeometryArena::addMesh(const std::vector<Vertex> &vertices,
+                           const std::vector<unsigned int> &indices) {
+  PROFILE_FUNCTION();
+  std::vector<unsigned int> sequential;
+  const std::vector<unsigned int> *source = &indices;
+  if (indices.empty()) {
+    sequential.resize(vertices.size());
+    for (size_t i = 0; i < vertices.size(); ++i)
+      sequential[i] = (unsigned int)i;
+    source = &sequential;
+  }
+
+  if (m_usedVertices + vertices.size() > m_maxVertices ||
+      m_usedIndices + source->size() > m_maxIndices) {
+    std::fprintf(stderr, "[arena] out of space for mesh (%zu verts)\n",
+                 vertices.size());
+    return -1;
+  }
+
+  ArenaMesh mesh;
+  mesh.baseVertex = (GLint)m_usedVertices;
+  mesh.vertexCount = (GLuint)vertices.size();
+  mesh.firstIndex = (GLuint)m_usedIndices;
+  mesh.indexCount = (GLuint)source->size();
+
+  // Indices stay mesh-local; baseVertex relocates them at draw time
+  glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+  countedBufferSubData(GL_ARRAY_BUFFER, m_usedVertices * sizeof(Vertex),
+                       vertices.size() * sizeof(Vertex), vertices.data());
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  // The EBO binding is VAO state, so bind the VAO to update it
+  glBindVertexArray(m_vao);
+  countedBufferSubData(GL_ELEMENT_ARRAY_BUFFER,
+                       m_usedIndices * sizeof(unsigned int),
+                       source->size() * sizeof(unsigned int), source->data());
+  glBindVertexArray(0);
+
+  m_usedVertices += vertices.size();
+  m_usedIndices += source->size();
+  m_meshes.push_back(mesh);
+  return (int)m_meshes.size() - 1;
+}
+
+void GeometryArena::setMaterials(const std::vector<Material> &materials) {
+  std::vector<glm::vec4> texels;
+  for (const Material &m : materials) {
+    texels.push_back(glm::vec4(m.Ka, m.Ns));
+    texels.push_back(glm::vec4(m.Kd, m.d));
+    texels.push_back(glm::vec4(m.Ks, 0.0f));
+  }
+  glBindBuffer(GL_TEXTURE_BUFFER, m_materialBuffer);
+  countedBufferData(GL_TEXTURE_BUFFER, texels.size() * sizeof(glm::vec4),
+                    texels.data(), GL_STATIC_DRAW);
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void GeometryArena::beginFrame() {
+  m_commands.clear();
+  m_drawData.clear();
+}
+
+int GeometryArena::addInstance(const glm::mat4 &model, uint32_t material) {
+  int instance = (int)(m_drawData.size() / 8);
+  if ((size_t)instance >= m_maxDraws)
+    return -1;
+
+  // World-space normal matrix; texel 4.w carries the material index
+  glm::mat3 normal = glm::transpose(glm::inverse(glm::mat3(model)));
+  m_drawData.push_back(model[0]);
+  m_drawData.push_back(model[1]);
+  m_drawData.push_back(model[2]);
+  m_drawData.push_back(model[3]);
+  m_drawData.push_back(glm::vec4(normal[0], (float)material));
+  m_drawData.push_back(glm::vec4(normal[1], 0.0f));
+  m_drawData.push_back(glm::vec4(normal[2], 0.0f));
+  m_drawData.push_back(glm::vec4(0.0f));
+  return instance;
+}
+
+void GeometryArena::addDraw(int mesh, int instance) {
+  if (mesh < 0 || instance < 0 || m_commands.size() >= m_maxDraws)
+    return;
+  const ArenaMesh &m = m_meshes[mesh];
+  m_commands.push_back(
+      {m.indexCount, 1, m.firstIndex, m.baseVertex, (GLuint)instance});
+}
+
+void GeometryArena::setupProgram(GLuint program) {
+  glUseProgram(program);
+  glUniform1i(glGetUniformLocation(program, "DrawData"), kDrawDataUnit);
+  glUniform1i(glGetUniformLocation(program, "Materials"), kMaterialUnit);
+  glUniformBlockBinding(program, glGetUniformBlockIndex(program, "FrameData"),
+                        kFrameDataBinding);
+  glUseProgram(0);
+}
+
+void GeometryArena::submit(StreamBuffer &stream,
+                           const ArenaFrameUniforms &frame) {
+  PROFILE_ZONE("GeometryArena::submit");
+  if (m_commands.empty())
+    return;
+
+  // Per-frame data goes straight into the streaming buffer: no
+  // glBufferData re-specification and no implicit sync
+  StreamBuffer::Allocation drawData =
+      stream.allocate(m_drawData.size() * sizeof(glm::vec4), 16);
+  StreamBuffer::Allocation uniforms =
+      stream.allocate(sizeof(ArenaFrameUniforms), m_uniformAlignment);
+  StreamBuffer::Allocation commands;
+  if (m_indirect)
+    commands = stream.allocate(
+        m_commands.size() * sizeof(DrawElementsIndirectCommand), 16);
+  if (!drawData.data || !uniforms.data || (m_indirect && !commands.data)) {
+    std::fprintf(stderr, "[arena] stream buffer full, %zu draws skipped\n",
+                 m_commands.size());
+    return;
+  }
+
+  std::memcpy(drawData.data, m_drawData.data(), drawData.size);
+  ArenaFrameUniforms frameData = frame;
+  frameData.drawDataBase = (int32_t)(drawData.offset / sizeof(glm::vec4));
+  std::memcpy(uniforms.data, &frameData, sizeof frameData);
+  if (m_indirect)
+    std::memcpy(commands.data, m_commands.data(), commands.size);
+  stream.flush();
+
+  if (m_drawDataSource != stream.buffer()) {
+    m_drawDataSource = stream.buffer();
+    glBindTexture(GL_TEXTURE_BUFFER, m_drawDataTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, m_drawDataSource);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+  }
+  glBindBufferRange(GL_UNIFORM_BUFFER, kFrameDataBinding, stream.buffer(),
+                    uniforms.offset, sizeof(ArenaFrameUniforms));
+
+  glActiveTexture(GL_TEXTURE0 + kDrawDataUnit);
+  glBindTexture(GL_TEXTURE_BUFFER, m_drawDataTexture);
+  glActiveTexture(GL_TEXTURE0 + kMaterialUnit);
+  glBindTexture(GL_TEXTURE_BUFFER, m_materialTexture);
+  glActiveTexture(GL_TEXTURE0);
+
+  countedBindVertexArray(m_vao);
+
+  if (m_indirect) {
+    uint64_t indexTotal = 0;
+    for (const DrawElementsIndirectCommand &cmd : m_commands)
+      indexTotal += cmd.count;
+
+    // One API call for every mesh
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, stream.buffer());
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+                                (const void *)commands.offset,
+                                (GLsizei)m_commands.size(), 0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    countDraw(GL_TRIANGLES, (GLsizei)indexTotal);
+  } else {
+    // No baseInstance before GL 4.2: DrawIndex comes from the generic
+    // attribute value, so each run of draws sharing an instance is one call
+    // (still without any VAO or buffer switches)
+    size_t begin = 0;
+    while (begin < m_commands.size()) {
+      size_t end = begin;
+      uint64_t indexTotal = 0;
+      m_counts.clear();
+      m_offsets.clear();
+      m_baseVertices.clear();
+      while (end < m_commands.size() &&
+             m_commands[end].baseInstance == m_commands[begin].baseInstance) {
+        const DrawElementsIndirectCommand &cmd = m_commands[end];
+        m_counts.push_back((GLsizei)cmd.count);
+        m_offsets.push_back(
+            (const void *)(cmd.firstIndex * sizeof(unsigned int)));
+        m_baseVertices.push_back(cmd.baseVertex);
+        indexTotal += cmd.count;
+        ++end;
+      }
+      glVertexAttribI1ui(kDrawIndexAttrib, m_commands[begin].baseInstance);
+      glMultiDrawElementsBaseVertex(GL_TRIANGLES, m_counts.data(),
+                                    GL_UNSIGNED_INT, m_offsets.data(),
+                                    (GLsizei)m_counts.size(),
+                                    m_baseVertices.data());
+      countDraw(GL_TRIANGLES, (GLsizei)indexTotal);
+      begin = end;
+    }
+  }
+
+  countedBindVertexArray(0);
+}
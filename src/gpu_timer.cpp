@@ -0,0 +1,37 @@
+#include "gpu_timer.hpp"
+
+GpuTimer::GpuTimer() { glGenQueries(kQueries, m_queries); }
+
+GpuTimer::~GpuTimer() { glDeleteQueries(kQueries, m_queries); }
+
+void GpuTimer::begin() {
+  collect();
+  // Still pending after kQueries frames: its result is dropped
+  m_pending[m_next] = false;
+  glBeginQuery(GL_TIME_ELAPSED, m_queries[m_next]);
+}
+
+void GpuTimer::end() {
+  glEndQuery(GL_TIME_ELAPSED);
+  m_pending[m_next] = true;
+  m_next = (m_next + 1) % kQueries;
+}
+
+void GpuTimer::collect() {
+  // Oldest first; results become available in submission order
+  for (int i = 0; i < kQueries; ++i) {
+    int slot = (m_next + i) % kQueries;
+    if (!m_pending[slot])
+      continue;
+    GLint available = 0;
+    glGetQueryObjectiv(m_queries[slot], GL_QUERY_RESULT_AVAILABLE,
+                       &available);
+    if (!available)
+      break;
+    GLuint64 elapsedNs = 0;
+    glGetQueryObjectui64v(m_queries[slot], GL_QUERY_RESULT, &elapsedNs);
+    m_lastMs = (float)((double)elapsedNs * 1e-6);
+    m_results++;
+    m_pending[slot] = false;
+  }
+}
@@ -0,0 +1,97 @@
+// Microbenchmark of the job system: cost of scheduling, running and
+// waiting for jobs that do (almost) nothing, so the numbers are the
+// scheduler's own overhead per job.
+//
+// Usage: job_bench [workers]   (default: one per hardware thread - 1)
+#include "job_system.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+const int kRepeats = 5;
+
+double nowMs() {
+  using namespace std::chrono;
+  return duration<double, std::milli>(steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Best of kRepeats runs, in nanoseconds per item
+template <typename Fn> double bestNsPerItem(size_t items, Fn fn) {
+  double best = 1e30;
+  for (int r = 0; r < kRepeats; ++r) {
+    double start = nowMs();
+    fn();
+    best = std::min(best, nowMs() - start);
+  }
+  return best * 1e6 / (double)items;
+}
+
+std::atomic<uint64_t> g_sink{0};
+} // namespace
+
+int main(int argc, char **argv) {
+  unsigned workers = argc > 1 ? (unsigned)std::atoi(argv[1]) : 0;
+  JobSystem jobs(workers);
+  std::printf("job_bench: %u threads\n\n", jobs.threadCount());
+  std::printf("%-34s %12s\n", "case", "ns / job");
+
+  // 1. Independent empty jobs queued from one thread, then one wait
+  const size_t kJobs = 200000;
+  double flat = bestNsPerItem(kJobs, [&] {
+    JobCounter counter;
+    for (size_t i = 0; i < kJobs; ++i)
+      jobs.run([] { g_sink.fetch_add(1, std::memory_order_relaxed); },
+               &counter);
+    jobs.wait(counter);
+  });
+  std::printf("%-34s %12.1f\n", "run + wait (flat)", flat);
+
+  // 2. Jobs that spawn jobs: a binary tree of depth 16
+  struct Tree {
+    static void spawn(JobSystem &jobs, JobCounter &counter, int depth) {
+      if (depth == 0)
+        return;
+      jobs.run([&jobs, &counter, depth] { spawn(jobs, counter, depth - 1); },
+               &counter);
+      jobs.run([&jobs, &counter, depth] { spawn(jobs, counter, depth - 1); },
+               &counter);
+    }
+  };
+  const int kDepth = 16;
+  const size_t treeJobs = (size_t(2) << kDepth) - 2;
+  double tree = bestNsPerItem(treeJobs, [&] {
+    JobCounter counter;
+    Tree::spawn(jobs, counter, kDepth);
+    jobs.wait(counter);
+  });
+  std::printf("%-34s %12.1f\n", "nested spawn (tree)", tree);
+
+  // 3. A chain where every job waits for the previous one (continuations)
+  const size_t kChain = 20000;
+  double chain = bestNsPerItem(kChain, [&] {
+    std::vector<JobCounter> links(kChain);
+    JobCounter done;
+    for (size_t i = 0; i < kChain; ++i)
+      jobs.run([] { g_sink.fetch_add(1, std::memory_order_relaxed); },
+               i + 1 < kChain ? &links[i] : &done,
+               i > 0 ? &links[i - 1] : nullptr);
+    jobs.wait(done);
+  });
+  std::printf("%-34s %12.1f\n", "dependency chain", chain);
+
+  // 4. parallelFor chunk overhead (grain 1 = one job per item)
+  const size_t kItems = 100000;
+  double loop = bestNsPerItem(kItems, [&] {
+    jobs.parallelFor(kItems, 1, [](size_t begin, size_t end) {
+      g_sink.fetch_add(end - begin, std::memory_order_relaxed);
+    });
+  });
+  std::printf("%-34s %12.1f\n", "parallelFor (grain 1)", loop);
+
+  std::printf("\nsteals: %llu\n", (unsigned long long)jobs.stealCount());
+  return g_sink.load() == 0; // Keep the work observable
+}
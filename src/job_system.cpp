@@ -0,0 +1,218 @@
+#include "job_system.hpp"
+#include "profiler.hpp"
+#include <algorithm>
+#include <string>
+
+namespace {
+// Which JobSystem and deque the calling thread belongs to
+thread_local const JobSystem *t_system = nullptr;
+thread_local unsigned t_queue = 0;
+thread_local uint32_t t_stealSeed = 0;
+
+// Spins over the deques before an idle worker goes to sleep
+const int kIdleSpins = 256;
+} // namespace
+
+JobSystem::JobSystem(unsigned workers) {
+  if (workers == 0) {
+    unsigned hw = std::thread::hardware_concurrency();
+    workers = hw > 1 ? hw - 1 : 1;
+  }
+  for (unsigned i = 0; i <= workers; ++i)
+    m_queues.emplace_back(new Queue());
+
+  t_system = this;
+  t_queue = 0;
+  m_threads.reserve(workers);
+  for (unsigned i = 1; i <= workers; ++i)
+    m_threads.emplace_back(&JobSystem::workerMain, this, i);
+}
+
+JobSystem::~JobSystem() {
+  m_shutdown.store(true);
+  {
+    std::lock_guard<std::mutex> lock(m_sleepMutex);
+  }
+  m_wake.notify_all();
+  for (std::thread &thread : m_threads)
+    thread.join();
+  if (t_system == this)
+    t_system = nullptr;
+}
+
+unsigned JobSystem::currentQueue() const {
+  // Threads outside the system feed deque 0; workers steal from there
+  return t_system == this ? t_queue : 0;
+}
+
+void JobSystem::run(JobFn fn, JobCounter *signal, JobCounter *after) {
+  if (signal)
+    signal->m_pending.fetch_add(1, std::memory_order_relaxed);
+
+  Job job;
+  job.fn = std::move(fn);
+  job.signal = signal;
+
+  if (after) {
+    // Checked under the lock: finish() reaches zero and drains the
+    // continuations under the same lock, so the job is never lost
+    std::lock_guard<SpinLock> lock(after->m_lock);
+    if (after->m_pending.load(std::memory_order_acquire) > 0) {
+      after->m_continuations.push_back(std::move(job));
+      return;
+    }
+  }
+  push(std::move(job));
+}
+
+void JobSystem::push(Job &&job) {
+  Queue &queue = *m_queues[currentQueue()];
+  {
+    std::lock_guard<SpinLock> lock(queue.lock);
+    queue.jobs.push_back(std::move(job));
+  }
+  m_queued.fetch_add(1);
+  if (m_sleepers.load() > 0) {
+    // Taking the mutex orders this push before the sleeper's re-check
+    {
+      std::lock_guard<std::mutex> lock(m_sleepMutex);
+    }
+    m_wake.notify_one();
+  }
+}
+
+bool JobSystem::tryPop(unsigned self, Job &out) {
+  if (m_queued.load(std::memory_order_relaxed) <= 0)
+    return false;
+
+  // Own deque first, newest job
+  {
+    Queue &queue = *m_queues[self];
+    std::lock_guard<SpinLock> lock(queue.lock);
+    if (!queue.jobs.empty()) {
+      out = std::move(queue.jobs.back());
+      queue.jobs.pop_back();
+      m_queued.fetch_sub(1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+
+  // Steal the oldest job of another deque, starting at a random victim so
+  // thieves spread out
+  const unsigned count = (unsigned)m_queues.size();
+  t_stealSeed = t_stealSeed * 1664525u + 1013904223u + self;
+  const unsigned start = (t_stealSeed >> 16) % count;
+  for (unsigned k = 0; k < count; ++k) {
+    unsigned victim = (start + k) % count;
+    if (victim == self)
+      continue;
+    Queue &queue = *m_queues[victim];
+    std::lock_guard<SpinLock> lock(queue.lock);
+    if (!queue.jobs.empty()) {
+      out = std::move(queue.jobs.front());
+      queue.jobs.pop_front();
+      m_queued.fetch_sub(1, std::memory_order_relaxed);
+      m_steals.fetch_add(1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+  return false;
+}
+
+void JobSystem::execute(Job &job) {
+  job.fn();
+  job.fn = nullptr; // Release captures before the counter says "done"
+  if (job.signal)
+    finish(job.signal);
+}
+
+void JobSystem::finish(JobCounter *counter) {
+  std::vector<Job> ready;
+  {
+    // Decrement under the lock: wait() takes the same lock once after
+    // seeing zero, so the counter cannot be destroyed while still in use
+    std::lock_guard<SpinLock> lock(counter->m_lock);
+    if (counter->m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+      ready.swap(counter->m_continuations);
+  }
+  for (Job &job : ready)
+    push(std::move(job));
+}
+
+void JobSystem::wait(JobCounter &counter) {
+  const unsigned self = currentQueue();
+  Job job;
+  while (!counter.done()) {
+    if (tryPop(self, job))
+      execute(job);
+    else
+      std::this_thread::yield();
+  }
+  // The finishing thread may still hold the lock right after the last
+  // decrement; only return (and let the caller free the counter) after it
+  counter.m_lock.lock();
+  counter.m_lock.unlock();
+}
+
+void JobSystem::parallelFor(size_t count, size_t grain,
+                            const std::function<void(size_t, size_t)> &fn) {
+  if (count == 0)
+    return;
+  if (grain == 0)
+    grain = 1;
+  if (count <= grain || m_queues.size() == 1) {
+    fn(0, count);
+    return;
+  }
+
+  // Jobs capture two words so std::function keeps them inline (no heap)
+  struct Loop {
+    const std::function<void(size_t, size_t)> *fn;
+    size_t count, grain;
+  } loop = {&fn, count, grain};
+  const Loop *shared = &loop;
+
+  JobCounter counter;
+  const size_t chunks = (count + grain - 1) / grain;
+  for (size_t chunk = 1; chunk < chunks; ++chunk) {
+    run(
+        [shared, chunk] {
+          size_t begin = chunk * shared->grain;
+          size_t end = std::min(begin + shared->grain, shared->count);
+          (*shared->fn)(begin, end);
+        },
+        &counter);
+  }
+  // The first chunk runs right here
+  fn(0, grain);
+  wait(counter);
+}
+
+void JobSystem::workerMain(unsigned index) {
+  t_system = this;
+  t_queue = index;
+  t_stealSeed = index * 2654435761u;
+  Profiler::setThreadName(("worker " + std::to_string(index)).c_str());
+
+  Job job;
+  int idle = 0;
+  while (!m_shutdown.load(std::memory_order_relaxed)) {
+    if (tryPop(index, job)) {
+      execute(job);
+      idle = 0;
+      continue;
+    }
+    if (++idle < kIdleSpins) {
+      std::this_thread::yield();
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(m_sleepMutex);
+    m_sleepers.fetch_add(1);
+    m_wake.wait(lock, [&] {
+      return m_queued.load() > 0 || m_shutdown.load();
+    });
+    m_sleepers.fetch_sub(1);
+    idle = 0;
+  }
+}
@@ -1,7 +1,32 @@
 #include "Mesh.hpp"
+#include "bvh.hpp"
+#include "chunk_streamer.hpp"
+#include "clustered_lights.hpp"
+#include "dynamic_resolution.hpp"
+#include "entity_store.hpp"
+#include "frame_handoff.hpp"
+#include "frame_pacer.hpp"
+#include "frustum.hpp"
+#include "gbuffer.hpp"
+#include "geometry_arena.hpp"
+#include "gpu_timer.hpp"
+#include "job_system.hpp"
+#include "mesh_cache.hpp"
 #include "objloader.hpp"
+#include "occlusion_culling.hpp"
+#include "oit.hpp"
+#include "profiler.hpp"
+#include "render_queue.hpp"
+#include "render_stats.hpp"
+#include "residency.hpp"
+#include "scene_graph.hpp"
+#include "shadow_map.hpp"
+#include "stats_overlay.hpp"
+#include "stream_buffer.hpp"
+#include "texture.hpp"
 #include <GLFW/glfw3.h>
 #include <algorithm>
+#include <atomic>
 #include <cfloat>
 #include <cmath>
 #include <cstdio>
@@ -13,6 +38,7 @@
 #include <learnopengl/filesystem.h>
 #include <learnopengl/shader.h>
 #include <learnopengl/transform.h>
+#include <thread>
 #include <vector>
 
 // Camera setup
@@ -21,15 +47,86 @@ float lastX = 900.0f / 2.0;
 float lastY = 600.0f / 2.0;
 bool firstMouse = true;
 float deltaTime = 0.0f;
-float lastFrame = 0.0f;
+
+// Projection clip planes
+const float kNearPlane = 0.01f;
+const float kFarPlane = 100.0f;
+
+// Fixed simulation rate. Animation advances in steps of kSimStep no matter
+// how fast frames are rendered; frames in between are interpolated.
+const double kSimStep = 1.0 / 60.0;
+// Longest frame fed to the accumulator (avoids a spiral of catch-up ticks
+// after a stall, e.g. while the window is dragged)
+const double kMaxFrameTime = 0.25;
+const float kLightOrbitSpeed = 0.6f;  // Radians per second at speed 1.0
+const float kModelRotateSpeed = 50.0f; // Degrees per second (arrow keys)
+
+// Frame rates of the PRESENT_LIMITED mode (Z cycles them)
+const float kFpsCaps[] = {30.0f, 60.0f, 90.0f, 120.0f, 144.0f};
+const int kFpsCapCount = 5;
+
+// Crowd of deer instances (toggled with C): a grid of kCrowdSide x
+// kCrowdSide behind the main model
+const int kCrowdSide = 32;
+const float kCrowdSpacing = 1.5f;
+
+// Point light shadows (toggled with H): casters farther than kShadowFar
+// from the light are skipped; G cycles the cube face size
+const float kShadowFar = 20.0f;
+const int kShadowSizes[] = {256, 512, 1024, 2048};
+const int kShadowSizeCount = 4;
+
+// Clustered point lights (toggled with K) wandering over the crowd's
+// grid; J cycles how many are active. Depths nearer than kClusterNear
+// share the first slice.
+const uint32_t kClusterLightCounts[] = {100, 250, 500, 1000};
+const int kClusterLightCountCount = 4;
+const float kClusterNear = 0.1f;
+
+// Material of the crowd while T makes it transparent: the deer's own
+// material with this dissolve (d in the .mtl)
+const uint32_t kGlassMaterial = 1;
+const float kGlassDissolve = 0.35f;
+
+// Texture unit of the material's diffuse map (map_Kd) in phong.frag, past
+// the arena's buffer textures
+const GLint kDiffuseMapUnit = 2;
+
+// GPU memory budgets of the meshes and textures (U cycles them, 0 =
+// unlimited). The smallest is below the deer mesh alone, so it is evicted
+// whenever nothing draws it (arena path, no shadows).
+const uint64_t kResidencyBudgets[] = {0, 64ull << 20, 1ull << 20,
+                                      128ull << 10};
+const int kResidencyBudgetCount = 4;
+
+// Out-of-core mesh streamed with Y (written by mesh_chunker), placed below
+// the deer. Its chunks get their own pool under the same U budget; each is
+// drawn at the coarsest LOD whose error stays within kStreamPixelError.
+const char *const kStreamFile = "stream.chunks";
+const glm::vec3 kStreamOrigin = glm::vec3(0.0f, -4.0f, 0.0f);
+const float kStreamPixelError = 1.0f;
 
 // Store all user input states (mouse, keyboard)
 struct InputState {
   float lightRotationSpeed = 1.0f; // Speed of light orbiting
   bool lightPaused = false;        // Is light rotation paused?
-  float lightAngle = 0.0f;         // Current light position angle
   bool wireframe = false;          // Show wireframe mode?
   bool blinn = false;              // Blinn-Phong lighting?
+  PresentMode presentMode = PRESENT_VSYNC; // How frames are presented
+  int fpsCapIndex = 1; // Into kFpsCaps (PRESENT_LIMITED)
+  bool lowLatency = false; // Wait for the GPU before sampling input?
+  bool dynamicResolution = false; // Scale render size to the GPU budget?
+  bool depthPrepass = false; // Depth-only pass before shading?
+  bool occlusionCulling = false; // Hide crowd members behind others?
+  bool shadows = false;        // Shadows from the point light?
+  int shadowSizeIndex = 2;     // Into kShadowSizes
+  bool clusteredLights = false; // Many point lights, clustered?
+  int clusterLightIndex = 3;    // Into kClusterLightCounts
+  bool deferred = false;        // G-buffer + lighting pass renderer?
+  bool glassCrowd = false;      // Crowd drawn with kGlassMaterial?
+  int residencyBudgetIndex = 0; // Into kResidencyBudgets
+  bool streaming = false;       // Draw the streamed chunk mesh?
+  glm::vec2 modelTurn = glm::vec2(0.0f); // Arrow keys held (x: pitch, y: yaw)
 
   // Store if key was pressed (prevents repeated triggers)
   bool spacePressed = false;
@@ -38,13 +135,54 @@ struct InputState {
   bool rPressed = false;
   bool fPressed = false;
   bool bPressed = false;
+  bool mPressed = false;
+  bool cPressed = false;
+  bool vPressed = false;
+  bool zPressed = false;
+  bool lPressed = false;
+  bool xPressed = false;
+  bool pPressed = false;
+  bool oPressed = false;
+  bool hPressed = false;
+  bool gPressed = false;
+  bool kPressed = false;
+  bool jPressed = false;
+  bool nPressed = false;
+  bool tPressed = false;
+  bool uPressed = false;
+  bool yPressed = false;
+  bool f3Pressed = false;
+  bool f9Pressed = false;
+  bool clickPressed = false;
+  bool pickRequested = false; // Left click: pick under the cursor this frame
+
+  bool capturing = false;    // Is a steady-state profiler capture running?
+  bool writeTrace = false;   // Capture stopped, trace not yet written
+  bool showStats = false;    // Show render statistics overlay?
+  bool arenaPath = false;    // Draw meshes from the shared geometry arena?
+  bool crowd = false;        // Draw the crowd of instances?
+};
+
+// Animated state advanced once per simulation tick. The previous tick is
+// kept so rendered frames can blend between the two.
+struct SimState {
+  float lightAngle = 0.0f;                   // Light orbit angle (radians)
+  glm::vec3 modelRotation = glm::vec3(0.0f); // Deer euler angles (degrees)
 };
+SimState simPrevious;
+SimState simCurrent;
 
-// Transform for the model
-Transform modelTransform;
+// Scene hierarchy: the deer, and the light box hanging off a pivot that
+// spins around the vertical axis
+SceneGraph scene;
+NodeId deerNode = kInvalidNode;
+NodeId lightPivotNode = kInvalidNode;
+NodeId lightNode = kInvalidNode;
 
 // Read keyboard and mouse input and update the InputState
 void processInput(GLFWwindow *window, InputState &input) {
+  PROFILE_FUNCTION();
+
   // Close window if ESC is pressed
   if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
     glfwSetWindowShouldClose(window, true);
@@ -59,18 +197,16 @@ void processInput(GLFWwindow *window, InputState &input) {
   if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
     camera.ProcessKeyboard(RIGHT, deltaTime);
 
-  // Model rotation with arrow keys (using Transform)
-  glm::vec3 currentRot = modelTransform.getLocalRotation();
-  float rotSpeed = 50.0f * deltaTime;
+  // Model rotation with arrow keys (applied by the simulation ticks)
+  input.modelTurn = glm::vec2(0.0f);
   if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS)
-    currentRot.x -= rotSpeed;
+    input.modelTurn.x -= 1.0f;
   if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS)
-    currentRot.x += rotSpeed;
+    input.modelTurn.x += 1.0f;
   if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS)
-    currentRot.y -= rotSpeed;
+    input.modelTurn.y -= 1.0f;
   if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS)
-    currentRot.y += rotSpeed;
-  modelTransform.setLocalRotation(currentRot);
+    input.modelTurn.y += 1.0f;
 
   // Pause/unpause light rotation with SPACE
   if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS) {
@@ -115,11 +251,6 @@ void processInput(GLFWwindow *window, InputState &input) {
   if (glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS) {
     if (!input.fPressed) {
       input.wireframe = !input.wireframe;
-      if (input.wireframe)
-        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-      else
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-
       std::printf("Wireframe: %s\n", input.wireframe ? "ON" : "OFF");
       input.fPressed = true;
     }
@@ -138,17 +269,247 @@ void processInput(GLFWwindow *window, InputState &input) {
     input.bPressed = false;
   }
 
+  // Toggle geometry arena (multi-draw) path with M key
+  if (glfwGetKey(window, GLFW_KEY_M) == GLFW_PRESS) {
+    if (!input.mPressed) {
+      input.arenaPath = !input.arenaPath;
+      std::printf("Geometry path: %s\n",
+                  input.arenaPath ? "ARENA (multi-draw)" : "PER-MESH");
+      input.mPressed = true;
+    }
+  } else {
+    input.mPressed = false;
+  }
+
+  // Toggle crowd of deer instances with C key
+  if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS) {
+    if (!input.cPressed) {
+      input.crowd = !input.crowd;
+      std::printf("Crowd: %s\n", input.crowd ? "ON" : "OFF");
+      input.cPressed = true;
+    }
+  } else {
+    input.cPressed = false;
+  }
+
+  // Cycle presentation mode with V key (vsync, adaptive, uncapped, limited)
+  if (glfwGetKey(window, GLFW_KEY_V) == GLFW_PRESS) {
+    if (!input.vPressed) {
+      input.presentMode =
+          (PresentMode)((input.presentMode + 1) % PRESENT_MODE_COUNT);
+      std::printf("Present mode: %s\n", presentModeName(input.presentMode));
+      input.vPressed = true;
+    }
+  } else {
+    input.vPressed = false;
+  }
+
+  // Cycle the frame rate of the limited present mode with Z key
+  if (glfwGetKey(window, GLFW_KEY_Z) == GLFW_PRESS) {
+    if (!input.zPressed) {
+      input.fpsCapIndex = (input.fpsCapIndex + 1) % kFpsCapCount;
+      std::printf("Frame rate cap: %.0f FPS\n", kFpsCaps[input.fpsCapIndex]);
+      input.zPressed = true;
+    }
+  } else {
+    input.zPressed = false;
+  }
+
+  // Toggle low-latency mode with L key
+  if (glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS) {
+    if (!input.lPressed) {
+      input.lowLatency = !input.lowLatency;
+      std::printf("Low latency: %s\n", input.lowLatency ? "ON" : "OFF");
+      input.lPressed = true;
+    }
+  } else {
+    input.lPressed = false;
+  }
+
+  // Toggle dynamic resolution scaling with X key
+  if (glfwGetKey(window, GLFW_KEY_X) == GLFW_PRESS) {
+    if (!input.xPressed) {
+      input.dynamicResolution = !input.dynamicResolution;
+      std::printf("Dynamic resolution: %s\n",
+                  input.dynamicResolution ? "ON" : "OFF");
+      input.xPressed = true;
+    }
+  } else {
+    input.xPressed = false;
+  }
+
+  // Toggle depth pre-pass with P key
+  if (glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS) {
+    if (!input.pPressed) {
+      input.depthPrepass = !input.depthPrepass;
+      std::printf("Depth pre-pass: %s\n", input.depthPrepass ? "ON" : "OFF");
+      input.pPressed = true;
+    }
+  } else {
+    input.pPressed = false;
+  }
+
+  // Toggle occlusion culling of the crowd with O key
+  if (glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS) {
+    if (!input.oPressed) {
+      input.occlusionCulling = !input.occlusionCulling;
+      std::printf("Occlusion culling: %s\n",
+                  input.occlusionCulling ? "ON" : "OFF");
+      input.oPressed = true;
+    }
+  } else {
+    input.oPressed = false;
+  }
+
+  // Toggle point light shadows with H key
+  if (glfwGetKey(window, GLFW_KEY_H) == GLFW_PRESS) {
+    if (!input.hPressed) {
+      input.shadows = !input.shadows;
+      std::printf("Shadows: %s\n", input.shadows ? "ON" : "OFF");
+      input.hPressed = true;
+    }
+  } else {
+    input.hPressed = false;
+  }
+
+  // Cycle the shadow map resolution with G key
+  if (glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS) {
+    if (!input.gPressed) {
+      input.shadowSizeIndex = (input.shadowSizeIndex + 1) % kShadowSizeCount;
+      std::printf("Shadow map: %d x %d per face\n",
+                  kShadowSizes[input.shadowSizeIndex],
+                  kShadowSizes[input.shadowSizeIndex]);
+      input.gPressed = true;
+    }
+  } else {
+    input.gPressed = false;
+  }
+
+  // Toggle the clustered point lights with K key
+  if (glfwGetKey(window, GLFW_KEY_K) == GLFW_PRESS) {
+    if (!input.kPressed) {
+      input.clusteredLights = !input.clusteredLights;
+      std::printf("Clustered lights: %s\n",
+                  input.clusteredLights ? "ON" : "OFF");
+      input.kPressed = true;
+    }
+  } else {
+    input.kPressed = false;
+  }
+
+  // Cycle the number of clustered lights with J key
+  if (glfwGetKey(window, GLFW_KEY_J) == GLFW_PRESS) {
+    if (!input.jPressed) {
+      input.clusterLightIndex =
+          (input.clusterLightIndex + 1) % kClusterLightCountCount;
+      std::printf("Clustered lights: %u\n",
+                  kClusterLightCounts[input.clusterLightIndex]);
+      input.jPressed = true;
+    }
+  } else {
+    input.jPressed = false;
+  }
+
+  // Switch between forward and deferred shading with N key
+  if (glfwGetKey(window, GLFW_KEY_N) == GLFW_PRESS) {
+    if (!input.nPressed) {
+      input.deferred = !input.deferred;
+      std::printf("Renderer: %s\n", input.deferred ? "DEFERRED" : "FORWARD");
+      input.nPressed = true;
+    }
+  } else {
+    input.nPressed = false;
+  }
+
+  // Toggle the transparent (glass) crowd with T key
+  if (glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS) {
+    if (!input.tPressed) {
+      input.glassCrowd = !input.glassCrowd;
+      std::printf("Glass crowd: %s\n", input.glassCrowd ? "ON" : "OFF");
+      input.tPressed = true;
+    }
+  } else {
+    input.tPressed = false;
+  }
+
+  // Cycle the GPU memory budget of meshes and textures with U key
+  if (glfwGetKey(window, GLFW_KEY_U) == GLFW_PRESS) {
+    if (!input.uPressed) {
+      input.residencyBudgetIndex =
+          (input.residencyBudgetIndex + 1) % kResidencyBudgetCount;
+      uint64_t budget = kResidencyBudgets[input.residencyBudgetIndex];
+      if (budget == 0)
+        std::printf("Memory budget: unlimited\n");
+      else
+        std::printf("Memory budget: %.2f MB\n", (double)budget / (1 << 20));
+      input.uPressed = true;
+    }
+  } else {
+    input.uPressed = false;
+  }
+
+  // Toggle the streamed chunk mesh with Y key
+  if (glfwGetKey(window, GLFW_KEY_Y) == GLFW_PRESS) {
+    if (!input.yPressed) {
+      input.streaming = !input.streaming;
+      std::printf("Streaming: %s\n", input.streaming ? "ON" : "OFF");
+      input.yPressed = true;
+    }
+  } else {
+    input.yPressed = false;
+  }
+
+  // Pick the triangle under the cursor with the left mouse button
+  if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS) {
+    if (!input.clickPressed) {
+      input.pickRequested = true;
+      input.clickPressed = true;
+    }
+  } else {
+    input.clickPressed = false;
+  }
+
+  // Toggle render statistics overlay with F3
+  if (glfwGetKey(window, GLFW_KEY_F3) == GLFW_PRESS) {
+    if (!input.f3Pressed) {
+      input.showStats = !input.showStats;
+      std::printf("Stats overlay: %s\n", input.showStats ? "ON" : "OFF");
+      input.f3Pressed = true;
+    }
+  } else {
+    input.f3Pressed = false;
+  }
+
+  // Start/stop a profiler capture with F9 (written when stopped)
+  if (glfwGetKey(window, GLFW_KEY_F9) == GLFW_PRESS) {
+    if (!input.f9Pressed) {
+      input.capturing = !input.capturing;
+      if (input.capturing) {
+        Profiler::clear();
+        Profiler::setEnabled(true);
+        std::printf("Profiler capture: STARTED\n");
+      } else {
+        // Written by the main loop once the render thread is idle
+        Profiler::setEnabled(false);
+        input.writeTrace = true;
+      }
+      input.f9Pressed = true;
+    }
+  } else {
+    input.f9Pressed = false;
+  }
+
   // Reset everything to initial state with R key
   if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS) {
     if (!input.rPressed) {
       input.lightRotationSpeed = 1.0f;
       input.lightPaused = false;
-      input.lightAngle = 0.0f;
       input.wireframe = false;
       input.blinn = false;
-      glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-      camera = Camera(glm::vec3(0.0f, 0.0f, 3.0f));     // Reset camera
-      modelTransform.setLocalRotation(glm::vec3(0.0f)); // Reset rotation
+      camera = Camera(glm::vec3(0.0f, 0.0f, 3.0f)); // Reset camera
+      // Reset light angle and rotation; snap instead of interpolating
+      simCurrent = SimState();
+      simPrevious = simCurrent;
       std::printf("State reset: Position, Rotation, Light, Wireframe, Blinn\n");
       input.rPressed = true;
     }
@@ -157,6 +518,27 @@ void processInput(GLFWwindow *window, InputState &input) {
   }
 }
 
+// Advance the animated state by one fixed step of dt seconds
+void simulateTick(const InputState &input, float dt) {
+  simPrevious = simCurrent;
+  simCurrent.modelRotation +=
+      glm::vec3(input.modelTurn.x, input.modelTurn.y, 0.0f) *
+      (kModelRotateSpeed * dt);
+  if (!input.lightPaused)
+    simCurrent.lightAngle +=
+        input.lightRotationSpeed * kLightOrbitSpeed * dt;
+}
+
+// State shown alpha of the way from the previous tick to the current one
+SimState interpolateSim(float alpha) {
+  SimState state;
+  state.lightAngle = glm::mix(simPrevious.lightAngle, simCurrent.lightAngle,
+                              alpha);
+  state.modelRotation =
+      glm::mix(simPrevious.modelRotation, simCurrent.modelRotation, alpha);
+  return state;
+}
+
 // Mouse callback
 void mouse_callback(GLFWwindow *window, double xpos, double ypos) {
   if (firstMouse) {
@@ -210,21 +592,52 @@ GLFWwindow *initWindow(int width, int height, const char *title) {
     return nullptr;
   }
 
-  glfwSetFramebufferSizeCallback(
-      win, [](GLFWwindow *, int w, int h) { glViewport(0, 0, w, h); });
-
+  // No framebuffer-size callback: the render thread owns the context and
+  // sets the viewport from each frame's snapshot
   return win;
 }
 
-// Load deer 3D model: read OBJ file, load material from MTL file,
-// calculate size and position, return Mesh object
-Mesh *setupDeerMesh(const char *filename, float &baseScale, glm::vec3 &center,
-                    Material &outMaterial) {
-  std::string fullPath = FileSystem::getPath(filename);
+// Mesh data of a model: from its binary cache when that is up to date,
+// otherwise parsed from the OBJ file and written to the cache. Empty
+// indices, because loadOBJ returns individual triangles.
+bool loadMeshData(const std::string &fullPath, std::vector<Vertex> &vertices,
+                  std::vector<unsigned int> &indices, JobSystem *jobs) {
+  PROFILE_FUNCTION();
+  if (readMeshCache(fullPath, vertices, indices))
+    return true;
   std::vector<glm::vec3> positions;
+  std::vector<glm::vec2> uvs;
   std::vector<glm::vec3> normals;
-  bool res = loadOBJ(fullPath.c_str(), positions, normals);
-  if (!res) {
+  if (!loadOBJ(fullPath.c_str(), positions, uvs, normals, jobs))
+    return false;
+  vertices.clear();
+  indices.clear();
+  for (size_t i = 0; i < positions.size(); ++i) {
+    Vertex v;
+    v.Position = positions[i];
+    if (i < normals.size())
+      v.Normal = normals[i];
+    else
+      v.Normal = glm::vec3(0.0f, 0.0f, 1.0f);
+    v.TexCoords = i < uvs.size() ? uvs[i] : glm::vec2(0.0f);
+    vertices.push_back(v);
+  }
+  if (!writeMeshCache(fullPath, vertices, indices))
+    std::fprintf(stderr, "Impossível escrever %s\n",
+                 meshCachePath(fullPath).c_str());
+  return true;
+}
+
+// Load deer 3D model: read OBJ file (or its cache), load material from MTL
+// file, calculate size, position and bounding sphere radius, return Mesh
+// object
+Mesh *setupDeerMesh(const char *filename, float &baseScale, glm::vec3 &center,
+                    float &radius, Material &outMaterial, JobSystem *jobs) {
+  PROFILE_FUNCTION();
+  std::string fullPath = FileSystem::getPath(filename);
+  std::vector<Vertex> vertices;
+  std::vector<unsigned int> indices;
+  if (!loadMeshData(fullPath, vertices, indices, jobs)) {
     std::fprintf(stderr, "Impossível abrir %s ou processá-lo\n",
                  fullPath.c_str());
     return nullptr;
@@ -242,43 +655,87 @@ Mesh *setupDeerMesh(const char *filename, float &baseScale, glm::vec3 &center,
     if (!materials.empty()) {
       outMaterial = materials.begin()->second;
       std::printf("Material carregado de %s\n", mtlPath.c_str());
+      // map_Kd is relative to the .mtl's directory
+      size_t slash = mtlPath.find_last_of("/\\");
+      if (!outMaterial.map_Kd.empty() && slash != std::string::npos)
+        outMaterial.map_Kd = mtlPath.substr(0, slash + 1) + outMaterial.map_Kd;
     }
   } else {
     std::printf("Ficheiro .mtl não encontrado em %s, usando material padrão\n",
                 mtlPath.c_str());
     outMaterial = {glm::vec3(0.2f, 0.2f, 0.2f), glm::vec3(0.6f, 0.6f, 0.6f),
-                   glm::vec3(0.9f, 0.9f, 0.9f), 32.0f, 1.0f};
-  }
-
-  std::vector<Vertex> vertices;
-  for (size_t i = 0; i < positions.size(); ++i) {
-    Vertex v;
-    v.Position = positions[i];
-    if (i < normals.size())
-      v.Normal = normals[i];
-    else
-      v.Normal = glm::vec3(0.0f, 0.0f, 1.0f);
-    vertices.push_back(v);
+                   glm::vec3(0.9f, 0.9f, 0.9f), 32.0f, 1.0f, ""};
   }
 
   glm::vec3 minb(FLT_MAX), maxb(-FLT_MAX);
-  for (auto &v : positions) {
-    minb = glm::min(minb, v);
-    maxb = glm::max(maxb, v);
+  for (auto &v : vertices) {
+    minb = glm::min(minb, v.Position);
+    maxb = glm::max(maxb, v.Position);
   }
   center = (minb + maxb) * 0.5f;
   glm::vec3 diag = maxb - minb;
+  radius = 0.5f * glm::length(diag);
   float extent = std::max(diag.x, std::max(diag.y, diag.z));
   if (extent <= 0.0f)
     extent = 1.0f;
   baseScale = 1.0f / extent;
 
-  // Empty indices because loadOBJ returns individual triangles, not indexed
-  // geometry
-  std::vector<unsigned int> indices;
   return new Mesh(vertices, indices);
 }
 
+// Normalized view depth (0 = near plane, 1 = far plane) of a model's origin,
+// used for the depth bits of the render queue sort key
+float viewDepth01(const glm::mat4 &view, const glm::mat4 &model, float zNear,
+                  float zFar) {
+  float depth = -(view * model[3]).z;
+  return (depth - zNear) / (zFar - zNear);
+}
+
+// Cast a ray from the cursor through the view and projection into the
+// instance hierarchy and print what it hits. While the cursor is captured
+// for mouse look it is pinned to the window center. Instance 0 is the main
+// deer, instance i + 1 crowd member i. The printed time counts from
+// startNs, so it can include building the hierarchy.
+void pickAtCursor(GLFWwindow *window, const glm::mat4 &view,
+                  const glm::mat4 &proj, const InstanceBvh &tlas,
+                  uint64_t startNs) {
+  PROFILE_FUNCTION();
+  int width = 0, height = 0;
+  glfwGetWindowSize(window, &width, &height);
+  double x = 0.5 * width, y = 0.5 * height;
+  if (glfwGetInputMode(window, GLFW_CURSOR) != GLFW_CURSOR_DISABLED)
+    glfwGetCursorPos(window, &x, &y);
+  if (width <= 0 || height <= 0)
+    return;
+
+  // Cursor to NDC (window y points down), then onto the near and far planes
+  glm::vec2 ndc((float)(2.0 * x / width - 1.0),
+                (float)(1.0 - 2.0 * y / height));
+  glm::mat4 invViewProj = glm::inverse(proj * view);
+  glm::vec4 nearPoint = invViewProj * glm::vec4(ndc.x, ndc.y, -1.0f, 1.0f);
+  glm::vec4 farPoint = invViewProj * glm::vec4(ndc.x, ndc.y, 1.0f, 1.0f);
+  Ray ray;
+  ray.origin = glm::vec3(nearPoint) / nearPoint.w;
+  ray.direction = glm::vec3(farPoint) / farPoint.w - ray.origin;
+
+  InstanceHit hit;
+  bool found = tlas.intersect(ray, hit);
+  float us = (float)(Profiler::nowNs() - startNs) * 1e-3f;
+  if (!found) {
+    std::printf("Pick: nothing (%.1f us)\n", us);
+  } else if (hit.instance == 0) {
+    std::printf("Pick: deer, triangle %u, barycentrics (%.3f, %.3f), "
+                "distance %.3f (%.1f us)\n",
+                hit.triangle, hit.u, hit.v,
+                hit.t * glm::length(ray.direction), us);
+  } else {
+    std::printf("Pick: crowd #%u, triangle %u, barycentrics (%.3f, %.3f), "
+                "distance %.3f (%.1f us)\n",
+                hit.instance - 1, hit.triangle, hit.u, hit.v,
+                hit.t * glm::length(ray.direction), us);
+  }
+}
+
 // Create a small box to show the light source position
 GLuint setupLightBox(size_t &indexCount) {
   // 8 vertices of a cube (size 0.1 x 0.1 x 0.1)
@@ -362,151 +819,1151 @@ GLuint setupLightBox(size_t &indexCount) {
   glBindVertexArray(lightVAO);
   glGenBuffers(1, &lightVBO);
   glBindBuffer(GL_ARRAY_BUFFER, lightVBO);
-  glBufferData(GL_ARRAY_BUFFER, boxVerts.size() * sizeof(float),
-               boxVerts.data(), GL_STATIC_DRAW);
+  countedBufferData(GL_ARRAY_BUFFER, boxVerts.size() * sizeof(float),
+                    boxVerts.data(), GL_STATIC_DRAW);
   glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
   glEnableVertexAttribArray(0);
   glGenBuffers(1, &lightEBO);
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, lightEBO);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-               boxIndices.size() * sizeof(unsigned int), boxIndices.data(),
-               GL_STATIC_DRAW);
+  countedBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                    boxIndices.size() * sizeof(unsigned int), boxIndices.data(),
+                    GL_STATIC_DRAW);
 
   indexCount = boxIndices.size();
   return lightVAO;
 }
 
+// Everything the render thread needs to draw one frame. Filled by the
+// simulation thread, then handed over whole, so the two threads never
+// touch the same scene state.
+struct FrameSnapshot {
+  uint64_t frame = 0; // 1, 2, 3, ... in publish order
+  float simMs = 0.0f; // Simulation time spent building this snapshot
+  int simTicks = 0;   // Fixed simulation steps run for this frame
+  uint64_t inputNs = 0; // Profiler::nowNs() when input was sampled
+  int fbw = 0, fbh = 0;
+  glm::mat4 view = glm::mat4(1.0f);
+  glm::mat4 proj = glm::mat4(1.0f);
+  glm::mat4 deerModel = glm::mat4(1.0f);
+  glm::vec3 lightPos = glm::vec3(0.0f);
+
+  bool wireframe = false;
+  bool blinn = false;
+  bool arenaPath = false;
+  bool showStats = false;
+  PresentMode presentMode = PRESENT_VSYNC;
+  float fpsCap = 60.0f; // PRESENT_LIMITED rate
+  bool lowLatency = false;
+  bool dynamicResolution = false;
+  bool depthPrepass = false;
+  bool occlusionCulling = false; // Capture depth for the next culls
+  bool shadows = false;
+  int shadowSize = 1024;
+  // Everything within kShadowFar of the light, visible or not
+  std::vector<ShadowCaster> shadowCasters;
+  bool clusteredLights = false;
+  ClusterLists clusters; // Binned for this frame's view
+  bool deferred = false;
+  uint64_t residencyBudget = 0; // Bytes, 0 = unlimited
+  bool streaming = false;
+
+  // Crowd instances that passed frustum culling
+  std::vector<glm::mat4> crowdModels;
+  std::vector<uint32_t> crowdMaterials;
+  uint32_t crowdCulled = 0;
+  uint32_t crowdOccluded = 0;
+};
+
+// GL objects created at startup and used only by the render thread
+struct RenderResources {
+  Mesh *deerMesh = nullptr;
+  int deerArenaMesh = -1;
+  Shader *phongShader = nullptr;
+  Shader *lightShader = nullptr;
+  Shader *arenaShader = nullptr;
+  Shader *depthShader = nullptr;
+  Shader *shadowShader = nullptr;
+  Shader *gbufferShader = nullptr;
+  Shader *deferredShader = nullptr;
+  Shader *compositeShader = nullptr;
+  GLuint lightVAO = 0;
+  size_t lightIndexCount = 0;
+  std::vector<Material> materials; // Indexed by DrawData::material
+  std::vector<GLuint> textures;   // Diffuse maps, 0 while evicted
+  std::vector<int> materialTextures; // Index into textures, or -1
+  ResidencyManager *residency = nullptr; // Budget of meshes and textures
+  int deerMeshResidency = -1;            // ResidencyManager ids
+  std::vector<int> textureResidency;     // Per texture
+  ChunkStreamer *streamer = nullptr; // Null without a chunk file
+  RenderQueue renderQueue;
+  GeometryArena *arena = nullptr;
+  StreamBuffer *frameStream = nullptr;
+  StatsOverlay *statsOverlay = nullptr;
+  bool wireframe = false; // Polygon mode currently set on the context
+  FramePacer *pacer = nullptr;
+  GpuTimer *gpuTimer = nullptr;           // GPU time of the scene pass
+  uint64_t gpuResults = 0;                // gpuTimer results already used
+  DynamicResolution *dynamicRes = nullptr; // Scaled scene target
+  DepthReadback *depthReadback = nullptr;  // Scene depth for occlusion
+  PointShadowMap *shadowMap = nullptr;
+  GpuTimer *shadowTimer = nullptr; // GPU time of the last shadow render
+  bool shadowUpdated = false;      // Shadow map re-rendered this frame
+  ClusterBuffers *clusterBuffers = nullptr;
+  GBuffer *gbuffer = nullptr; // Deferred path
+  WeightedBlendedOit *oit = nullptr; // Transparent pass
+};
+
+// Simulation -> render handoff, and how far the render thread has got
+FrameHandoff<FrameSnapshot> frameHandoff;
+// Render -> simulation: depth pyramids for occlusion culling
+FrameHandoff<DepthPyramid> depthHandoff;
+// Pyramids older than this many frames are not used
+const uint64_t kMaxPyramidAge = 4;
+std::atomic<bool> renderRunning{false};
+std::atomic<uint64_t> framesAcquired{0}; // Last snapshot taken for drawing
+std::atomic<uint64_t> framesRendered{0}; // Last snapshot fully submitted
+
+// Record and submit one frame from a snapshot (render thread)
+void renderFrame(const FrameSnapshot &frame, RenderResources &res,
+                 float frameMs) {
+  Shader &phongShader = *res.phongShader;
+  Shader &lightShader = *res.lightShader;
+  Shader &depthShader = *res.depthShader;
+  Shader &gbufferShader = *res.gbufferShader;
+  Shader &deferredShader = *res.deferredShader;
+  Shader &compositeShader = *res.compositeShader;
+  const glm::mat4 &view = frame.view;
+  const glm::mat4 &proj = frame.proj;
+
+  // Make what this frame draws resident before any pass binds state: a
+  // reload creates buffers and textures. The deer mesh feeds the per-mesh
+  // path and the shadow pass; textures only the per-mesh path.
+  res.residency->setBudget(frame.residencyBudget);
+  bool deerReady = true; // False only when a reload failed
+  if (!frame.arenaPath || frame.shadows)
+    deerReady = res.residency->use(res.deerMeshResidency);
+  if (!frame.arenaPath) {
+    auto useMaterial = [&](uint32_t material) {
+      int texture = res.materialTextures[material];
+      if (texture >= 0)
+        res.residency->use(res.textureResidency[texture]);
+    };
+    useMaterial(0);
+    for (uint32_t material : frame.crowdMaterials)
+      useMaterial(material);
+  }
+  // Streamed chunks: uploads of finished reads, for the same reason, and
+  // the LODs to read next. Errors are measured in window pixels. Both
+  // pools share the U budget: the chunks get what the deer and textures
+  // leave (at least 1 byte, as 0 would mean unlimited).
+  const bool streaming = frame.streaming && res.streamer;
+  const glm::mat4 streamModel = glm::translate(glm::mat4(1.0f), kStreamOrigin);
+  if (streaming) {
+    uint64_t chunkBudget = 0;
+    if (frame.residencyBudget) {
+      uint64_t used = std::min(frame.residencyBudget,
+                               res.residency->residentBytes());
+      chunkBudget = std::max<uint64_t>(frame.residencyBudget - used, 1);
+    }
+    glm::vec3 cameraPos = glm::vec3(glm::inverse(view)[3]);
+    res.streamer->setBudget(chunkBudget);
+    res.streamer->update(cameraPos - kStreamOrigin,
+                         (float)frame.fbh * proj[1][1] * 0.5f);
+  } else if (res.streamer) {
+    res.streamer->evictAll(); // Y off: give the chunks' memory back
+  }
+
+  // Claim this frame's region of the streaming buffer
+  res.frameStream->beginFrame();
+
+  // Shadow pass, only when the light or a caster moved, and timed apart
+  // from the scene pass
+  res.shadowUpdated = false;
+  if (frame.shadows && deerReady) {
+    res.shadowMap->setSize(frame.shadowSize);
+    if (res.shadowMap->needsUpdate(frame.lightPos, frame.shadowCasters)) {
+      PROFILE_ZONE("shadow pass");
+      Shader &shadowShader = *res.shadowShader;
+      const Mesh &mesh = *res.deerMesh;
+      res.shadowTimer->begin();
+      countedUseProgram(shadowShader.ID);
+      countedBindVertexArray(mesh.getPositionVAO());
+      shadowShader.setVec3("LightPos", frame.lightPos);
+      shadowShader.setFloat("FarPlane", res.shadowMap->farPlane());
+      res.shadowMap->render(
+          frame.lightPos, frame.shadowCasters,
+          [&](const glm::mat4 &faceViewProj, const ShadowCaster &caster) {
+            shadowShader.setMat4("FaceViewProj", faceViewProj);
+            shadowShader.setMat4("ModelMatrix", caster.model);
+            if (!mesh.isIndexed())
+              countedDrawArrays(GL_TRIANGLES, 0,
+                                (GLsizei)mesh.vertexCount());
+            else
+              countedDrawElements(GL_TRIANGLES,
+                                  (GLsizei)mesh.indexCount(),
+                                  GL_UNSIGNED_INT, 0);
+          });
+      res.shadowTimer->end();
+      res.wireframe = false; // The shadow pass always fills
+      res.shadowUpdated = true;
+    }
+  }
+
+  // Light lists of this frame's clusters
+  if (frame.clusteredLights)
+    res.clusterBuffers->upload(frame.clusters);
+
+  // Scene pass: offscreen at a reduced size, or straight to the window
+  res.gpuTimer->begin();
+  if (frame.dynamicResolution)
+    res.dynamicRes->begin(frame.fbw, frame.fbh);
+  else
+    glViewport(0, 0, frame.fbw, frame.fbh);
+  int renderWidth =
+      frame.dynamicResolution ? res.dynamicRes->renderWidth() : frame.fbw;
+  int renderHeight =
+      frame.dynamicResolution ? res.dynamicRes->renderHeight() : frame.fbh;
+  if (frame.wireframe != res.wireframe) {
+    glPolygonMode(GL_FRONT_AND_BACK, frame.wireframe ? GL_LINE : GL_FILL);
+    res.wireframe = frame.wireframe;
+  }
+  res.pacer->configure(frame.presentMode, frame.fpsCap);
+  res.pacer->pollFences();
+
+  // Clear screen for next frame
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+  // Convert light position to camera space
+  glm::vec4 lightPosEye = view * glm::vec4(frame.lightPos, 1.0f);
+
+  renderStats().objectsVisible += (uint32_t)frame.crowdModels.size();
+  renderStats().objectsCulled += frame.crowdCulled;
+  renderStats().objectsOccluded += frame.crowdOccluded;
+
+  // --- Record draws ---
+  RenderQueue &renderQueue = res.renderQueue;
+  renderQueue.clear();
+
+  // Deer go through the queue unless the arena path draws them. With the
+  // pre-pass each deer is drawn twice: positions only into depth, then
+  // shaded where its depth is the one that survived. The deferred path
+  // draws them into the G-buffer and lights every pixel once afterwards.
+  // Deer with a dissolve below 1 are forward shaded in the transparent
+  // pass instead, in any order.
+  const bool prepass = frame.depthPrepass && !frame.arenaPath;
+  const bool deferred = frame.deferred && !frame.arenaPath;
+  if (!frame.arenaPath && deerReady) {
+    DrawData deerDraw;
+    deerDraw.program = deferred ? gbufferShader.ID : phongShader.ID;
+    deerDraw.vao = res.deerMesh->getVAO();
+    deerDraw.material = 0;
+    deerDraw.indexed = res.deerMesh->isIndexed();
+    deerDraw.count =
+        (GLsizei)(deerDraw.indexed ? res.deerMesh->indexCount()
+                                   : res.deerMesh->vertexCount());
+    DrawData depthDraw = deerDraw;
+    depthDraw.program = depthShader.ID;
+    depthDraw.vao = res.deerMesh->getPositionVAO();
+
+    DrawData glassDraw = deerDraw;
+    glassDraw.program = phongShader.ID;
+
+    auto submitDeer = [&](const glm::mat4 &model, uint32_t material) {
+      if (res.materials[material].d < 1.0f) {
+        glassDraw.material = material;
+        glassDraw.model = model;
+        // Constant depth: OIT needs no back-to-front order
+        renderQueue.submit(PASS_TRANSPARENT, glassDraw, 1.0f);
+        return;
+      }
+      float depth01 = viewDepth01(view, model, kNearPlane, kFarPlane);
+      deerDraw.material = material;
+      deerDraw.model = model;
+      renderQueue.submit(PASS_OPAQUE, deerDraw, depth01);
+      if (prepass) {
+        depthDraw.model = model;
+        renderQueue.submit(PASS_DEPTH_PREPASS, depthDraw, depth01);
+      }
+    };
+    submitDeer(frame.deerModel, 0);
+    for (size_t i = 0; i < frame.crowdModels.size(); ++i)
+      submitDeer(frame.crowdModels[i], frame.crowdMaterials[i]);
+  }
+
+  // Visible chunks at their best resident LOD, with material 0
+  if (streaming) {
+    std::vector<ChunkDraw> chunkDraws;
+    res.streamer->collectDraws(extractFrustum(proj * view * streamModel),
+                               chunkDraws);
+    DrawData chunkDraw;
+    chunkDraw.program = deferred ? gbufferShader.ID : phongShader.ID;
+    chunkDraw.indexed = true;
+    chunkDraw.model = streamModel;
+    DrawData depthDraw = chunkDraw;
+    depthDraw.program = depthShader.ID;
+    for (const ChunkDraw &chunk : chunkDraws) {
+      // Distance to the chunk's bounds orders the opaque pass front to back
+      float depth01 = std::min(chunk.distance / kFarPlane, 1.0f);
+      chunkDraw.vao = depthDraw.vao = chunk.vao;
+      chunkDraw.count = depthDraw.count = chunk.indexCount;
+      renderQueue.submit(PASS_OPAQUE, chunkDraw, depth01);
+      if (prepass)
+        renderQueue.submit(PASS_DEPTH_PREPASS, depthDraw, depth01);
+    }
+  }
+
+  // Light source as small yellow box
+  DrawData lightDraw;
+  lightDraw.program = lightShader.ID;
+  lightDraw.vao = res.lightVAO;
+  lightDraw.indexed = true;
+  lightDraw.count = (GLsizei)res.lightIndexCount;
+  lightDraw.model = glm::translate(glm::mat4(1.0f), frame.lightPos);
+  renderQueue.submit(
+      PASS_UNLIT, lightDraw,
+      viewDepth01(view, lightDraw.model, kNearPlane, kFarPlane));
+
+  // --- Submit sorted draws ---
+  RenderQueue::Hooks hooks;
+  // Lighting uniforms shared by phong.frag and deferred.frag
+  auto setLighting = [&](Shader &shader) {
+    shader.setVec4("Light.Position", lightPosEye);
+    shader.setVec3("Light.La", 0.1f, 0.1f, 0.1f);
+    shader.setVec3("Light.Ld", 0.8f, 0.8f, 0.8f);
+    shader.setVec3("Light.Ls", 1.0f, 1.0f, 1.0f);
+    // Blinn-Phong toggle
+    shader.setBool("blinn", frame.blinn);
+    shader.setBool("shadows", frame.shadows);
+    if (frame.shadows) {
+      // View is rigid: its inverse rotation is the transpose
+      shader.setMat3("EyeToWorld", glm::transpose(glm::mat3(view)));
+      shader.setFloat("ShadowFar", res.shadowMap->farPlane());
+      // About 1.5 texels of a 90 degree face
+      shader.setFloat("ShadowFilterRadius",
+                      1.5f * 1.5708f / (float)res.shadowMap->size());
+    }
+    shader.setBool("clustered", frame.clusteredLights);
+    if (frame.clusteredLights) {
+      // gl_FragCoord is in render target pixels
+      shader.setVec2("ClusterTileSize",
+                     glm::vec2((float)renderWidth / LightClusters::kTilesX,
+                               (float)renderHeight / LightClusters::kTilesY));
+      shader.setFloat("ClusterNear", kClusterNear);
+      shader.setFloat("ClusterLogRatio", std::log(kFarPlane / kClusterNear));
+    }
+  };
+  // Deferred lighting: back to the scene target, then one full-screen
+  // pass that also restores the scene depth for the forward draws after it.
+  // Run from onPass, so the queue rebinds its state after it.
+  bool lightingDone = false;
+  auto lightGBuffer = [&]() {
+    PROFILE_ZONE("deferred lighting");
+    lightingDone = true;
+    res.gbuffer->end();
+    if (res.wireframe)
+      glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    glDepthMask(GL_TRUE);
+    glDepthFunc(GL_ALWAYS);
+    countedUseProgram(deferredShader.ID);
+    setLighting(deferredShader);
+    deferredShader.setMat4("InverseProjection", glm::inverse(proj));
+    deferredShader.setVec2("ViewportSize",
+                           glm::vec2((float)renderWidth, (float)renderHeight));
+    res.gbuffer->drawLighting();
+    glDepthFunc(GL_LESS);
+    if (res.wireframe)
+      glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+  };
+  // Transparent pass: accumulate, then blend the average over the scene.
+  // The resolve also runs from onPass, so the queue rebinds after it.
+  bool oitActive = false;
+  auto resolveOit = [&]() {
+    PROFILE_ZONE("oit resolve");
+    oitActive = false;
+    if (res.wireframe)
+      glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    res.oit->resolve(compositeShader.ID);
+    if (res.wireframe)
+      glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+  };
+  GLint oitLocation = glGetUniformLocation(phongShader.ID, "oit");
+  // Fixed-function state of each pass
+  hooks.onPass = [&](uint32_t pass) {
+    if (deferred && !lightingDone && pass >= PASS_UNLIT)
+      lightGBuffer();
+    if (oitActive && pass > PASS_TRANSPARENT)
+      resolveOit();
+    bool depthOnly = pass == PASS_DEPTH_PREPASS;
+    bool depthDone = prepass && pass == PASS_OPAQUE;
+    GLboolean color = depthOnly ? GL_FALSE : GL_TRUE;
+    glColorMask(color, color, color, color);
+    glDepthFunc(depthDone ? GL_EQUAL : GL_LESS);
+    glDepthMask(depthDone ? GL_FALSE : GL_TRUE);
+    // Phong may stay bound across passes, so this is not an onProgram
+    // uniform
+    glProgramUniform1i(phongShader.ID, oitLocation,
+                       pass == PASS_TRANSPARENT ? 1 : 0);
+    if (pass == PASS_TRANSPARENT) {
+      res.oit->begin(renderWidth, renderHeight);
+      oitActive = true;
+    }
+  };
+  // Per-program uniforms: set once each time the program is bound
+  hooks.onProgram = [&](GLuint program) {
+    if (program == phongShader.ID) {
+      setLighting(phongShader);
+    } else if (program == lightShader.ID) {
+      lightShader.setVec3("LightColor", 1.0f, 1.0f, 0.0f); // Yellow color
+    }
+  };
+  // Send material values to shader (loaded from .mtl or default)
+  hooks.onMaterial = [&](GLuint program, uint32_t material) {
+    if (program == gbufferShader.ID)
+      gbufferShader.setInt("MaterialIndex", (int)material);
+    if (program != phongShader.ID)
+      return;
+    const Material &mat = res.materials[material];
+    phongShader.setVec3("Material.Ka", mat.Ka);
+    phongShader.setVec3("Material.Kd", mat.Kd);
+    phongShader.setVec3("Material.Ks", mat.Ks);
+    phongShader.setFloat("Material.Shininess", mat.Ns);
+    phongShader.setFloat("Material.Dissolve", mat.d);
+    int texture = res.materialTextures[material];
+    GLuint diffuseMap = texture >= 0 ? res.textures[texture] : 0;
+    phongShader.setBool("textured", diffuseMap != 0);
+    if (diffuseMap) {
+      glActiveTexture(GL_TEXTURE0 + kDiffuseMapUnit);
+      glBindTexture(GL_TEXTURE_2D, diffuseMap);
+      glActiveTexture(GL_TEXTURE0);
+    }
+  };
+  // Per-draw matrices
+  hooks.onDraw = [&](GLuint program, const DrawData &draw) {
+    PROFILE_ZONE("upload uniforms");
+    glm::mat4 modelView = view * draw.model;
+    if (program == phongShader.ID) {
+      // Normal matrix for lighting calculations
+      glm::mat3 normalMatrix =
+          glm::mat3(glm::transpose(glm::inverse(modelView)));
+      phongShader.setMat4("ModelViewMatrix", modelView);
+      phongShader.setMat4("MVP", proj * modelView);
+      phongShader.setMat3("NormalMatrix", normalMatrix);
+    } else if (program == gbufferShader.ID) {
+      gbufferShader.setMat4("MVP", proj * modelView);
+      gbufferShader.setMat3(
+          "NormalMatrix", glm::mat3(glm::transpose(glm::inverse(modelView))));
+    } else if (program == depthShader.ID) {
+      depthShader.setMat4("MVP", proj * modelView);
+    } else {
+      lightShader.setMat4("MVP", proj * modelView);
+    }
+  };
+
+  renderQueue.sort();
+  if (deferred)
+    res.gbuffer->begin(renderWidth, renderHeight);
+  renderQueue.execute(hooks);
+  if (deferred && !lightingDone)
+    lightGBuffer(); // Nothing forward-drawn after the opaque pass
+  if (oitActive)
+    resolveOit();
+  // Back to the defaults (glClear also needs depth writes on)
+  if (prepass)
+    hooks.onPass(PASS_OVERLAY);
+
+  // Same deer from the shared arena: every mesh in one multi-draw
+  if (frame.arenaPath) {
+    ArenaFrameUniforms uniforms;
+    uniforms.view = view;
+    uniforms.projection = proj;
+    uniforms.lightPosition = lightPosEye;
+    uniforms.la = glm::vec4(0.1f, 0.1f, 0.1f, 0.0f);
+    uniforms.ld = glm::vec4(0.8f, 0.8f, 0.8f, 0.0f);
+    uniforms.ls = glm::vec4(1.0f, 1.0f, 1.0f, 0.0f);
+    uniforms.blinn = frame.blinn ? 1 : 0;
+
+    GeometryArena &arena = *res.arena;
+    res.arenaShader->use();
+    arena.beginFrame();
+    int deerInstance = arena.addInstance(frame.deerModel, 0);
+    arena.addDraw(res.deerArenaMesh, deerInstance);
+    for (size_t i = 0; i < frame.crowdModels.size(); ++i) {
+      int instance =
+          arena.addInstance(frame.crowdModels[i], frame.crowdMaterials[i]);
+      if (instance >= 0)
+        arena.addDraw(res.deerArenaMesh, instance);
+    }
+    arena.submit(*res.frameStream, uniforms);
+  }
+
+  // Read the scene depth back for the simulation thread's occlusion tests
+  if (frame.occlusionCulling) {
+    res.depthReadback->capture(renderWidth, renderHeight, proj * view,
+                               frame.frame);
+    if (res.depthReadback->collect(depthHandoff.writeSlot()))
+      depthHandoff.publish();
+  }
+
+  // Upscale to the window; the overlay below is drawn at full size
+  if (frame.dynamicResolution)
+    res.dynamicRes->resolve();
+  res.gpuTimer->end();
+
+  // Nothing reads this frame's stream region after this point
+  res.frameStream->endFrame();
+
+  // Results arrive a few frames late; each one steers the scale once
+  if (res.gpuTimer->resultCount() != res.gpuResults) {
+    res.gpuResults = res.gpuTimer->resultCount();
+    if (frame.dynamicResolution)
+      res.dynamicRes->update(res.gpuTimer->lastMs());
+  }
+
+  // Evict down to the budget what this frame did not draw
+  res.residency->endFrame();
+
+  // Close this frame's counters and show the last complete frame
+  endFrameStats();
+  if (frame.showStats) {
+    std::vector<std::string> lines = formatRenderStats(lastFrameStats());
+    char line[64];
+    std::snprintf(line, sizeof line, "FRAME %.2f MS", frameMs);
+    lines.insert(lines.begin(), line);
+    std::snprintf(line, sizeof line, "SIM %.2f MS %d TICKS", frame.simMs,
+                  frame.simTicks);
+    lines.insert(lines.begin() + 1, line);
+    char mode[32];
+    if (frame.presentMode == PRESENT_LIMITED)
+      std::snprintf(mode, sizeof mode, "%s %.0f FPS",
+                    presentModeName(frame.presentMode), frame.fpsCap);
+    else
+      std::snprintf(mode, sizeof mode, "%s",
+                    presentModeName(frame.presentMode));
+    std::snprintf(line, sizeof line, "%s%s LATENCY %.1f MS", mode,
+                  frame.lowLatency ? " LOW-LATENCY" : "",
+                  res.pacer->latencyMs());
+    lines.insert(lines.begin() + 2, line);
+    std::snprintf(line, sizeof line, "GPU %.2f MS%s%s SCALE %.2f %dX%d",
+                  res.gpuTimer->lastMs(), deferred ? " DEFERRED" : "",
+                  prepass ? " PREPASS" : "",
+                  frame.dynamicResolution ? res.dynamicRes->scale() : 1.0f,
+                  renderWidth, renderHeight);
+    lines.insert(lines.begin() + 3, line);
+    if (frame.shadows) {
+      std::snprintf(line, sizeof line, "SHADOW %.2f MS %dPX %s %u DRAWS",
+                    res.shadowTimer->lastMs(), res.shadowMap->size(),
+                    res.shadowUpdated ? "UPDATED" : "CACHED",
+                    res.shadowMap->lastDraws());
+      lines.insert(lines.begin() + 4, line);
+    }
+    if (frame.clusteredLights) {
+      std::snprintf(line, sizeof line,
+                    "LIGHTS %zu BIN %.2f MS %zu LISTED MAX %u",
+                    frame.clusters.lights.size() / 2, frame.clusters.binMs,
+                    frame.clusters.indices.size(),
+                    frame.clusters.maxPerCluster);
+      lines.insert(lines.begin() + (frame.shadows ? 5 : 4), line);
+    }
+    const ResidencyStats &residency = res.residency->lastFrame();
+    std::snprintf(line, sizeof line, "VRAM %.2f/%.2f MB %u/%u RESIDENT",
+                  (double)residency.residentBytes / (1 << 20),
+                  (double)residency.budgetBytes / (1 << 20),
+                  residency.resident, residency.total);
+    lines.push_back(line);
+    std::snprintf(line, sizeof line, "LOADS %u %.1f KB EVICTS %u %.1f KB",
+                  residency.loads, (double)residency.loadedBytes / 1024.0,
+                  residency.evictions,
+                  (double)residency.evictedBytes / 1024.0);
+    lines.push_back(line);
+    if (streaming) {
+      const ChunkStreamStats &stream = res.streamer->stats();
+      std::snprintf(line, sizeof line,
+                    "STREAM %u/%u DRAWN %u MISSING %u PENDING", stream.drawn,
+                    stream.chunks, stream.missing, stream.pending);
+      lines.push_back(line);
+      std::snprintf(line, sizeof line, "CHUNKS %.2f/%.2f MB LODS %u %u %u %u",
+                    (double)stream.residentBytes / (1 << 20),
+                    (double)stream.budgetBytes / (1 << 20),
+                    stream.drawnPerLod[0], stream.drawnPerLod[1],
+                    stream.drawnPerLod[2], stream.drawnPerLod[3]);
+      lines.push_back(line);
+    }
+    res.statsOverlay->draw(lines, frame.fbw, frame.fbh);
+  }
+}
+
+// Render thread: owns the GL context, draws the newest snapshot and
+// presents it. Vsync stalls in glfwSwapBuffers and the frame limiter only
+// block this thread.
+void renderThreadMain(GLFWwindow *win, RenderResources *res) {
+  Profiler::setThreadName("render");
+  glfwMakeContextCurrent(win);
+
+  double lastSwap = glfwGetTime();
+  float frameMs = 0.0f;
+  while (renderRunning.load(std::memory_order_acquire)) {
+    if (!frameHandoff.acquire()) {
+      std::this_thread::yield(); // Simulation has nothing new yet
+      continue;
+    }
+    const FrameSnapshot &frame = frameHandoff.readSlot();
+    framesAcquired.store(frame.frame, std::memory_order_release);
+    {
+      PROFILE_ZONE("render frame");
+      renderFrame(frame, *res, frameMs);
+    }
+    // Display rendered image on screen
+    res->pacer->waitForNextFrame();
+    {
+      PROFILE_ZONE("glfwSwapBuffers");
+      glfwSwapBuffers(win);
+    }
+    res->pacer->frameSubmitted(frame.inputNs, frame.lowLatency);
+    double now = glfwGetTime();
+    frameMs = (float)((now - lastSwap) * 1000.0);
+    lastSwap = now;
+    framesRendered.store(frame.frame, std::memory_order_release);
+  }
+  glfwMakeContextCurrent(nullptr);
+}
+
+// Block until the render thread has finished snapshot `frame`
+void waitForRendered(uint64_t frame) {
+  while (framesRendered.load(std::memory_order_acquire) < frame)
+    std::this_thread::yield();
+}
+
 int main() {
+  // Profile startup (window, loaders, shaders); dumped before the first frame
+  Profiler::setThreadName("main");
+  Profiler::setEnabled(true);
+
   // initialize window
   GLFWwindow *win = initWindow(900, 600, "TP2 - Rendering .obj file");
   if (!win) // treat if error creating window
     return -1;
 
+  // Worker threads for loading, culling and scene updates
+  JobSystem *jobs = new JobSystem();
+
   float baseScale = 1.0f; // How much to scale the model
   glm::vec3 center(0.0f); // Center point of the model
+  float radius = 0.0f;    // Bounding sphere radius (mesh space)
 
   // Object to store material properties (Ka, Kd, Ks, Ns)
   Material deerMaterial;
 
   // Load the deer 3D model from file
-  Mesh *deerMesh = setupDeerMesh("deer.obj", baseScale, center, deerMaterial);
+  Mesh *deerMesh = setupDeerMesh("deer.obj", baseScale, center, radius,
+                                 deerMaterial, jobs);
   if (!deerMesh) {
+    delete jobs;
     glfwTerminate();
     return -1;
   }
 
   // Compile and link Phong shader program for realistic lighting using
   // LearnOpenGL Shader class
+  uint64_t shaderStartNs = Profiler::nowNs();
   Shader phongShader(FileSystem::getPath("shaders/phong.vert").c_str(),
                      FileSystem::getPath("shaders/phong.frag").c_str());
   Shader lightShader(FileSystem::getPath("shaders/simple.vert").c_str(),
                      FileSystem::getPath("shaders/simple.frag").c_str());
+  Shader arenaShader(FileSystem::getPath("shaders/arena.vert").c_str(),
+                     FileSystem::getPath("shaders/arena.frag").c_str());
+  Shader depthShader(FileSystem::getPath("shaders/depth.vert").c_str(),
+                     FileSystem::getPath("shaders/depth.frag").c_str());
+  Shader shadowShader(FileSystem::getPath("shaders/shadow.vert").c_str(),
+                      FileSystem::getPath("shaders/shadow.frag").c_str());
+  Shader gbufferShader(FileSystem::getPath("shaders/gbuffer.vert").c_str(),
+                       FileSystem::getPath("shaders/gbuffer.frag").c_str());
+  Shader deferredShader(
+      FileSystem::getPath("shaders/fullscreen.vert").c_str(),
+      FileSystem::getPath("shaders/deferred.frag").c_str());
+  Shader compositeShader(
+      FileSystem::getPath("shaders/fullscreen.vert").c_str(),
+      FileSystem::getPath("shaders/oit_composite.frag").c_str());
+  Profiler::record("compile shaders", shaderStartNs, Profiler::nowNs());
 
   // State for inputs
   InputState input;
 
-  size_t lightIndexCount = 0;
-  GLuint lightVAO = setupLightBox(lightIndexCount);
+  RenderResources res;
+  res.deerMesh = deerMesh;
+  res.phongShader = &phongShader;
+  res.lightShader = &lightShader;
+  res.arenaShader = &arenaShader;
+  res.depthShader = &depthShader;
+  res.shadowShader = &shadowShader;
+  res.gbufferShader = &gbufferShader;
+  res.deferredShader = &deferredShader;
+  res.compositeShader = &compositeShader;
+  res.lightVAO = setupLightBox(res.lightIndexCount);
+  Material glassMaterial = deerMaterial;
+  glassMaterial.d = kGlassDissolve;
+  res.materials = {deerMaterial, glassMaterial}; // kGlassMaterial is 1
+
+  // Diffuse maps (map_Kd): each distinct image decoded, mipmapped and
+  // block-compressed (where supported) in its own job, or read back from
+  // its .tex cache
+  std::vector<std::string> texturePaths;
+  for (const Material &mat : res.materials)
+    if (!mat.map_Kd.empty() &&
+        std::find(texturePaths.begin(), texturePaths.end(), mat.map_Kd) ==
+            texturePaths.end())
+      texturePaths.push_back(mat.map_Kd);
+  // S3TC is an extension: without it the textures stay RGBA8
+  TextureOptions textureOptions;
+  textureOptions.compress = textureCompressionSupported();
+  if (!textureOptions.compress)
+    std::printf("Sem S3TC: texturas sem compressão (RGBA8)\n");
+  std::vector<TextureData> textureData;
+  std::vector<bool> texturesLoaded;
+  loadTextures(texturePaths, textureData, texturesLoaded, textureOptions,
+               jobs);
+  res.textures.assign(texturePaths.size(), 0);
+  for (size_t i = 0; i < texturePaths.size(); ++i) {
+    if (texturesLoaded[i])
+      res.textures[i] = createTexture(textureData[i]);
+    std::printf("Textura %s: %s\n", texturePaths[i].c_str(),
+                res.textures[i] ? "carregada" : "falhou");
+  }
+  for (const Material &mat : res.materials) {
+    size_t index = std::find(texturePaths.begin(), texturePaths.end(),
+                             mat.map_Kd) -
+                   texturePaths.begin();
+    res.materialTextures.push_back(
+        index < texturePaths.size() ? (int)index : -1);
+  }
+
+  // GPU memory of the deer mesh and the textures, under the budget of the
+  // U key. Evicted meshes come back from their binary cache, textures from
+  // their .tex cache, on the render thread when next drawn.
+  res.residency = new ResidencyManager(kResidencyBudgets[0]);
+  std::string deerPath = FileSystem::getPath("deer.obj");
+  res.deerMeshResidency = res.residency->add(
+      "deer.obj",
+      [deerMesh, deerPath]() -> size_t {
+        std::vector<Vertex> vertices;
+        std::vector<unsigned int> indices;
+        if (!loadMeshData(deerPath, vertices, indices, nullptr))
+          return 0;
+        deerMesh->reload(std::move(vertices), std::move(indices));
+        return deerMesh->gpuBytes();
+      },
+      [deerMesh]() { deerMesh->release(); }, deerMesh->gpuBytes());
+  for (size_t i = 0; i < texturePaths.size(); ++i) {
+    GLuint *slot = &res.textures[i];
+    std::string path = texturePaths[i];
+    res.textureResidency.push_back(res.residency->add(
+        path,
+        [slot, path, textureOptions]() -> size_t {
+          TextureData data;
+          if (!loadTexture(path.c_str(), data, textureOptions))
+            return 0;
+          *slot = createTexture(data);
+          return *slot ? textureBytes(data) : 0;
+        },
+        [slot]() {
+          glDeleteTextures(1, slot);
+          *slot = 0;
+        },
+        res.textures[i] ? textureBytes(textureData[i]) : 0));
+  }
+  // Chunked mesh streamed from disk (Y), if one was built
+  res.streamer = new ChunkStreamer();
+  if (res.streamer->open(FileSystem::getPath(kStreamFile))) {
+    res.streamer->setMaxPixelError(kStreamPixelError);
+  } else {
+    std::printf("Ficheiro %s não encontrado (Y): cria-o com "
+                "mesh_chunker --terrain 2000 %s\n",
+                kStreamFile, kStreamFile);
+    delete res.streamer;
+    res.streamer = nullptr;
+  }
+  phongShader.use();
+  phongShader.setInt("DiffuseMap", kDiffuseMapUnit);
+
+  // Shared geometry buffers for the multi-draw path (toggled with M)
+  res.arena = new GeometryArena(deerMesh->vertices.size() + 65536,
+                                std::max(deerMesh->indices.size(),
+                                         deerMesh->vertices.size()) +
+                                    65536,
+                                4096);
+  res.deerArenaMesh = res.arena->addMesh(deerMesh->vertices, deerMesh->indices);
+  res.arena->setMaterials(res.materials);
+  GeometryArena::setupProgram(arenaShader.ID);
+
+  // Per-frame GPU data (instance data, frame uniforms, indirect commands),
+  // triple-buffered and fenced so CPU writes never wait on the GPU
+  res.frameStream = new StreamBuffer(1 << 20, 3);
+
+  // Text overlay for render statistics (toggled with F3)
+  res.statsOverlay = new StatsOverlay();
+
+  // Swap interval, frame limiter and latency measurement (V and L keys)
+  res.pacer = new FramePacer();
+
+  // Scene GPU time, and the offscreen target scaled by it (X key)
+  res.gpuTimer = new GpuTimer();
+  res.dynamicRes = new DynamicResolution();
+
+  // Depth readback feeding the crowd's occlusion culling (O key)
+  res.depthReadback = new DepthReadback();
+
+  // Point light shadow cube map (H key, G for its size), kept bound to its
+  // own texture unit for phong.frag
+  res.shadowMap = new PointShadowMap(kShadowSizes[input.shadowSizeIndex],
+                                     kShadowFar);
+  res.shadowTimer = new GpuTimer();
+  glActiveTexture(GL_TEXTURE0 + PointShadowMap::kTextureUnit);
+  glBindTexture(GL_TEXTURE_CUBE_MAP, res.shadowMap->texture());
+  glActiveTexture(GL_TEXTURE0);
+  phongShader.use();
+  phongShader.setInt("ShadowMap", PointShadowMap::kTextureUnit);
+  deferredShader.use();
+  deferredShader.setInt("ShadowMap", PointShadowMap::kTextureUnit);
+  glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+
+  // Light lists of the clustered point lights (K key)
+  res.clusterBuffers = new ClusterBuffers();
+  ClusterBuffers::setupProgram(phongShader.ID);
+  ClusterBuffers::setupProgram(deferredShader.ID);
+
+  // G-buffer of the deferred path (N key), lit by deferred.frag
+  res.gbuffer = new GBuffer();
+  res.gbuffer->setMaterials(res.materials);
+  GBuffer::setupProgram(deferredShader.ID);
+
+  // Accumulation targets of the transparent pass (T key for a glass crowd)
+  res.oit = new WeightedBlendedOit();
+  WeightedBlendedOit::setupProgram(compositeShader.ID);
 
   glClearColor(0.1f, 0.1f, 0.1f, 1.0f); // Dark gray background
 
   glEnable(GL_DEPTH_TEST); // Enable depth testing for 3D effect
 
   // Configure model transform
-  modelTransform.setLocalScale(glm::vec3(baseScale));
-  modelTransform.setLocalPosition(-center * baseScale); // Center the model
-  modelTransform.computeModelMatrix();
+  deerNode = scene.createNode();
+  scene.setLocalScale(deerNode, glm::vec3(baseScale));
+  scene.setLocalPosition(deerNode, -center * baseScale); // Center the model
+
+  // Light orbits the model: the pivot turns, the light sits on its X axis
+  float lightRadius = 2.0f; // Distance from center
+  lightPivotNode = scene.createNode();
+  lightNode = scene.createNode(lightPivotNode);
+  // Higher light for better floor shadow/lighting
+  scene.setLocalPosition(lightNode, glm::vec3(lightRadius, 2.0f, 0.0f));
+  scene.update(jobs);
+
+  // Crowd of deer in a grid behind the model, each turned a different way
+  EntityStore crowd;
+  for (int row = 0; row < kCrowdSide; ++row) {
+    for (int col = 0; col < kCrowdSide; ++col) {
+      EntityId deer = crowd.create(0, 0, center, radius);
+      glm::vec3 slot((col - kCrowdSide / 2) * kCrowdSpacing, 0.0f,
+                     -2.0f - row * kCrowdSpacing);
+      crowd.setScale(deer, glm::vec3(baseScale));
+      crowd.setRotation(deer,
+                        glm::vec3(0.0f, (float)((row * 37 + col * 83) % 360),
+                                  0.0f));
+      crowd.setPosition(deer, slot - center * baseScale);
+    }
+  }
+  std::vector<uint32_t> visibleCrowd;
+
+  // Ray queries for picking: one BLAS for the deer mesh, and a TLAS over
+  // the deer instances rebuilt on each click
+  Bvh deerBlas;
+  {
+    std::vector<glm::vec3> positions(deerMesh->vertices.size());
+    for (size_t i = 0; i < positions.size(); ++i)
+      positions[i] = deerMesh->vertices[i].Position;
+    deerBlas.build(positions.data(), positions.size() / 3, jobs);
+  }
+  InstanceBvh pickTlas;
+  std::vector<BvhInstance> pickInstances;
+
+  // Point lights circling random spots over the crowd, each at its own
+  // speed; their paths follow the main light's angle, so SPACE pauses them
+  struct WanderingLight {
+    glm::vec3 center;
+    float orbit, speed, phase;
+  };
+  std::vector<WanderingLight> wanderers;
+  std::vector<PointLight> clusterLights;
+  {
+    uint32_t seed = 12345u;
+    auto random01 = [&seed]() {
+      seed = seed * 1664525u + 1013904223u; // LCG
+      return (float)(seed >> 8) / 16777216.0f;
+    };
+    float halfWidth = 0.5f * kCrowdSide * kCrowdSpacing;
+    for (uint32_t i = 0; i < kClusterLightCounts[kClusterLightCountCount - 1];
+         ++i) {
+      WanderingLight wanderer;
+      wanderer.center =
+          glm::vec3((random01() * 2.0f - 1.0f) * halfWidth,
+                    0.2f + 0.8f * random01(),
+                    2.0f - random01() * (kCrowdSide * kCrowdSpacing + 4.0f));
+      wanderer.orbit = 0.5f + 1.5f * random01();
+      wanderer.speed = (random01() < 0.5f ? -1.0f : 1.0f) *
+                       (0.5f + 1.5f * random01());
+      wanderer.phase = random01() * 6.2832f;
+      wanderers.push_back(wanderer);
+
+      PointLight light;
+      light.position = wanderer.center;
+      light.radius = 1.5f + 1.5f * random01();
+      light.color = glm::vec3(0.2f + 0.8f * random01(),
+                              0.2f + 0.8f * random01(),
+                              0.2f + 0.8f * random01());
+      clusterLights.push_back(light);
+    }
+  }
+  LightClusters lightClusters;
 
+  // Startup capture done; steady-state captures are started with F9
+  Profiler::setEnabled(false);
+  Profiler::writeChromeTrace("trace_startup.json");
+  Profiler::clear();
+
+  // Startup uploads are not part of any frame
+  renderStats() = RenderStats();
+
+  // Hand the context to the render thread; from here on this thread only
+  // polls input and simulates
+  glfwMakeContextCurrent(nullptr);
+  renderRunning.store(true);
+  std::thread renderThread(renderThreadMain, win, &res);
+
+  double lastTime = glfwGetTime();
+  double accumulator = 0.0; // Simulation time not yet consumed by ticks
+  uint64_t frameIndex = 0;
   while (!glfwWindowShouldClose(win)) {
+    // Run at most one frame ahead: simulating frame N+1 overlaps the render
+    // thread submitting frame N, and no snapshot is dropped unseen. In
+    // low-latency mode wait until frame N is finished on the GPU instead,
+    // so the input sampled next is shown as soon as possible.
+    if (input.lowLatency) {
+      waitForRendered(frameIndex);
+    } else {
+      while (framesAcquired.load(std::memory_order_acquire) < frameIndex)
+        std::this_thread::yield();
+    }
+    ++frameIndex;
+
+    PROFILE_ZONE("simulate");
+    uint64_t simStartNs = Profiler::nowNs();
+
     // Per-frame time logic
-    float currentFrame = glfwGetTime();
-    deltaTime = currentFrame - lastFrame;
-    lastFrame = currentFrame;
+    double now = glfwGetTime();
+    double frameTime = std::min(now - lastTime, kMaxFrameTime);
+    lastTime = now;
+    deltaTime = (float)frameTime;
 
-    // Read user input
+    // Handle window events (close, resize, etc.) and read user input
+    glfwPollEvents();
     processInput(win, input);
+    uint64_t inputNs = Profiler::nowNs();
+
+    // A stopped capture is written once every published frame is drawn,
+    // so no other thread is recording while the file is written
+    if (input.writeTrace) {
+      waitForRendered(frameIndex - 1);
+      Profiler::writeChromeTrace("trace_frames.json");
+      input.writeTrace = false;
+    }
 
-    // Clear screen for next frame
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-    // Update light position angle if not paused
-    if (!input.lightPaused) {
-      input.lightAngle += input.lightRotationSpeed * 0.01f;
+    FrameSnapshot &frame = frameHandoff.writeSlot();
+    frame.frame = frameIndex;
+    frame.inputNs = inputNs;
+
+    // Run as many fixed steps as the elapsed time covers (zero or more),
+    // then show the state between the last two steps
+    accumulator += frameTime;
+    frame.simTicks = 0;
+    while (accumulator >= kSimStep) {
+      simulateTick(input, (float)kSimStep);
+      accumulator -= kSimStep;
+      frame.simTicks++;
     }
+    SimState shown = interpolateSim((float)(accumulator / kSimStep));
 
     // Setup camera and projection (handles window resize)
-    int fbw, fbh;
-    glfwGetFramebufferSize(win, &fbw, &fbh);
-    float aspect = (fbh == 0) ? 1.0f : (float)fbw / (float)fbh;
+    glfwGetFramebufferSize(win, &frame.fbw, &frame.fbh);
+    float aspect =
+        (frame.fbh == 0) ? 1.0f : (float)frame.fbw / (float)frame.fbh;
 
     // Use Camera class for view matrix
-    glm::mat4 view = camera.GetViewMatrix();
+    frame.view = camera.GetViewMatrix();
     // Create perspective projection (45 degree field of view)
-    glm::mat4 proj =
-        glm::perspective(glm::radians(camera.Zoom), aspect, 0.01f, 100.0f);
-
-    // --- Draw Deer ---
-    // Update model matrix from Transform class
-    modelTransform.computeModelMatrix();
-    glm::mat4 model = modelTransform.getModelMatrix();
-
-    // Calculate transformation matrices for shader
-    glm::mat4 modelView = view * model;
-    // Model-View-Projection matrix
-    glm::mat4 MVP = proj * modelView;
-    // Normal matrix for lighting calculations
-    glm::mat3 normalMatrix = glm::mat3(glm::transpose(glm::inverse(modelView)));
-
-    // Activate shader
-    phongShader.use();
-
-    // Send matrices to shader
-    phongShader.setMat4("ModelViewMatrix", modelView);
-    phongShader.setMat4("MVP", MVP);
-    phongShader.setMat3("NormalMatrix", normalMatrix);
-
-    // Calculate light position orbiting around the model
-    float lightRadius = 2.0f; // Distance from center
-    glm::vec3 lightPos(lightRadius * std::cos(input.lightAngle),
-                       2.0f, // Higher light for better floor shadow/lighting
-                       lightRadius * std::sin(input.lightAngle));
-    // Convert light position to camera space
-    glm::vec4 lightPosEye = view * glm::vec4(lightPos, 1.0f);
-
-    phongShader.setVec4("Light.Position", lightPosEye);
-    phongShader.setVec3("Light.La", 0.1f, 0.1f, 0.1f);
-    phongShader.setVec3("Light.Ld", 0.8f, 0.8f, 0.8f);
-    phongShader.setVec3("Light.Ls", 1.0f, 1.0f, 1.0f);
-
-    // Send material values to shader (loaded from .mtl or default)
-    phongShader.setVec3("Material.Ka", deerMaterial.Ka);
-    phongShader.setVec3("Material.Kd", deerMaterial.Kd);
-    phongShader.setVec3("Material.Ks", deerMaterial.Ks);
-    phongShader.setFloat("Material.Shininess", deerMaterial.Ns);
+    frame.proj = glm::perspective(glm::radians(camera.Zoom), aspect,
+                                  kNearPlane, kFarPlane);
+
+    // Spin the light pivot (a Y rotation of -angle puts the light at
+    // (r cos(angle), 2, r sin(angle))) and update the world matrices.
+    // Rotations are only set when they changed, so a still deer or a
+    // paused light leaves its node clean and update() skips it.
+    const glm::vec3 pivotRotation(0.0f, -glm::degrees(shown.lightAngle),
+                                  0.0f);
+    if (scene.getTransform(deerNode).getLocalRotation() !=
+        shown.modelRotation)
+      scene.setLocalRotation(deerNode, shown.modelRotation);
+    if (scene.getTransform(lightPivotNode).getLocalRotation() !=
+        pivotRotation)
+      scene.setLocalRotation(lightPivotNode, pivotRotation);
+    scene.update(jobs);
+    frame.deerModel = scene.getWorldMatrix(deerNode);
+    // Light position orbiting around the model
+    frame.lightPos = glm::vec3(scene.getWorldMatrix(lightNode)[3]);
+
+    // Frustum-cull the crowd; survivors are drawn like the main deer
+    visibleCrowd.clear();
+    frame.crowdModels.clear();
+    frame.crowdMaterials.clear();
+    frame.crowdCulled = 0;
+    frame.crowdOccluded = 0;
+    if (input.crowd) {
+      crowd.update(jobs);
+      crowd.cull(extractFrustum(frame.proj * frame.view), visibleCrowd, jobs);
+      frame.crowdCulled = (uint32_t)(crowd.size() - visibleCrowd.size());
+
+      // Then drop the deer hidden behind the depth of a recent frame
+      depthHandoff.acquire();
+      const DepthPyramid &pyramid = depthHandoff.readSlot();
+      if (input.occlusionCulling && pyramid.valid() &&
+          frameIndex - pyramid.frame() <= kMaxPyramidAge) {
+        PROFILE_ZONE("occlusion cull");
+        size_t kept = 0;
+        for (uint32_t index : visibleCrowd)
+          if (!pyramid.sphereOccluded(crowd.worldSphere(index)))
+            visibleCrowd[kept++] = index;
+        frame.crowdOccluded = (uint32_t)(visibleCrowd.size() - kept);
+        visibleCrowd.resize(kept);
+      }
+      for (uint32_t index : visibleCrowd) {
+        frame.crowdModels.push_back(crowd.worldMatrix(index));
+        frame.crowdMaterials.push_back(
+            input.glassCrowd ? kGlassMaterial : crowd.material(index));
+      }
+    }
 
-    // Blinn-Phong toggle
-    phongShader.setBool("blinn", input.blinn);
+    if (input.pickRequested) {
+      input.pickRequested = false;
+      uint64_t pickStartNs = Profiler::nowNs();
+      pickInstances.clear();
+      BvhInstance instance;
+      instance.blas = &deerBlas;
+      instance.model = frame.deerModel;
+      instance.id = 0;
+      pickInstances.push_back(instance);
+      if (input.crowd) {
+        for (uint32_t i = 0; i < (uint32_t)crowd.size(); ++i) {
+          instance.model = crowd.worldMatrix(i);
+          instance.id = i + 1;
+          pickInstances.push_back(instance);
+        }
+      }
+      pickTlas.build(pickInstances.data(), pickInstances.size());
+      pickAtCursor(win, frame.view, frame.proj, pickTlas, pickStartNs);
+    }
 
-    deerMesh->Draw(phongShader.ID);
+    // Shadow casters: the deer, and crowd members near enough to the light
+    frame.shadowCasters.clear();
+    if (input.shadows) {
+      ShadowCaster caster;
+      caster.model = frame.deerModel;
+      caster.sphere =
+          glm::vec4(glm::vec3(frame.deerModel * glm::vec4(center, 1.0f)),
+                    radius * baseScale);
+      frame.shadowCasters.push_back(caster);
+      if (input.crowd) {
+        for (uint32_t i = 0; i < (uint32_t)crowd.size(); ++i) {
+          glm::vec4 sphere = crowd.worldSphere(i);
+          if (glm::length(glm::vec3(sphere) - frame.lightPos) - sphere.w >
+              kShadowFar)
+            continue;
+          caster.model = crowd.worldMatrix(i);
+          caster.sphere = sphere;
+          frame.shadowCasters.push_back(caster);
+        }
+      }
+    }
 
-    // Draw light source as small yellow sphere
-    lightShader.use();
-    glm::mat4 lightModel = glm::translate(glm::mat4(1.0f), lightPos);
-    glm::mat4 lightMVP = proj * view * lightModel;
-    lightShader.setMat4("MVP", lightMVP);
-    lightShader.setVec3("LightColor", 1.0f, 1.0f, 0.0f); // Yellow color
+    // Move the clustered lights and bin them for this view
+    if (input.clusteredLights) {
+      PROFILE_ZONE("cluster lights");
+      size_t count = kClusterLightCounts[input.clusterLightIndex];
+      for (size_t i = 0; i < count; ++i) {
+        const WanderingLight &wanderer = wanderers[i];
+        float angle = wanderer.phase + wanderer.speed * shown.lightAngle;
+        clusterLights[i].position =
+            wanderer.center + wanderer.orbit * glm::vec3(std::cos(angle), 0.0f,
+                                                         std::sin(angle));
+      }
+      ClusterCamera clusterCamera;
+      clusterCamera.view = frame.view;
+      clusterCamera.fovY = glm::radians(camera.Zoom);
+      clusterCamera.aspect = aspect;
+      clusterCamera.zNear = kClusterNear;
+      clusterCamera.zFar = kFarPlane;
+      lightClusters.build(clusterLights.data(), count, clusterCamera,
+                          frame.clusters, jobs);
+    }
 
-    glBindVertexArray(lightVAO);
-    glDrawElements(GL_TRIANGLES, (GLsizei)lightIndexCount, GL_UNSIGNED_INT, 0);
+    frame.wireframe = input.wireframe;
+    frame.blinn = input.blinn;
+    frame.arenaPath = input.arenaPath;
+    frame.showStats = input.showStats;
+    frame.presentMode = input.presentMode;
+    frame.fpsCap = kFpsCaps[input.fpsCapIndex];
+    frame.lowLatency = input.lowLatency;
+    frame.dynamicResolution = input.dynamicResolution;
+    frame.depthPrepass = input.depthPrepass;
+    frame.occlusionCulling = input.occlusionCulling && input.crowd;
+    frame.shadows = input.shadows;
+    frame.shadowSize = kShadowSizes[input.shadowSizeIndex];
+    frame.clusteredLights = input.clusteredLights;
+    frame.deferred = input.deferred;
+    frame.residencyBudget = kResidencyBudgets[input.residencyBudgetIndex];
+    frame.streaming = input.streaming;
+    frame.simMs = (float)(Profiler::nowNs() - simStartNs) * 1e-6f;
+    frameHandoff.publish();
+  }
 
-    // Display rendered image on screen
-    glfwSwapBuffers(win);
-    // Handle window events (close, resize, etc.)
-    glfwPollEvents();
+  // Stop the render thread and take the context back for cleanup
+  renderRunning.store(false);
+  renderThread.join();
+  glfwMakeContextCurrent(win);
+
+  // Flush a capture that was still running when the window closed
+  if (input.capturing || input.writeTrace) {
+    Profiler::setEnabled(false);
+    Profiler::writeChromeTrace("trace_frames.json");
   }
 
   // Clean up memory
   delete deerMesh;
+  delete res.statsOverlay;
+  delete res.arena;
+  delete res.frameStream;
+  delete res.pacer;
+  delete res.gpuTimer;
+  delete res.dynamicRes;
+  delete res.depthReadback;
+  delete res.shadowMap;
+  delete res.shadowTimer;
+  delete res.clusterBuffers;
+  delete res.gbuffer;
+  delete res.oit;
+  delete res.residency;
+  delete res.streamer;
+  for (GLuint texture : res.textures)
+    if (texture)
+      glDeleteTextures(1, &texture);
+  delete jobs;
   // Close OpenGL window and cleanup
   glfwTerminate();
-}
\ No newline at end of file
+}
@@ -0,0 +1,112 @@
+#include "mesh_cache.hpp"
+#include "profiler.hpp"
+#include <sys/stat.h>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+const char kMagic[4] = {'T', 'P', '2', 'M'};
+const uint32_t kVersion = 1;
+
+struct MeshCacheHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t vertexSize; // sizeof(Vertex) when written
+  uint32_t padding;
+  uint64_t sourceSize;
+  int64_t sourceTime;
+  uint64_t vertexCount;
+  uint64_t indexCount;
+};
+
+bool modelStamp(const std::string &modelPath, MeshCacheHeader &header) {
+  struct stat info;
+  if (stat(modelPath.c_str(), &info) != 0)
+    return false;
+  std::memcpy(header.magic, kMagic, 4);
+  header.version = kVersion;
+  header.vertexSize = (uint32_t)sizeof(Vertex);
+  header.padding = 0;
+  header.sourceSize = (uint64_t)info.st_size;
+  header.sourceTime = (int64_t)info.st_mtime;
+  return true;
+}
+} // namespace
+
+std::string meshCachePath(const std::string &modelPath) {
+  return modelPath + ".mesh";
+}
+
+bool writeMeshCache(const std::string &modelPath,
+                    const std::vector<Vertex> &vertices,
+                    const std::vector<unsigned int> &indices) {
+  PROFILE_FUNCTION();
+  MeshCacheHeader header;
+  if (!modelStamp(modelPath, header))
+    return false;
+  header.vertexCount = vertices.size();
+  header.indexCount = indices.size();
+
+  std::string path = meshCachePath(modelPath);
+  FILE *file = std::fopen(path.c_str(), "wb");
+  if (!file)
+    return false;
+  bool ok = std::fwrite(&header, sizeof header, 1, file) == 1 &&
+            (vertices.empty() ||
+             std::fwrite(vertices.data(), sizeof(Vertex), vertices.size(),
+                         file) == vertices.size()) &&
+            (indices.empty() ||
+             std::fwrite(indices.data(), sizeof(unsigned int), indices.size(),
+                         file) == indices.size());
+  ok = std::fclose(file) == 0 && ok;
+  if (!ok)
+    std::remove(path.c_str()); // Never leave a truncated cache
+  return ok;
+}
+
+bool readMeshCache(const std::string &modelPath, std::vector<Vertex> &vertices,
+                   std::vector<unsigned int> &indices) {
+  PROFILE_FUNCTION();
+  MeshCacheHeader expected;
+  if (!modelStamp(modelPath, expected))
+    return false;
+  FILE *file = std::fopen(meshCachePath(modelPath).c_str(), "rb");
+  if (!file)
+    return false;
+
+  MeshCacheHeader header;
+  bool ok = std::fread(&header, sizeof header, 1, file) == 1 &&
+            !std::memcmp(header.magic, kMagic, 4) &&
+            header.version == kVersion &&
+            header.vertexSize == expected.vertexSize &&
+            header.sourceSize == expected.sourceSize &&
+            header.sourceTime == expected.sourceTime;
+  // Sizes from the file are checked against its length before allocating
+  if (ok) {
+    long dataStart = std::ftell(file);
+    std::fseek(file, 0, SEEK_END);
+    uint64_t dataBytes = (uint64_t)(std::ftell(file) - dataStart);
+    std::fseek(file, dataStart, SEEK_SET);
+    ok = header.vertexCount <= dataBytes / sizeof(Vertex) &&
+         header.indexCount <= dataBytes / sizeof(unsigned int) &&
+         header.vertexCount * sizeof(Vertex) +
+                 header.indexCount * sizeof(unsigned int) ==
+             dataBytes;
+  }
+  if (ok) {
+    vertices.resize(header.vertexCount);
+    indices.resize(header.indexCount);
+    ok = (vertices.empty() ||
+          std::fread(vertices.data(), sizeof(Vertex), vertices.size(),
+                     file) == vertices.size()) &&
+         (indices.empty() ||
+          std::fread(indices.data(), sizeof(unsigned int), indices.size(),
+                     file) == indices.size());
+  }
+  std::fclose(file);
+  if (!ok) {
+    vertices.clear();
+    indices.clear();
+  }
+  return ok;
+}
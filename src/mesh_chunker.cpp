@@ -0,0 +1,270 @@
+// Offline chunker for out-of-core meshes: splits a model into spatial
+// chunks with their bounds and LODs and writes them to one paged chunk
+// file, which tp2 then streams (ChunkStreamer). The model is streamed too:
+// the OBJ is read line by line on every pass and only its vertex
+// attributes stay in memory (faces index them), the terrain is generated
+// on the fly, and buildChunkFile holds one bucket of triangles at a time.
+//
+// Usage: mesh_chunker [options] [model.obj] out.chunks
+//   --threads N           job system workers (default: hardware threads - 1)
+//   --max-triangles N     triangles per chunk (default 16384)
+//   --bucket-triangles N  triangles refined in memory at once (default 2^20)
+//   --terrain N           instead of a model, an N x N heightfield (2 N^2
+//                         triangles), to try sizes far beyond the deer
+//   --terrain-size S      side of the heightfield in model units (default 200)
+#include "chunked_mesh.hpp"
+#include "job_system.hpp"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+double nowMs() {
+  using namespace std::chrono;
+  return duration<double, std::milli>(steady_clock::now().time_since_epoch())
+      .count();
+}
+
+struct Options {
+  unsigned threads = 0;
+  ChunkBuildOptions build;
+  unsigned terrain = 0;
+  float terrainSize = 200.0f;
+  std::vector<std::string> paths;
+};
+
+bool parseOptions(int argc, char **argv, Options &opt) {
+  for (int i = 1; i < argc; ++i) {
+    const char *arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (!std::strcmp(arg, "--threads") && hasValue) {
+      opt.threads = (unsigned)std::atoi(argv[++i]);
+    } else if (!std::strcmp(arg, "--max-triangles") && hasValue) {
+      opt.build.maxTriangles = (size_t)std::atol(argv[++i]);
+    } else if (!std::strcmp(arg, "--bucket-triangles") && hasValue) {
+      opt.build.bucketTriangles = (size_t)std::atol(argv[++i]);
+    } else if (!std::strcmp(arg, "--terrain") && hasValue) {
+      opt.terrain = (unsigned)std::atoi(argv[++i]);
+    } else if (!std::strcmp(arg, "--terrain-size") && hasValue) {
+      opt.terrainSize = (float)std::atof(argv[++i]);
+    } else if (arg[0] != '-') {
+      opt.paths.push_back(arg);
+    } else {
+      return false;
+    }
+  }
+  // A model and the output, or only the output with --terrain
+  return opt.paths.size() == (opt.terrain ? 1u : 2u) &&
+         opt.build.maxTriangles > 0 && opt.build.bucketTriangles > 0;
+}
+
+float terrainHeight(float x, float z) {
+  return 2.0f * std::sin(x * 0.11f) * std::cos(z * 0.07f) +
+         0.5f * std::sin(x * 0.53f + z * 0.37f);
+}
+
+// Rolling hills centred on the origin, generated row by row
+bool emitTerrain(unsigned n, float size, const TriangleSink &sink) {
+  float step = size / (float)n;
+  auto vertex = [&](unsigned i, unsigned j) {
+    Vertex v;
+    float x = -0.5f * size + step * (float)i;
+    float z = -0.5f * size + step * (float)j;
+    v.Position = glm::vec3(x, terrainHeight(x, z), z);
+    float dx = terrainHeight(x + 0.01f, z) - terrainHeight(x - 0.01f, z);
+    float dz = terrainHeight(x, z + 0.01f) - terrainHeight(x, z - 0.01f);
+    v.Normal = glm::normalize(glm::vec3(-dx / 0.02f, 1.0f, -dz / 0.02f));
+    v.TexCoords = glm::vec2((float)i / (float)n, (float)j / (float)n);
+    return v;
+  };
+  for (unsigned j = 0; j < n; ++j) {
+    for (unsigned i = 0; i < n; ++i) {
+      Vertex a = vertex(i, j), b = vertex(i + 1, j);
+      Vertex c = vertex(i + 1, j + 1), d = vertex(i, j + 1);
+      // Counter-clockwise seen from above
+      const Vertex first[3] = {a, d, c}, second[3] = {a, c, b};
+      sink(first);
+      sink(second);
+    }
+  }
+  return true;
+}
+
+// Reads a whole line, however long, past the size of one fgets buffer
+bool readLine(FILE *file, std::string &line) {
+  char buffer[4096];
+  line.clear();
+  while (std::fgets(buffer, sizeof buffer, file)) {
+    line += buffer;
+    if (line.back() == '\n')
+      return true;
+  }
+  return !line.empty();
+}
+
+const char *skipSpaces(const char *p) {
+  while (*p == ' ' || *p == '\t')
+    ++p;
+  return p;
+}
+
+// The faces of an OBJ file as triangles, read line by line on every pass.
+// The positions, normals and texture coordinates are kept after the first
+// pass, since faces index them; same conventions as loadOBJ (absolute
+// indices, polygons fanned, a missing normal is +Y and a missing uv 0).
+class ObjSource {
+public:
+  explicit ObjSource(const std::string &path) : m_path(path) {}
+
+  bool read(const TriangleSink &sink) {
+    FILE *file = std::fopen(m_path.c_str(), "rb");
+    if (!file) {
+      std::fprintf(stderr, "Impossível abrir %s\n", m_path.c_str());
+      return false;
+    }
+    std::string line;
+    std::vector<Vertex> face;
+    size_t lineNumber = 0;
+    bool ok = true;
+    while (ok && readLine(file, line)) {
+      ++lineNumber;
+      const char *p = skipSpaces(line.c_str());
+      bool blank = p[0] && (p[1] == ' ' || p[1] == '\t');
+      if (p[0] == 'v' && blank) {
+        if (!m_loaded)
+          m_positions.push_back(parseVec3(p + 1));
+      } else if (p[0] == 'v' && p[1] == 't') {
+        if (!m_loaded) {
+          char *next = nullptr;
+          glm::vec2 uv;
+          uv.x = std::strtof(p + 2, &next);
+          uv.y = std::strtof(next, &next);
+          m_uvs.push_back(uv);
+        }
+      } else if (p[0] == 'v' && p[1] == 'n') {
+        if (!m_loaded)
+          m_normals.push_back(parseVec3(p + 2));
+      } else if (p[0] == 'f' && blank) {
+        ok = parseFace(p + 1, face);
+        for (size_t k = 2; ok && k < face.size(); ++k) {
+          const Vertex triangle[3] = {face[0], face[k - 1], face[k]};
+          sink(triangle);
+        }
+      }
+    }
+    std::fclose(file);
+    if (!ok)
+      std::fprintf(stderr, "%s:%zu: face inválida\n", m_path.c_str(),
+                   lineNumber);
+    m_loaded = m_loaded || ok;
+    return ok;
+  }
+
+private:
+  static glm::vec3 parseVec3(const char *p) {
+    char *next = nullptr;
+    glm::vec3 v;
+    v.x = std::strtof(p, &next);
+    v.y = std::strtof(next, &next);
+    v.z = std::strtof(next, &next);
+    return v;
+  }
+
+  // "v", "v/vt", "v//vn" or "v/vt/vn" per corner
+  bool parseFace(const char *p, std::vector<Vertex> &face) const {
+    face.clear();
+    for (;;) {
+      p = skipSpaces(p);
+      char *next = nullptr;
+      unsigned long vi = std::strtoul(p, &next, 10), ti = 0, ni = 0;
+      if (next == p)
+        break; // End of the line (or "\r")
+      p = next;
+      if (*p == '/') {
+        ++p;
+        if (*p != '/') {
+          ti = std::strtoul(p, &next, 10);
+          p = next;
+        }
+        if (*p == '/') {
+          ni = std::strtoul(p + 1, &next, 10);
+          p = next;
+        }
+      }
+      if (vi == 0 || vi > m_positions.size())
+        return false;
+      Vertex v;
+      v.Position = m_positions[vi - 1];
+      v.Normal = ni != 0 && ni <= m_normals.size() ? m_normals[ni - 1]
+                                                   : glm::vec3(0, 1, 0);
+      v.TexCoords = ti != 0 && ti <= m_uvs.size() ? m_uvs[ti - 1]
+                                                  : glm::vec2(0, 0);
+      face.push_back(v);
+    }
+    return face.size() >= 3;
+  }
+
+  std::string m_path;
+  bool m_loaded = false;
+  std::vector<glm::vec3> m_positions, m_normals;
+  std::vector<glm::vec2> m_uvs;
+};
+} // namespace
+
+int main(int argc, char **argv) {
+  Options opt;
+  if (!parseOptions(argc, argv, opt)) {
+    std::fprintf(stderr,
+                 "Uso: mesh_chunker [--threads N] [--max-triangles N] "
+                 "[--bucket-triangles N] [--terrain N] [--terrain-size S] "
+                 "[modelo.obj] saida.chunks\n");
+    return -1;
+  }
+  JobSystem jobs(opt.threads);
+
+  ObjSource obj(opt.terrain ? std::string() : opt.paths[0]);
+  TriangleSource source = [&](const TriangleSink &sink) {
+    return opt.terrain ? emitTerrain(opt.terrain, opt.terrainSize, sink)
+                       : obj.read(sink);
+  };
+
+  const std::string &out = opt.paths.back();
+  ChunkBuildStats stats;
+  double buildStart = nowMs();
+  if (!buildChunkFile(out, source, opt.build, stats, &jobs))
+    return -1;
+  double buildMs = nowMs() - buildStart;
+
+  uint64_t fileBytes = 0;
+  if (FILE *file = std::fopen(out.c_str(), "rb")) {
+    std::fseek(file, 0, SEEK_END);
+    fileBytes = (uint64_t)std::ftell(file);
+    std::fclose(file);
+  }
+
+  std::printf("%llu triangles in %u chunks of at most %zu, %u worker "
+              "threads\n",
+              (unsigned long long)stats.triangles, stats.chunks,
+              opt.build.maxTriangles, jobs.threadCount());
+  std::printf("%u buckets, the largest %llu triangles\n", stats.buckets,
+              (unsigned long long)stats.largestBucket);
+  std::printf("%-5s %12s %12s %10s %10s\n", "lod", "triangles", "vertices",
+              "MB", "error");
+  for (uint32_t lod = 0; lod < kChunkLodCount; ++lod) {
+    double mb = (double)(stats.lodVertices[lod] * sizeof(Vertex) +
+                         stats.lodTriangles[lod] * 3 * sizeof(uint32_t)) /
+                (1024.0 * 1024.0);
+    std::printf("%-5u %12llu %12llu %10.2f %10.4f\n", lod,
+                (unsigned long long)stats.lodTriangles[lod],
+                (unsigned long long)stats.lodVertices[lod], mb,
+                stats.lodError[lod]);
+  }
+  std::printf("\n%s : %.2f MB\n", out.c_str(),
+              (double)fileBytes / (1024.0 * 1024.0));
+  std::printf("build : %8.2f ms\n", buildMs);
+  return 0;
+}
@@ -1,4 +1,9 @@
 #include "objloader.hpp"
+#include "job_system.hpp"
+#include "profiler.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
 #include <cstring>
 #include <cstdio>
 #include <string>
@@ -8,6 +13,7 @@ bool loadMTL(
     const char *path,
     std::map<std::string, Material> &out_materials)
 {
+    PROFILE_ZONE("loadMTL");
     FILE *file = fopen(path, "r");
     if (file == NULL)
     {
@@ -16,7 +22,7 @@ bool loadMTL(
     }
 
     std::string currentMaterialName;
-    Material currentMaterial = {{0.2f, 0.2f, 0.2f}, {0.8f, 0.8f, 0.8f}, {0.5f, 0.5f, 0.5f}, 32.0f, 1.0f};
+    Material currentMaterial = {{0.2f, 0.2f, 0.2f}, {0.8f, 0.8f, 0.8f}, {0.5f, 0.5f, 0.5f}, 32.0f, 1.0f, ""};
 
     while (1)
     {
@@ -34,7 +40,7 @@ bool loadMTL(
             char matName[256];
             fscanf(file, "%s\n", matName);
             currentMaterialName = matName;
-            currentMaterial = {{0.2f, 0.2f, 0.2f}, {0.8f, 0.8f, 0.8f}, {0.5f, 0.5f, 0.5f}, 32.0f, 1.0f};
+            currentMaterial = {{0.2f, 0.2f, 0.2f}, {0.8f, 0.8f, 0.8f}, {0.5f, 0.5f, 0.5f}, 32.0f, 1.0f, ""};
         }
         // Ambient color
         else if (strcmp(lineHeader, "Ka") == 0)
@@ -61,7 +67,24 @@ bool loadMTL(
         {
             fscanf(file, "%f\n", &currentMaterial.d);
         }
-        // Ignore other fields (like texture maps)
+        // Textura difusa (caminho relativo ao .mtl, sem opções "-o", "-s"...)
+        else if (strcmp(lineHeader, "map_Kd") == 0)
+        {
+            char mapLine[1024];
+            if (fgets(mapLine, sizeof(mapLine), file))
+            {
+                // o caminho é o último campo da linha
+                std::string value = mapLine;
+                size_t last = value.find_last_not_of(" \t\r\n");
+                if (last != std::string::npos)
+                {
+                    size_t start = value.find_last_of(" \t", last);
+                    start = (start == std::string::npos) ? 0 : start + 1;
+                    currentMaterial.map_Kd = value.substr(start, last - start + 1);
+                }
+            }
+        }
+        // Ignore other fields (like other texture maps)
         else
         {
             char dummy[1024];
@@ -77,130 +100,274 @@ bool loadMTL(
     return true;
 }
 
-// função que lê ficheiro .obj e devolve listas de vértices e normais
-bool loadOBJ(
-    const char *path,
-    std::vector<glm::vec3> &out_vertices,
-    std::vector<glm::vec3> &out_normals)
+// Dados lidos de um bloco de linhas do ficheiro .obj
+struct ObjChunk
 {
-    // listas temporárias (armazenam tudo que for lido)
+    std::vector<glm::vec3> vertices;
+    std::vector<glm::vec2> uvs;
+    std::vector<glm::vec3> normals;
     std::vector<unsigned int> vertexIndices, uvIndices, normalIndices;
-    std::vector<glm::vec3> temp_vertices;
-    std::vector<glm::vec2> temp_uvs;
-    std::vector<glm::vec3> temp_normals;
+    bool ok = true;
+};
 
-    // abrir ficheiro pelo path dado
-    FILE *file = fopen(path, "r");
-    if (file == NULL)
+// Avança sobre espaços e tabs (não sobre o fim de linha)
+static const char *skipSpaces(const char *p, const char *end)
+{
+    while (p < end && (*p == ' ' || *p == '\t'))
+        ++p;
+    return p;
+}
+
+// Lê até 'count' floats separados por espaços
+static void parseFloats(const char *p, const char *end, float *out, int count)
+{
+    for (int i = 0; i < count; ++i)
     {
-        printf("Impossible to open the file ! (%s)\n", path);
-        return false;
+        p = skipSpaces(p, end);
+        char *next = NULL;
+        out[i] = strtof(p, &next);
+        p = next;
     }
+}
 
-    // ler até ao fim do ficheiro
-    while (1)
+// Lê as linhas [begin, end) do ficheiro. Os índices das faces são absolutos
+// (como no resto do loader), por isso cada bloco é independente dos outros.
+static void parseOBJChunk(const char *begin, const char *end, ObjChunk &out)
+{
+    // cantos da face atual, reutilizados de face para face (qualquer número)
+    std::vector<unsigned int> face_v, face_vt, face_vn;
+    const char *p = begin;
+    while (p < end)
     {
-        char lineHeader[256]; // assumir que a palavra nao tem mais de 256 chars
+        const char *lineEnd = (const char *)memchr(p, '\n', end - p);
+        if (!lineEnd)
+            lineEnd = end;
+        const char *q = skipSpaces(p, lineEnd);
 
-        // ler a primeira palavra da linha
-        int res = fscanf(file, "%s", lineHeader);
-        if (res == EOF)
-            break; // EOF = End Of File → sai do loop
-
-        // analisar o que a primeira palavra significa
-        // se for "v", a linha descreve um vértice (x y z)
-        if (strcmp(lineHeader, "v") == 0)
+        // "v x y z": vértice
+        if (lineEnd - q > 2 && q[0] == 'v' && (q[1] == ' ' || q[1] == '\t'))
         {
             glm::vec3 vertex;
-            fscanf(file, "%f %f %f\n", &vertex.x, &vertex.y, &vertex.z);
-            temp_vertices.push_back(vertex);
+            parseFloats(q + 1, lineEnd, &vertex.x, 3);
+            out.vertices.push_back(vertex);
         }
-
-        // se for "vt", descreve coordenadas de textura (u v)
-        else if (strcmp(lineHeader, "vt") == 0)
+        // "vt u v": coordenadas de textura
+        else if (lineEnd - q > 3 && q[0] == 'v' && q[1] == 't')
         {
             glm::vec2 uv;
-            fscanf(file, "%f %f\n", &uv.x, &uv.y);
-            temp_uvs.push_back(uv);
+            parseFloats(q + 2, lineEnd, &uv.x, 2);
+            out.uvs.push_back(uv);
         }
-
-        // se for "vn", descreve uma normal (x y z)
-        else if (strcmp(lineHeader, "vn") == 0)
+        // "vn x y z": normal
+        else if (lineEnd - q > 3 && q[0] == 'v' && q[1] == 'n')
         {
             glm::vec3 normal;
-            fscanf(file, "%f %f %f\n", &normal.x, &normal.y, &normal.z);
-            temp_normals.push_back(normal);
+            parseFloats(q + 2, lineEnd, &normal.x, 3);
+            out.normals.push_back(normal);
         }
-
-        // se for "f", descreve uma face (índices dos vértices/uvs/normais)
-        else if (strcmp(lineHeader, "f") == 0)
+        // "f ...": face (suporta v, v/vt, v//vn, v/vt/vn)
+        else if (lineEnd - q > 2 && q[0] == 'f' && (q[1] == ' ' || q[1] == '\t'))
         {
-            // read the rest of the line into a buffer
-            char line[1024];
-            if (!fgets(line, sizeof(line), file)) break;
-            std::istringstream ss(line);
-            std::string token;
-
-            // collect face indices (support v, v/vt, v//vn, v/vt/vn)
-            std::vector<unsigned int> face_v, face_vt, face_vn;
-            while (ss >> token) {
-                unsigned int vi = 0, ti = 0, ni = 0;
-                if (sscanf(token.c_str(), "%u/%u/%u", &vi, &ti, &ni) == 3) {
-                    face_v.push_back(vi);
-                    face_vt.push_back(ti);
-                    face_vn.push_back(ni);
-                } else if (sscanf(token.c_str(), "%u//%u", &vi, &ni) == 2) {
-                    face_v.push_back(vi);
-                    face_vt.push_back(0);
-                    face_vn.push_back(ni);
-                } else if (sscanf(token.c_str(), "%u/%u", &vi, &ti) == 2) {
-                    face_v.push_back(vi);
-                    face_vt.push_back(ti);
-                    face_vn.push_back(0);
-                } else if (sscanf(token.c_str(), "%u", &vi) == 1) {
-                    face_v.push_back(vi);
-                    face_vt.push_back(0);
-                    face_vn.push_back(0);
+            face_v.clear();
+            face_vt.clear();
+            face_vn.clear();
+            const char *t = skipSpaces(q + 1, lineEnd);
+            while (t < lineEnd)
+            {
+                char *next = NULL;
+                unsigned int vi = (unsigned int)strtoul(t, &next, 10);
+                unsigned int ti = 0, ni = 0;
+                if (next == t)
+                    break; // não é um número (ex.: "\r" no fim da linha)
+                t = next;
+                if (t < lineEnd && *t == '/')
+                {
+                    ++t;
+                    if (t < lineEnd && *t != '/')
+                    {
+                        ti = (unsigned int)strtoul(t, &next, 10);
+                        t = next;
+                    }
+                    if (t < lineEnd && *t == '/')
+                    {
+                        ni = (unsigned int)strtoul(t + 1, &next, 10);
+                        t = next;
+                    }
                 }
+                face_v.push_back(vi);
+                face_vt.push_back(ti);
+                face_vn.push_back(ni);
+                t = skipSpaces(t, lineEnd);
             }
 
-            if (face_v.size() < 3) {
+            size_t corners = face_v.size();
+            if (corners < 3)
+            {
                 // malformed face
-                fclose(file);
-                return false;
+                out.ok = false;
+                return;
             }
 
             // triangulate polygon (fan triangulation)
-            for (size_t i = 1; i + 1 < face_v.size(); ++i) {
-                vertexIndices.push_back(face_v[0]); vertexIndices.push_back(face_v[i]); vertexIndices.push_back(face_v[i+1]);
-                uvIndices.push_back(face_vt[0]); uvIndices.push_back(face_vt[i]); uvIndices.push_back(face_vt[i+1]);
-                normalIndices.push_back(face_vn[0]); normalIndices.push_back(face_vn[i]); normalIndices.push_back(face_vn[i+1]);
+            for (size_t i = 1; i + 1 < corners; ++i)
+            {
+                out.vertexIndices.push_back(face_v[0]); out.vertexIndices.push_back(face_v[i]); out.vertexIndices.push_back(face_v[i+1]);
+                out.uvIndices.push_back(face_vt[0]); out.uvIndices.push_back(face_vt[i]); out.uvIndices.push_back(face_vt[i+1]);
+                out.normalIndices.push_back(face_vn[0]); out.normalIndices.push_back(face_vn[i]); out.normalIndices.push_back(face_vn[i+1]);
             }
         }
+        // comentários (#), mtllib, usemtl, o, g, s: ignorados
+
+        p = lineEnd + 1;
+    }
+}
+
+// função que lê ficheiro .obj e devolve listas de vértices, normais e
+// (se out_uvs não for NULL) coordenadas de textura
+static bool loadOBJCore(
+    const char *path,
+    std::vector<glm::vec3> &out_vertices,
+    std::vector<glm::vec2> *out_uvs,
+    std::vector<glm::vec3> &out_normals,
+    JobSystem *jobs)
+{
+    PROFILE_ZONE("loadOBJ");
+
+    // abrir ficheiro pelo path dado e ler tudo para memória
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        printf("Impossible to open the file ! (%s)\n", path);
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    long fileSize = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    std::vector<char> text(fileSize > 0 ? (size_t)fileSize : 0);
+    size_t bytesRead = text.empty() ? 0 : fread(text.data(), 1, text.size(), file);
+    // fechar ficheiro
+    fclose(file);
+    text.resize(bytesRead);
+
+    // dividir o texto em blocos que acabam no fim de uma linha; com um
+    // JobSystem cada bloco é lido numa thread diferente
+    const size_t kMinChunkBytes = 64 * 1024;
+    size_t chunkCount = 1;
+    if (jobs)
+        chunkCount = std::max<size_t>(1, std::min<size_t>(jobs->threadCount() * 4,
+                                                          text.size() / kMinChunkBytes));
+    std::vector<const char *> bounds(chunkCount + 1);
+    const char *textBegin = text.data();
+    const char *textEnd = text.data() + text.size();
+    bounds[0] = textBegin;
+    for (size_t c = 1; c < chunkCount; ++c)
+    {
+        const char *cut = std::max(bounds[c - 1], textBegin + text.size() * c / chunkCount);
+        const char *newline = (const char *)memchr(cut, '\n', textEnd - cut);
+        bounds[c] = newline ? newline + 1 : textEnd;
+    }
+    bounds[chunkCount] = textEnd;
+
+    std::vector<ObjChunk> chunks(chunkCount);
+    {
+        PROFILE_ZONE("loadOBJ::parse");
+        if (jobs)
+            jobs->parallelFor(chunkCount, 1, [&](size_t begin, size_t end) {
+                for (size_t c = begin; c < end; ++c)
+                    parseOBJChunk(bounds[c], bounds[c + 1], chunks[c]);
+            });
+        else
+            parseOBJChunk(bounds[0], bounds[1], chunks[0]);
+    }
+
+    // juntar os blocos pela ordem do ficheiro
+    std::vector<unsigned int> vertexIndices, uvIndices, normalIndices;
+    std::vector<glm::vec3> temp_vertices;
+    std::vector<glm::vec2> temp_uvs;
+    std::vector<glm::vec3> temp_normals;
+    for (ObjChunk &chunk : chunks)
+    {
+        if (!chunk.ok)
+            return false;
+        temp_vertices.insert(temp_vertices.end(), chunk.vertices.begin(), chunk.vertices.end());
+        temp_normals.insert(temp_normals.end(), chunk.normals.begin(), chunk.normals.end());
+        vertexIndices.insert(vertexIndices.end(), chunk.vertexIndices.begin(), chunk.vertexIndices.end());
+        if (out_uvs)
+        {
+            temp_uvs.insert(temp_uvs.end(), chunk.uvs.begin(), chunk.uvs.end());
+            uvIndices.insert(uvIndices.end(), chunk.uvIndices.begin(), chunk.uvIndices.end());
+        }
+        normalIndices.insert(normalIndices.end(), chunk.normalIndices.begin(), chunk.normalIndices.end());
     }
 
     // até agora → só tínhamos listas de índices e dados separados
     // agora vamos juntar tudo numa forma que o OpenGL consiga usar diretamente
 
     // para cada vértice de cada triângulo (linhas "f")
-    for (unsigned int i = 0; i < vertexIndices.size(); i++)
-    {
-        unsigned int vertexIndex = vertexIndices[i];
-        glm::vec3 vertex = temp_vertices[vertexIndex - 1]; // -1 porque .obj começa em 1
-        out_vertices.push_back(vertex);
-
-        unsigned int normalIndex = normalIndices[i];
-        if (normalIndex != 0 && normalIndex <= temp_normals.size()) {
-            glm::vec3 normal = temp_normals[normalIndex - 1];
-            out_normals.push_back(normal);
-        } else {
-            out_normals.push_back(glm::vec3(0, 1, 0)); // Default normal
+    PROFILE_ZONE("loadOBJ::assemble");
+    const size_t first = out_vertices.size();
+    out_vertices.resize(first + vertexIndices.size());
+    out_normals.resize(first + vertexIndices.size());
+    if (out_uvs)
+        out_uvs->resize(first + vertexIndices.size());
+    std::atomic<bool> badIndex(false);
+    auto assemble = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+        {
+            unsigned int vertexIndex = vertexIndices[i];
+            if (vertexIndex == 0 || vertexIndex > temp_vertices.size())
+            {
+                badIndex.store(true, std::memory_order_relaxed);
+                continue;
+            }
+            out_vertices[first + i] = temp_vertices[vertexIndex - 1]; // -1 porque .obj começa em 1
+
+            unsigned int normalIndex = normalIndices[i];
+            if (normalIndex != 0 && normalIndex <= temp_normals.size())
+                out_normals[first + i] = temp_normals[normalIndex - 1];
+            else
+                out_normals[first + i] = glm::vec3(0, 1, 0); // Default normal
+
+            if (out_uvs)
+            {
+                unsigned int uvIndex = uvIndices[i];
+                if (uvIndex != 0 && uvIndex <= temp_uvs.size())
+                    (*out_uvs)[first + i] = temp_uvs[uvIndex - 1];
+                else
+                    (*out_uvs)[first + i] = glm::vec2(0, 0); // Sem "vt"
+            }
         }
-    }
+    };
+    if (jobs)
+        jobs->parallelFor(vertexIndices.size(), 16384, assemble);
+    else
+        assemble(0, vertexIndices.size());
 
-    // fechar ficheiro
-    fclose(file);
+    if (badIndex.load())
+    {
+        printf("Invalid vertex index in %s\n", path);
+        return false;
+    }
 
     // sucesso
     return true;
 }
+
+bool loadOBJ(
+    const char *path,
+    std::vector<glm::vec3> &out_vertices,
+    std::vector<glm::vec3> &out_normals,
+    JobSystem *jobs)
+{
+    return loadOBJCore(path, out_vertices, NULL, out_normals, jobs);
+}
+
+bool loadOBJ(
+    const char *path,
+    std::vector<glm::vec3> &out_vertices,
+    std::vector<glm::vec2> &out_uvs,
+    std::vector<glm::vec3> &out_normals,
+    JobSystem *jobs)
+{
+    return loadOBJCore(path, out_vertices, &out_uvs, out_normals, jobs);
+}
@@ -0,0 +1,184 @@
+#include "occlusion_culling.hpp"
+#include "profiler.hpp"
+#include <algorithm>
+#include <cmath>
+
+void DepthPyramid::build(const float *depth, int width, int height,
+                         const glm::mat4 &viewProj) {
+  PROFILE_ZONE("DepthPyramid::build");
+  m_viewProj = viewProj;
+  m_sourceWidth = width;
+  m_sourceHeight = height;
+  m_factor = std::max(1, (std::max(width, height) + kBaseSize - 1) /
+                             kBaseSize);
+
+  // Level 0: farthest depth of each factor x factor block of pixels
+  int levelWidth = (width + m_factor - 1) / m_factor;
+  int levelHeight = (height + m_factor - 1) / m_factor;
+  size_t levelCount = 1;
+  for (int size = std::max(levelWidth, levelHeight); size > 1;
+       size = (size + 1) / 2)
+    levelCount++;
+  m_levels.resize(levelCount);
+
+  Level &base = m_levels[0];
+  base.width = levelWidth;
+  base.height = levelHeight;
+  base.maxDepth.assign((size_t)levelWidth * levelHeight, 0.0f);
+  for (int y = 0; y < height; ++y) {
+    const float *row = depth + (size_t)y * width;
+    float *out = &base.maxDepth[(size_t)(y / m_factor) * levelWidth];
+    for (int x = 0; x < width; ++x)
+      out[x / m_factor] = std::max(out[x / m_factor], row[x]);
+  }
+
+  // Each next level: farthest of the (up to) 2x2 texels below it
+  for (size_t l = 1; l < levelCount; ++l) {
+    const Level &src = m_levels[l - 1];
+    Level &dst = m_levels[l];
+    dst.width = (src.width + 1) / 2;
+    dst.height = (src.height + 1) / 2;
+    dst.maxDepth.resize((size_t)dst.width * dst.height);
+    for (int y = 0; y < dst.height; ++y) {
+      int y0 = 2 * y, y1 = std::min(2 * y + 1, src.height - 1);
+      for (int x = 0; x < dst.width; ++x) {
+        int x0 = 2 * x, x1 = std::min(2 * x + 1, src.width - 1);
+        const float *r0 = &src.maxDepth[(size_t)y0 * src.width];
+        const float *r1 = &src.maxDepth[(size_t)y1 * src.width];
+        dst.maxDepth[(size_t)y * dst.width + x] =
+            std::max(std::max(r0[x0], r0[x1]), std::max(r1[x0], r1[x1]));
+      }
+    }
+  }
+}
+
+bool DepthPyramid::sphereOccluded(const glm::vec4 &sphere) const {
+  if (m_levels.empty())
+    return false;
+
+  // Screen rectangle and nearest depth of the sphere's bounding box
+  glm::vec3 center(sphere), extent(sphere.w);
+  float minX = 1.0f, minY = 1.0f, maxX = -1.0f, maxY = -1.0f;
+  float nearest = 1.0f;
+  for (int corner = 0; corner < 8; ++corner) {
+    glm::vec3 p = center + glm::vec3(corner & 1 ? extent.x : -extent.x,
+                                     corner & 2 ? extent.y : -extent.y,
+                                     corner & 4 ? extent.z : -extent.z);
+    glm::vec4 clip = m_viewProj * glm::vec4(p, 1.0f);
+    if (clip.w <= 1e-5f)
+      return false; // Crosses the camera plane: treat as visible
+    glm::vec3 ndc = glm::vec3(clip) / clip.w;
+    minX = std::min(minX, ndc.x);
+    maxX = std::max(maxX, ndc.x);
+    minY = std::min(minY, ndc.y);
+    maxY = std::max(maxY, ndc.y);
+    nearest = std::min(nearest, ndc.z * 0.5f + 0.5f);
+  }
+  if (maxX < -1.0f || minX > 1.0f || maxY < -1.0f || minY > 1.0f)
+    return false; // Off the captured view; frustum culling decides
+  if (nearest <= 0.0f)
+    return false;
+
+  // Covered level-0 texels
+  const Level &base = m_levels[0];
+  auto texelX = [&](float ndc) {
+    float px = (std::min(std::max(ndc, -1.0f), 1.0f) * 0.5f + 0.5f) *
+               (float)m_sourceWidth;
+    return std::min((int)px / m_factor, base.width - 1);
+  };
+  auto texelY = [&](float ndc) {
+    float py = (std::min(std::max(ndc, -1.0f), 1.0f) * 0.5f + 0.5f) *
+               (float)m_sourceHeight;
+    return std::min((int)py / m_factor, base.height - 1);
+  };
+  int x0 = texelX(minX), x1 = texelX(maxX);
+  int y0 = texelY(minY), y1 = texelY(maxY);
+
+  // Coarsest level where the rectangle spans at most 4x4 texels (2x2 would
+  // be cheaper, but one far texel straddling the edge then hides nothing)
+  size_t level = 0;
+  while (level + 1 < m_levels.size() &&
+         ((x1 >> level) - (x0 >> level) > 3 ||
+          (y1 >> level) - (y0 >> level) > 3))
+    level++;
+
+  const Level &l = m_levels[level];
+  for (int y = y0 >> level; y <= (y1 >> level); ++y)
+    for (int x = x0 >> level; x <= (x1 >> level); ++x)
+      if (l.maxDepth[(size_t)y * l.width + x] >= nearest)
+        return false;
+  return true;
+}
+
+DepthReadback::DepthReadback() {
+  for (Slot &slot : m_slots)
+    glGenBuffers(1, &slot.buffer);
+}
+
+DepthReadback::~DepthReadback() {
+  for (Slot &slot : m_slots) {
+    if (slot.fence)
+      glDeleteSync(slot.fence);
+    glDeleteBuffers(1, &slot.buffer);
+  }
+}
+
+void DepthReadback::capture(int width, int height, const glm::mat4 &viewProj,
+                            uint64_t frame) {
+  PROFILE_ZONE("DepthReadback::capture");
+  Slot &slot = m_slots[m_next];
+  if (slot.fence) {
+    // GPU more than kSlots frames behind: drop the oldest capture
+    glDeleteSync(slot.fence);
+    slot.fence = 0;
+  }
+
+  const size_t bytes = (size_t)width * height * sizeof(float);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+  if (bytes > slot.capacity) {
+    glBufferData(GL_PIXEL_PACK_BUFFER, bytes, NULL, GL_STREAM_READ);
+    slot.capacity = bytes;
+  }
+  glReadPixels(0, 0, width, height, GL_DEPTH_COMPONENT, GL_FLOAT, 0);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  slot.width = width;
+  slot.height = height;
+  slot.viewProj = viewProj;
+  slot.frame = frame;
+  m_next = (m_next + 1) % kSlots;
+}
+
+bool DepthReadback::collect(DepthPyramid &out) {
+  // Oldest to newest; captures finish in order, and only the newest
+  // finished one is worth building
+  int ready = -1;
+  for (int i = 0; i < kSlots; ++i) {
+    Slot &slot = m_slots[(m_next + i) % kSlots];
+    if (!slot.fence)
+      continue;
+    GLenum status = glClientWaitSync(slot.fence, 0, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+      break;
+    glDeleteSync(slot.fence);
+    slot.fence = 0;
+    ready = (m_next + i) % kSlots;
+  }
+  if (ready < 0)
+    return false;
+
+  Slot &slot = m_slots[ready];
+  const size_t bytes = (size_t)slot.width * slot.height * sizeof(float);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+  const float *depth = (const float *)glMapBufferRange(
+      GL_PIXEL_PACK_BUFFER, 0, bytes, GL_MAP_READ_BIT);
+  bool ok = depth != nullptr;
+  if (ok) {
+    out.build(depth, slot.width, slot.height, slot.viewProj);
+    out.setFrame(slot.frame);
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  return ok;
+}
@@ -0,0 +1,106 @@
+#include "oit.hpp"
+#include "profiler.hpp"
+#include "render_stats.hpp"
+#include <algorithm>
+#include <cstdio>
+
+WeightedBlendedOit::WeightedBlendedOit() {
+  glGenFramebuffers(1, &m_fbo);
+  glGenTextures(1, &m_accum);
+  glGenTextures(1, &m_revealage);
+  glGenRenderbuffers(1, &m_depth);
+  glGenVertexArrays(1, &m_emptyVao);
+}
+
+WeightedBlendedOit::~WeightedBlendedOit() {
+  glDeleteFramebuffers(1, &m_fbo);
+  glDeleteTextures(1, &m_accum);
+  glDeleteTextures(1, &m_revealage);
+  glDeleteRenderbuffers(1, &m_depth);
+  glDeleteVertexArrays(1, &m_emptyVao);
+}
+
+void WeightedBlendedOit::allocate(int width, int height) {
+  m_storageWidth = width;
+  m_storageHeight = height;
+  const GLuint textures[2] = {m_accum, m_revealage};
+  const GLint formats[2] = {GL_RGBA16F, GL_R8};
+  const GLenum layouts[2] = {GL_RGBA, GL_RED};
+  for (int i = 0; i < 2; ++i) {
+    glBindTexture(GL_TEXTURE_2D, textures[i]);
+    glTexImage2D(GL_TEXTURE_2D, 0, formats[i], width, height, 0, layouts[i],
+                 GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+  }
+  glBindTexture(GL_TEXTURE_2D, 0);
+  // Same format as the scene targets, which glBlitFramebuffer requires
+  glBindRenderbuffer(GL_RENDERBUFFER, m_depth);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                         m_accum, 0);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D,
+                         m_revealage, 0);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+                            GL_RENDERBUFFER, m_depth);
+  const GLenum drawBuffers[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+  glDrawBuffers(2, drawBuffers);
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    std::fprintf(stderr, "[oit] framebuffer incomplete\n");
+}
+
+void WeightedBlendedOit::begin(int width, int height) {
+  PROFILE_FUNCTION();
+  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &m_previousFbo);
+  if (width > m_storageWidth || height > m_storageHeight)
+    allocate(std::max(width, m_storageWidth),
+             std::max(height, m_storageHeight));
+
+  // Opaque depth, so transparent surfaces behind the scene are rejected
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, (GLuint)m_previousFbo);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_fbo);
+  glBlitFramebuffer(0, 0, width, height, 0, 0, width, height,
+                    GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+  glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+
+  const GLfloat zero[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+  const GLfloat one[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+  glClearBufferfv(GL_COLOR, 0, zero);
+  glClearBufferfv(GL_COLOR, 1, one);
+
+  // Accumulation adds up; revealage multiplies by (1 - alpha)
+  glEnable(GL_BLEND);
+  glBlendFunci(0, GL_ONE, GL_ONE);
+  glBlendFunci(1, GL_ZERO, GL_ONE_MINUS_SRC_COLOR);
+  glDepthMask(GL_FALSE);
+}
+
+void WeightedBlendedOit::resolve(GLuint compositeProgram) {
+  PROFILE_FUNCTION();
+  glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)m_previousFbo);
+  glActiveTexture(GL_TEXTURE0 + kAccumUnit);
+  glBindTexture(GL_TEXTURE_2D, m_accum);
+  glActiveTexture(GL_TEXTURE0 + kRevealageUnit);
+  glBindTexture(GL_TEXTURE_2D, m_revealage);
+  glActiveTexture(GL_TEXTURE0);
+
+  glBlendFunc(GL_ONE_MINUS_SRC_ALPHA, GL_SRC_ALPHA);
+  glDisable(GL_DEPTH_TEST);
+  countedUseProgram(compositeProgram);
+  countedBindVertexArray(m_emptyVao);
+  countedDrawArrays(GL_TRIANGLES, 0, 3);
+  glEnable(GL_DEPTH_TEST);
+  glDisable(GL_BLEND);
+  glDepthMask(GL_TRUE);
+}
+
+void WeightedBlendedOit::setupProgram(GLuint program) {
+  glUseProgram(program);
+  glUniform1i(glGetUniformLocation(program, "Accum"), kAccumUnit);
+  glUniform1i(glGetUniformLocation(program, "Revealage"), kRevealageUnit);
+  glUseProgram(0);
+}
@@ -0,0 +1,132 @@
+#include "profiler.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+std::atomic<bool> Profiler::s_enabled{false};
+
+namespace {
+
+// Ring buffer owned by one thread. Only the owner writes; the exporter reads
+// `head` with acquire ordering to know how many slots are valid.
+struct ThreadBuffer {
+  std::vector<ProfileEvent> events;
+  std::atomic<uint64_t> head{0};
+  uint32_t tid = 0;
+  std::string name;
+
+  ThreadBuffer() : events(Profiler::kRingCapacity) {}
+};
+
+// Buffers are kept alive after their thread exits so that its events still
+// appear in the trace. Registration is the only place that locks.
+std::mutex g_registryMutex;
+std::vector<std::shared_ptr<ThreadBuffer>> g_registry;
+
+thread_local ThreadBuffer *t_buffer = nullptr;
+
+ThreadBuffer &threadBuffer() {
+  if (!t_buffer) {
+    auto buffer = std::make_shared<ThreadBuffer>();
+    std::lock_guard<std::mutex> lock(g_registryMutex);
+    buffer->tid = (uint32_t)g_registry.size() + 1;
+    buffer->name = "thread " + std::to_string(buffer->tid);
+    g_registry.push_back(buffer);
+    t_buffer = buffer.get();
+  }
+  return *t_buffer;
+}
+
+// Zone names are literals, but escape anyway so the JSON is always valid
+void writeJsonString(FILE *file, const char *s) {
+  std::fputc('"', file);
+  for (; *s; ++s) {
+    if (*s == '"' || *s == '\\')
+      std::fputc('\\', file);
+    if ((unsigned char)*s >= 0x20)
+      std::fputc(*s, file);
+  }
+  std::fputc('"', file);
+}
+
+} // namespace
+
+uint64_t Profiler::nowNs() {
+  using namespace std::chrono;
+  return (uint64_t)duration_cast<nanoseconds>(
+             steady_clock::now().time_since_epoch())
+             .count() +
+         1;
+}
+
+void Profiler::record(const char *name, uint64_t startNs, uint64_t endNs) {
+  ThreadBuffer &buffer = threadBuffer();
+  uint64_t head = buffer.head.load(std::memory_order_relaxed);
+  buffer.events[head & (kRingCapacity - 1)] = {name, startNs, endNs - startNs};
+  buffer.head.store(head + 1, std::memory_order_release);
+}
+
+void Profiler::setThreadName(const char *name) {
+  ThreadBuffer &buffer = threadBuffer();
+  std::lock_guard<std::mutex> lock(g_registryMutex);
+  buffer.name = name;
+}
+
+void Profiler::clear() {
+  std::lock_guard<std::mutex> lock(g_registryMutex);
+  for (auto &buffer : g_registry)
+    buffer->head.store(0, std::memory_order_release);
+}
+
+bool Profiler::writeChromeTrace(const char *path) {
+  FILE *file = std::fopen(path, "w");
+  if (file == NULL) {
+    std::fprintf(stderr, "[profiler] could not open %s\n", path);
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(g_registryMutex);
+
+  // Timestamps are printed relative to the earliest recorded event
+  uint64_t originNs = UINT64_MAX;
+  for (auto &buffer : g_registry) {
+    uint64_t head = buffer->head.load(std::memory_order_acquire);
+    uint64_t count = std::min<uint64_t>(head, kRingCapacity);
+    for (uint64_t i = head - count; i < head; ++i)
+      originNs = std::min(originNs,
+                          buffer->events[i & (kRingCapacity - 1)].startNs);
+  }
+  if (originNs == UINT64_MAX)
+    originNs = 0;
+
+  size_t written = 0;
+  std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  for (auto &buffer : g_registry) {
+    std::fprintf(file, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,"
+                       "\"tid\":%u,\"args\":{\"name\":",
+                 written++ ? ",\n" : "", buffer->tid);
+    writeJsonString(file, buffer->name.c_str());
+    std::fprintf(file, "}}");
+
+    uint64_t head = buffer->head.load(std::memory_order_acquire);
+    uint64_t count = std::min<uint64_t>(head, kRingCapacity);
+    for (uint64_t i = head - count; i < head; ++i) {
+      const ProfileEvent &ev = buffer->events[i & (kRingCapacity - 1)];
+      std::fprintf(file, ",\n{\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"name\":",
+                   buffer->tid);
+      writeJsonString(file, ev.name);
+      std::fprintf(file, ",\"ts\":%.3f,\"dur\":%.3f}",
+                   (double)(ev.startNs - originNs) / 1000.0,
+                   (double)ev.durationNs / 1000.0);
+    }
+  }
+  std::fprintf(file, "\n]}\n");
+  std::fclose(file);
+
+  std::printf("[profiler] trace written to %s\n", path);
+  return true;
+}
@@ -0,0 +1,101 @@
+#include "render_queue.hpp"
+#include "profiler.hpp"
+#include "render_stats.hpp"
+#include <algorithm>
+#include <cstring>
+
+uint64_t RenderQueue::makeKey(uint32_t pass, GLuint program, uint32_t material,
+                              GLuint vao, float depth01) {
+  depth01 = std::min(std::max(depth01, 0.0f), 1.0f);
+  uint64_t depth = (uint64_t)(depth01 * (float)0xFFFFFF);
+  return ((uint64_t)(pass & 0xF) << 60) | ((uint64_t)(program & 0xFFF) << 48) |
+         ((uint64_t)(material & 0xFFF) << 36) |
+         ((uint64_t)(vao & 0xFFF) << 24) | depth;
+}
+
+void RenderQueue::submit(uint32_t pass, const DrawData &draw, float depth01) {
+  if (pass == PASS_TRANSPARENT)
+    depth01 = 1.0f - depth01;
+  m_packets.push_back({makeKey(pass, draw.program, draw.material, draw.vao,
+                               depth01),
+                       (uint32_t)m_draws.size()});
+  m_draws.push_back(draw);
+}
+
+void RenderQueue::sort() {
+  PROFILE_ZONE("RenderQueue::sort");
+  const size_t n = m_packets.size();
+  if (n < 2)
+    return;
+  m_scratch.resize(n);
+
+  DrawPacket *src = m_packets.data();
+  DrawPacket *dst = m_scratch.data();
+  for (int shift = 0; shift < 64; shift += 8) {
+    size_t counts[256] = {};
+    for (size_t i = 0; i < n; ++i)
+      counts[(src[i].key >> shift) & 0xFF]++;
+    // Every key has the same digit: this pass would not move anything
+    if (counts[(src[0].key >> shift) & 0xFF] == n)
+      continue;
+
+    size_t offset = 0;
+    for (size_t &c : counts) {
+      size_t count = c;
+      c = offset;
+      offset += count;
+    }
+    for (size_t i = 0; i < n; ++i)
+      dst[counts[(src[i].key >> shift) & 0xFF]++] = src[i];
+    std::swap(src, dst);
+  }
+
+  // Odd number of executed passes: result lives in the scratch buffer
+  if (src != m_packets.data())
+    std::memcpy(m_packets.data(), src, n * sizeof(DrawPacket));
+}
+
+void RenderQueue::execute(const Hooks &hooks) const {
+  PROFILE_ZONE("RenderQueue::execute");
+  GLuint program = 0, vao = 0;
+  uint32_t material = UINT32_MAX;
+  uint32_t pass = UINT32_MAX;
+
+  for (const DrawPacket &packet : m_packets) {
+    const DrawData &draw = m_draws[packet.draw];
+    if ((uint32_t)(packet.key >> 60) != pass) {
+      pass = (uint32_t)(packet.key >> 60);
+      if (hooks.onPass) {
+        hooks.onPass(pass);
+        // Whatever the hook bound is unknown here
+        program = 0;
+        vao = 0;
+        material = UINT32_MAX;
+      }
+    }
+    if (draw.program != program) {
+      program = draw.program;
+      material = UINT32_MAX; // Material uniforms belong to the program
+      countedUseProgram(program);
+      if (hooks.onProgram)
+        hooks.onProgram(program);
+    }
+    if (draw.material != material) {
+      material = draw.material;
+      if (hooks.onMaterial)
+        hooks.onMaterial(program, material);
+    }
+    if (draw.vao != vao) {
+      vao = draw.vao;
+      countedBindVertexArray(vao);
+    }
+    if (hooks.onDraw)
+      hooks.onDraw(program, draw);
+
+    if (draw.indexed)
+      countedDrawElements(GL_TRIANGLES, draw.count, GL_UNSIGNED_INT, 0);
+    else
+      countedDrawArrays(GL_TRIANGLES, draw.first, draw.count);
+  }
+  countedBindVertexArray(0);
+}
@@ -0,0 +1,45 @@
+#include "render_stats.hpp"
+#include <cstdio>
+
+namespace {
+RenderStats g_current;
+RenderStats g_lastFrame;
+} // namespace
+
+RenderStats &renderStats() { return g_current; }
+
+const RenderStats &lastFrameStats() { return g_lastFrame; }
+
+void endFrameStats() {
+  g_lastFrame = g_current;
+  g_current = RenderStats();
+}
+
+std::vector<std::string> formatRenderStats(const RenderStats &stats) {
+  char line[64];
+  std::vector<std::string> lines;
+  std::snprintf(line, sizeof line, "DRAWS %u", stats.drawCalls);
+  lines.push_back(line);
+  std::snprintf(line, sizeof line, "TRIS %llu",
+                (unsigned long long)stats.triangles);
+  lines.push_back(line);
+  std::snprintf(line, sizeof line, "VERTS %llu",
+                (unsigned long long)stats.vertices);
+  lines.push_back(line);
+  std::snprintf(line, sizeof line, "PROGRAMS %u", stats.programBinds);
+  lines.push_back(line);
+  std::snprintf(line, sizeof line, "VAOS %u", stats.vaoBinds);
+  lines.push_back(line);
+  std::snprintf(line, sizeof line, "UNIFORMS %u", stats.uniformUploads);
+  lines.push_back(line);
+  std::snprintf(line, sizeof line, "UPLOAD %.1f KB",
+                (double)stats.bufferBytesUploaded / 1024.0);
+  lines.push_back(line);
+  std::snprintf(line, sizeof line, "STALLS %u", stats.streamStalls);
+  lines.push_back(line);
+  std::snprintf(line, sizeof line, "VISIBLE %u CULLED %u OCCLUDED %u",
+                stats.objectsVisible, stats.objectsCulled,
+                stats.objectsOccluded);
+  lines.push_back(line);
+  return lines;
+}
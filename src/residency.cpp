@@ -0,0 +1,78 @@
+#include "residency.hpp"
+#include "profiler.hpp"
+#include <cstdio>
+
+ResidencyManager::ResidencyManager(uint64_t budgetBytes)
+    : m_budget(budgetBytes) {}
+
+int ResidencyManager::add(const std::string &name, LoadFn load,
+                          UnloadFn unload, size_t residentBytes) {
+  Resource resource;
+  resource.name = name;
+  resource.load = load;
+  resource.unload = unload;
+  resource.bytes = residentBytes;
+  resource.resident = residentBytes > 0;
+  resource.lastUsed = m_frame;
+  m_residentBytes += residentBytes;
+  m_resources.push_back(resource);
+  return (int)m_resources.size() - 1;
+}
+
+bool ResidencyManager::use(int id) {
+  Resource &resource = m_resources[id];
+  resource.lastUsed = m_frame;
+  if (resource.resident)
+    return true;
+  if (resource.failed)
+    return false;
+
+  PROFILE_ZONE("residency load");
+  // Make room with the size it had last time (unknown on a first load)
+  evictFor(resource.bytes);
+  size_t bytes = resource.load();
+  if (bytes == 0) {
+    std::fprintf(stderr, "[residency] cannot load %s\n",
+                 resource.name.c_str());
+    resource.failed = true;
+    return false;
+  }
+  resource.bytes = bytes;
+  resource.resident = true;
+  m_residentBytes += bytes;
+  m_current.loads++;
+  m_current.loadedBytes += bytes;
+  return true;
+}
+
+void ResidencyManager::evictFor(uint64_t incoming) {
+  if (m_budget == 0)
+    return;
+  while (m_residentBytes + incoming > m_budget) {
+    // Linear scan: there are a handful of resources, not thousands
+    Resource *oldest = nullptr;
+    for (Resource &resource : m_resources)
+      if (resource.resident && resource.lastUsed < m_frame &&
+          (!oldest || resource.lastUsed < oldest->lastUsed))
+        oldest = &resource;
+    if (!oldest)
+      return; // Everything left is in use this frame
+    oldest->unload();
+    oldest->resident = false;
+    m_residentBytes -= oldest->bytes;
+    m_current.evictions++;
+    m_current.evictedBytes += oldest->bytes;
+  }
+}
+
+void ResidencyManager::endFrame() {
+  evictFor(0);
+  m_current.budgetBytes = m_budget;
+  m_current.residentBytes = m_residentBytes;
+  m_current.total = (uint32_t)m_resources.size();
+  for (const Resource &resource : m_resources)
+    m_current.resident += resource.resident ? 1 : 0;
+  m_lastFrame = m_current;
+  m_current = ResidencyStats();
+  ++m_frame;
+}
@@ -0,0 +1,247 @@
+#include "scene_graph.hpp"
+#include "profiler.hpp"
+#include "job_system.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+
+namespace {
+// Below this many nodes a single linear pass beats waking the workers
+const size_t kParallelMinNodes = 4096;
+} // namespace
+
+NodeId SceneGraph::createNode(NodeId parent) {
+  NodeId node = (NodeId)m_links.size();
+  m_links.push_back(Links());
+  if (parent != kInvalidNode)
+    link(node, parent);
+
+  // Appended at the end; sortNodes() moves it into place
+  uint32_t index = (uint32_t)m_transforms.size();
+  m_transforms.push_back(Transform());
+  m_parentIndex.push_back(kInvalidNode);
+  m_subtreeEnd.push_back(index + 1);
+  m_dirtyBelow.push_back(1);
+  m_worldChanged.push_back(0);
+  m_index.push_back(index);
+  m_needsSort = true;
+  return node;
+}
+
+void SceneGraph::link(NodeId node, NodeId parent) {
+  m_links[node].parent = parent;
+  m_links[node].nextSibling = m_links[parent].firstChild;
+  m_links[parent].firstChild = node;
+}
+
+void SceneGraph::unlink(NodeId node) {
+  NodeId parent = m_links[node].parent;
+  if (parent == kInvalidNode)
+    return;
+  NodeId *slot = &m_links[parent].firstChild;
+  while (*slot != node)
+    slot = &m_links[*slot].nextSibling;
+  *slot = m_links[node].nextSibling;
+  m_links[node].parent = kInvalidNode;
+  m_links[node].nextSibling = kInvalidNode;
+}
+
+void SceneGraph::setParent(NodeId node, NodeId parent) {
+  // A node cannot become a descendant of itself
+  for (NodeId p = parent; p != kInvalidNode; p = m_links[p].parent) {
+    if (p == node) {
+      std::fprintf(stderr, "[scene] setParent(%u, %u) would create a cycle\n",
+                   node, parent);
+      return;
+    }
+  }
+  unlink(node);
+  if (parent != kInvalidNode)
+    link(node, parent);
+  m_needsSort = true;
+}
+
+void SceneGraph::markDirty(uint32_t index) {
+  // Before a re-sort the parent indices are stale, but the next update
+  // recomputes everything anyway
+  if (m_needsSort)
+    return;
+  // Ancestors of a flagged node are always flagged, so stop at the first one
+  while (index != kInvalidNode && !m_dirtyBelow[index]) {
+    m_dirtyBelow[index] = 1;
+    index = m_parentIndex[index];
+  }
+}
+
+void SceneGraph::setLocalPosition(NodeId node, const glm::vec3 &position) {
+  m_transforms[m_index[node]].setLocalPosition(position);
+  markDirty(m_index[node]);
+}
+
+void SceneGraph::setLocalRotation(NodeId node, const glm::vec3 &eulerDegrees) {
+  m_transforms[m_index[node]].setLocalRotation(eulerDegrees);
+  markDirty(m_index[node]);
+}
+
+void SceneGraph::setLocalScale(NodeId node, const glm::vec3 &scale) {
+  m_transforms[m_index[node]].setLocalScale(scale);
+  markDirty(m_index[node]);
+}
+
+void SceneGraph::sortNodes() {
+  PROFILE_ZONE("SceneGraph::sortNodes");
+  const size_t count = m_links.size();
+
+  // Depth-first walk from every root
+  std::vector<NodeId> order;
+  order.reserve(count);
+  std::vector<NodeId> stack;
+  for (NodeId root = (NodeId)count; root-- > 0;)
+    if (m_links[root].parent == kInvalidNode)
+      stack.push_back(root);
+  while (!stack.empty()) {
+    NodeId node = stack.back();
+    stack.pop_back();
+    order.push_back(node);
+    for (NodeId c = m_links[node].firstChild; c != kInvalidNode;
+         c = m_links[c].nextSibling)
+      stack.push_back(c);
+  }
+
+  std::vector<Transform> transforms;
+  transforms.reserve(count);
+  for (NodeId node : order)
+    transforms.push_back(m_transforms[m_index[node]]);
+  m_transforms.swap(transforms);
+
+  for (uint32_t i = 0; i < count; ++i) {
+    m_index[order[i]] = i;
+    m_subtreeEnd[i] = i + 1;
+  }
+  for (uint32_t i = 0; i < count; ++i) {
+    NodeId parent = m_links[order[i]].parent;
+    m_parentIndex[i] = parent == kInvalidNode ? kInvalidNode : m_index[parent];
+  }
+  // Children come after their parent, so walking backwards finishes every
+  // subtree before it is folded into the parent's range
+  for (uint32_t i = (uint32_t)count; i-- > 0;) {
+    uint32_t parent = m_parentIndex[i];
+    if (parent != kInvalidNode)
+      m_subtreeEnd[parent] = std::max(m_subtreeEnd[parent], m_subtreeEnd[i]);
+  }
+
+  std::fill(m_dirtyBelow.begin(), m_dirtyBelow.end(), 1);
+  m_updateAll = true;
+  m_needsSort = false;
+}
+
+bool SceneGraph::updateNode(uint32_t index) {
+  Transform &transform = m_transforms[index];
+  uint32_t parent = m_parentIndex[index];
+  bool parentMoved = parent != kInvalidNode && m_worldChanged[parent];
+  if (!m_updateAll && !parentMoved && !transform.isDirty()) {
+    m_worldChanged[index] = 0;
+    return false;
+  }
+  if (parent != kInvalidNode)
+    transform.computeModelMatrix(m_transforms[parent].getModelMatrix());
+  else if (transform.isDirty())
+    transform.computeModelMatrix();
+  else // Root that was re-parented: drop the old parent's matrix
+    transform.computeModelMatrix(glm::mat4(1.0f));
+  m_worldChanged[index] = 1;
+  return true;
+}
+
+bool SceneGraph::isFlatRoot(uint32_t index) const {
+  return m_parentIndex[index] == kInvalidNode &&
+         m_subtreeEnd[index] == index + 1;
+}
+
+void SceneGraph::updateRange(uint32_t begin, uint32_t end, size_t &updated) {
+  for (uint32_t i = begin; i < end;) {
+    if (!m_updateAll && isFlatRoot(i)) {
+      // A run of roots without children depends on nothing else, so its
+      // dirty transforms go through the batch update together
+      uint32_t runEnd = i + 1;
+      while (runEnd < end && isFlatRoot(runEnd))
+        ++runEnd;
+      for (uint32_t n = i; n < runEnd; ++n) {
+        m_worldChanged[n] = m_transforms[n].isDirty() ? 1 : 0;
+        updated += m_worldChanged[n];
+        m_dirtyBelow[n] = 0;
+      }
+      Transform::computeModelMatrices(&m_transforms[i], runEnd - i);
+      i = runEnd;
+      continue;
+    }
+    uint32_t parent = m_parentIndex[i];
+    bool parentMoved = parent != kInvalidNode && m_worldChanged[parent];
+    if (!m_dirtyBelow[i] && !parentMoved) {
+      // Nothing in this subtree moved
+      m_worldChanged[i] = 0;
+      i = m_subtreeEnd[i];
+      continue;
+    }
+    if (updateNode(i))
+      updated++;
+    m_dirtyBelow[i] = 0;
+    ++i;
+  }
+}
+
+void SceneGraph::update(JobSystem *jobs) {
+  PROFILE_ZONE("SceneGraph::update");
+  if (m_needsSort)
+    sortNodes();
+
+  const uint32_t count = (uint32_t)m_transforms.size();
+  size_t updated = 0;
+  if (!jobs || jobs->threadCount() < 2 || count < kParallelMinNodes) {
+    updateRange(0, count, updated);
+    m_lastUpdated = updated;
+    m_updateAll = false;
+    return;
+  }
+
+  // Split the forest into subtrees of at most `grain` nodes. Nodes above
+  // them (roots of large subtrees) are updated here first, so every task
+  // finds its parent's world matrix ready.
+  const uint32_t grain =
+      std::max<uint32_t>(256, count / (jobs->threadCount() * 8));
+  m_tasks.clear();
+  std::vector<uint32_t> pending;
+  for (uint32_t root = 0; root < count; root = m_subtreeEnd[root])
+    pending.push_back(root);
+  while (!pending.empty()) {
+    uint32_t i = pending.back();
+    pending.pop_back();
+    uint32_t parent = m_parentIndex[i];
+    bool parentMoved = parent != kInvalidNode && m_worldChanged[parent];
+    if (!m_dirtyBelow[i] && !parentMoved) {
+      m_worldChanged[i] = 0;
+      continue;
+    }
+    if (m_subtreeEnd[i] - i <= grain) {
+      m_tasks.push_back(i);
+      continue;
+    }
+    if (updateNode(i))
+      updated++;
+    m_dirtyBelow[i] = 0;
+    for (uint32_t c = i + 1; c < m_subtreeEnd[i]; c = m_subtreeEnd[c])
+      pending.push_back(c);
+  }
+
+  std::atomic<size_t> taskUpdated{0};
+  jobs->parallelFor(m_tasks.size(), 1, [&](size_t begin, size_t end) {
+    PROFILE_ZONE("SceneGraph::updateSubtree");
+    size_t local = 0;
+    for (size_t t = begin; t < end; ++t)
+      updateRange(m_tasks[t], m_subtreeEnd[m_tasks[t]], local);
+    taskUpdated.fetch_add(local, std::memory_order_relaxed);
+  });
+
+  m_lastUpdated = updated + taskUpdated.load(std::memory_order_relaxed);
+  m_updateAll = false;
+}
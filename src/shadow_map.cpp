@@ -0,0 +1,125 @@
+#include "shadow_map.hpp"
+#include "frustum.hpp"
+#include "profiler.hpp"
+#include <glm/gtc/matrix_transform.hpp>
+#include <cstring>
+
+namespace {
+const float kShadowNear = 0.05f;
+
+// GL cube map face order (+X, -X, +Y, -Y, +Z, -Z) with the up vectors
+// that match its texel orientation
+const glm::vec3 kFaceDirections[6] = {
+    glm::vec3(1.0f, 0.0f, 0.0f),  glm::vec3(-1.0f, 0.0f, 0.0f),
+    glm::vec3(0.0f, 1.0f, 0.0f),  glm::vec3(0.0f, -1.0f, 0.0f),
+    glm::vec3(0.0f, 0.0f, 1.0f),  glm::vec3(0.0f, 0.0f, -1.0f)};
+const glm::vec3 kFaceUps[6] = {
+    glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+    glm::vec3(0.0f, 0.0f, 1.0f),  glm::vec3(0.0f, 0.0f, -1.0f),
+    glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)};
+
+// FNV-1a over the casters' matrices
+uint64_t hashCasters(const std::vector<ShadowCaster> &casters) {
+  uint64_t hash = 1469598103934665603ull;
+  for (const ShadowCaster &caster : casters) {
+    uint32_t words[16];
+    std::memcpy(words, &caster.model, sizeof words);
+    for (uint32_t word : words) {
+      hash ^= word;
+      hash *= 1099511628211ull;
+    }
+  }
+  return hash ^ casters.size();
+}
+} // namespace
+
+PointShadowMap::PointShadowMap(int size, float farPlane)
+    : m_size(size), m_farPlane(farPlane) {
+  glGenTextures(1, &m_texture);
+  glGenFramebuffers(1, &m_framebuffer);
+  allocate();
+}
+
+PointShadowMap::~PointShadowMap() {
+  glDeleteFramebuffers(1, &m_framebuffer);
+  glDeleteTextures(1, &m_texture);
+}
+
+void PointShadowMap::setSize(int size) {
+  if (size == m_size)
+    return;
+  m_size = size;
+  allocate();
+}
+
+void PointShadowMap::allocate() {
+  glBindTexture(GL_TEXTURE_CUBE_MAP, m_texture);
+  for (int face = 0; face < 6; ++face)
+    glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0,
+                 GL_DEPTH_COMPONENT24, m_size, m_size, 0, GL_DEPTH_COMPONENT,
+                 GL_FLOAT, NULL);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+  // Depth comparison in the sampler: lookups return the lit fraction of
+  // the 2x2 texels around the direction
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_COMPARE_MODE,
+                  GL_COMPARE_REF_TO_TEXTURE);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+  glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+  m_valid = false;
+}
+
+bool PointShadowMap::needsUpdate(
+    const glm::vec3 &lightPos, const std::vector<ShadowCaster> &casters) const {
+  return !m_valid || lightPos != m_lightPos ||
+         hashCasters(casters) != m_castersHash;
+}
+
+void PointShadowMap::render(
+    const glm::vec3 &lightPos, const std::vector<ShadowCaster> &casters,
+    const std::function<void(const glm::mat4 &, const ShadowCaster &)>
+        &drawCaster) {
+  PROFILE_ZONE("PointShadowMap::render");
+  glm::mat4 proj =
+      glm::perspective(glm::radians(90.0f), 1.0f, kShadowNear, m_farPlane);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+  glDrawBuffer(GL_NONE);
+  glReadBuffer(GL_NONE);
+  glViewport(0, 0, m_size, m_size);
+  glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+  glDepthMask(GL_TRUE);
+  glDepthFunc(GL_LESS);
+
+  m_lastFaces = 0;
+  m_lastDraws = 0;
+  for (int face = 0; face < 6; ++face) {
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                           GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, m_texture,
+                           0);
+    glClear(GL_DEPTH_BUFFER_BIT);
+    glm::mat4 viewProj =
+        proj * glm::lookAt(lightPos, lightPos + kFaceDirections[face],
+                           kFaceUps[face]);
+    Frustum frustum = extractFrustum(viewProj);
+    bool drawn = false;
+    for (const ShadowCaster &caster : casters) {
+      if (!sphereInFrustum(frustum, glm::vec3(caster.sphere),
+                           caster.sphere.w))
+        continue;
+      drawCaster(viewProj, caster);
+      m_lastDraws++;
+      drawn = true;
+    }
+    if (drawn)
+      m_lastFaces++;
+  }
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+  m_valid = true;
+  m_lightPos = lightPos;
+  m_castersHash = hashCasters(casters);
+}
@@ -0,0 +1,340 @@
+#include "soft_rasterizer.hpp"
+#include "job_system.hpp"
+#include <learnopengl/transform.h>
+#include "profiler.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace {
+const uint32_t kNoTriangle = UINT32_MAX;
+const size_t kVertexGrain = 4096;
+const size_t kSetupChunk = 2048;
+
+// Run fn(begin, end) over [0, count), on the job system when there is one
+void forRange(JobSystem *jobs, size_t count, size_t grain,
+              const std::function<void(size_t, size_t)> &fn) {
+  if (jobs)
+    jobs->parallelFor(count, grain, fn);
+  else if (count > 0)
+    fn(0, count);
+}
+
+const glm::vec3 &fetch(const glm::vec3 *base, size_t stride, size_t i) {
+  return *(const glm::vec3 *)((const char *)base + i * stride);
+}
+} // namespace
+
+uint32_t packColor(const glm::vec3 &c) {
+  auto channel = [](float v) {
+    return (uint32_t)(std::min(std::max(v, 0.0f), 1.0f) * 255.0f + 0.5f);
+  };
+  return channel(c.x) | channel(c.y) << 8 | channel(c.z) << 16 | 0xFF000000u;
+}
+
+glm::vec3 shadePhong(const glm::vec3 &fragPos, const glm::vec3 &normal,
+                     const SoftLight &light, const Material &material) {
+  glm::vec3 n = glm::normalize(normal);
+  glm::vec3 s = glm::normalize(glm::vec3(light.positionEye) - fragPos);
+  glm::vec3 v = glm::normalize(-fragPos);
+
+  glm::vec3 ambient = light.la * material.Ka;
+
+  float sDotN = std::max(glm::dot(s, n), 0.0f);
+  glm::vec3 diffuse = light.ld * material.Kd * sDotN;
+
+  glm::vec3 spec(0.0f);
+  if (sDotN > 0.0f) {
+    float specFactor = 0.0f;
+    if (light.blinn) {
+      glm::vec3 halfwayDir = glm::normalize(s + v);
+      specFactor = std::pow(std::max(glm::dot(n, halfwayDir), 0.0f),
+                            material.Ns);
+    } else {
+      glm::vec3 r = -s - 2.0f * glm::dot(n, -s) * n; // reflect(-s, n)
+      specFactor = std::pow(std::max(glm::dot(r, v), 0.0f), material.Ns);
+    }
+    spec = light.ls * material.Ks * specFactor;
+  }
+  return ambient + diffuse + spec;
+}
+
+SoftRasterizer::SoftRasterizer(int width, int height)
+    : m_width(width), m_height(height),
+      m_tilesX((width + kTileSize - 1) / kTileSize),
+      m_tilesY((height + kTileSize - 1) / kTileSize),
+      m_color((size_t)width * height), m_depth((size_t)width * height),
+      m_bins((size_t)m_tilesX * m_tilesY) {}
+
+void SoftRasterizer::clear(const glm::vec3 &color) {
+  std::fill(m_color.begin(), m_color.end(), packColor(color));
+  std::fill(m_depth.begin(), m_depth.end(), 1.0f);
+}
+
+void SoftRasterizer::draw(const SoftDraw &draw, const SoftLight &light,
+                          JobSystem *jobs) {
+  PROFILE_ZONE("SoftRasterizer::draw");
+  const size_t triangleCount =
+      (draw.indices ? draw.indexCount : draw.vertexCount) / 3;
+  if (triangleCount == 0)
+    return;
+
+  // 1. Vertex stage (phong.vert)
+  m_vertices.resize(draw.vertexCount);
+  forRange(jobs, draw.vertexCount, kVertexGrain, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      glm::vec4 p(fetch(draw.positions, draw.stride, i), 1.0f);
+      ShadedVertex &out = m_vertices[i];
+      out.clip = draw.mvp * p;
+      out.eyePos = glm::vec3(draw.modelView * p);
+      out.eyeNormal = glm::normalize(draw.normalMatrix *
+                                     fetch(draw.normals, draw.stride, i));
+    }
+  });
+
+  // 2. Triangle setup and binning, one set of bins per chunk so chunks
+  // never share a vector; merged in chunk order to keep triangle order
+  const size_t tileCount = m_bins.size();
+  const size_t chunks = (triangleCount + kSetupChunk - 1) / kSetupChunk;
+  m_triangles.resize(triangleCount);
+  if (m_chunkBins.size() < chunks)
+    m_chunkBins.resize(chunks);
+  const float width = (float)m_width, height = (float)m_height;
+
+  forRange(jobs, chunks, 1, [&](size_t chunkBegin, size_t chunkEnd) {
+    for (size_t chunk = chunkBegin; chunk < chunkEnd; ++chunk) {
+      std::vector<std::vector<uint32_t>> &bins = m_chunkBins[chunk];
+      bins.resize(tileCount);
+      for (std::vector<uint32_t> &bin : bins)
+        bin.clear();
+
+      size_t first = chunk * kSetupChunk;
+      size_t last = std::min(first + kSetupChunk, triangleCount);
+      for (size_t t = first; t < last; ++t) {
+        SetupTriangle &tri = m_triangles[t];
+        float sx[3], sy[3];
+        bool behind = false;
+        for (int k = 0; k < 3; ++k) {
+          tri.v[k] = draw.indices ? draw.indices[3 * t + k]
+                                  : (uint32_t)(3 * t + k);
+          const glm::vec4 &clip = m_vertices[tri.v[k]].clip;
+          if (clip.w <= 1e-5f) {
+            behind = true;
+            break;
+          }
+          tri.invW[k] = 1.0f / clip.w;
+          sx[k] = (clip.x * tri.invW[k] * 0.5f + 0.5f) * width;
+          sy[k] = (clip.y * tri.invW[k] * 0.5f + 0.5f) * height;
+          tri.z[k] = clip.z * tri.invW[k] * 0.5f + 0.5f;
+        }
+        if (behind)
+          continue;
+
+        float det = (sy[1] - sy[2]) * (sx[0] - sx[2]) +
+                    (sx[2] - sx[1]) * (sy[0] - sy[2]);
+        if (std::fabs(det) < 1e-12f)
+          continue; // Degenerate
+        float invDet = 1.0f / det;
+        tri.a[0] = (sy[1] - sy[2]) * invDet;
+        tri.b[0] = (sx[2] - sx[1]) * invDet;
+        tri.a[1] = (sy[2] - sy[0]) * invDet;
+        tri.b[1] = (sx[0] - sx[2]) * invDet;
+        tri.c[0] = -(tri.a[0] * sx[2] + tri.b[0] * sy[2]);
+        tri.c[1] = -(tri.a[1] * sx[2] + tri.b[1] * sy[2]);
+        tri.a[2] = -(tri.a[0] + tri.a[1]);
+        tri.b[2] = -(tri.b[0] + tri.b[1]);
+        tri.c[2] = 1.0f - tri.c[0] - tri.c[1];
+
+        // Pixel bounds (centers at +0.5), clipped to the screen
+        float minX = std::min(sx[0], std::min(sx[1], sx[2]));
+        float maxX = std::max(sx[0], std::max(sx[1], sx[2]));
+        float minY = std::min(sy[0], std::min(sy[1], sy[2]));
+        float maxY = std::max(sy[0], std::max(sy[1], sy[2]));
+        if (maxX < 0.0f || maxY < 0.0f || minX > width || minY > height)
+          continue;
+        int x0 = std::max(0, (int)std::floor(minX));
+        int x1 = std::min(m_width - 1, (int)std::ceil(maxX));
+        int y0 = std::max(0, (int)std::floor(minY));
+        int y1 = std::min(m_height - 1, (int)std::ceil(maxY));
+        tri.minX = x0;
+        tri.maxX = x1;
+        tri.minY = y0;
+        tri.maxY = y1;
+
+        for (int ty = y0 / kTileSize; ty <= y1 / kTileSize; ++ty)
+          for (int tx = x0 / kTileSize; tx <= x1 / kTileSize; ++tx)
+            bins[(size_t)ty * m_tilesX + tx].push_back((uint32_t)t);
+      }
+    }
+  });
+
+  forRange(jobs, tileCount, 16, [&](size_t begin, size_t end) {
+    for (size_t tile = begin; tile < end; ++tile) {
+      std::vector<uint32_t> &bin = m_bins[tile];
+      bin.clear();
+      for (size_t chunk = 0; chunk < chunks; ++chunk)
+        bin.insert(bin.end(), m_chunkBins[chunk][tile].begin(),
+                   m_chunkBins[chunk][tile].end());
+    }
+  });
+
+  // 3. Visibility, then shading, per tile
+  forRange(jobs, tileCount, 1, [&](size_t begin, size_t end) {
+    for (size_t tile = begin; tile < end; ++tile)
+      if (!m_bins[tile].empty())
+        rasterTile((int)tile, draw, light);
+  });
+}
+
+void SoftRasterizer::rasterTile(int tile, const SoftDraw &draw,
+                                const SoftLight &light) {
+  const int tileX0 = (tile % m_tilesX) * kTileSize;
+  const int tileY0 = (tile / m_tilesX) * kTileSize;
+  const int tileX1 = std::min(tileX0 + kTileSize, m_width) - 1;
+  const int tileY1 = std::min(tileY0 + kTileSize, m_height) - 1;
+
+  // Tile-local depth and nearest triangle, kTileSize columns per row
+  alignas(16) float depth[kTileSize * kTileSize];
+  uint32_t nearest[kTileSize * kTileSize];
+  for (int y = tileY0; y <= tileY1; ++y) {
+    const float *src = &m_depth[(size_t)y * m_width];
+    float *dst = &depth[(y - tileY0) * kTileSize];
+    for (int x = tileX0; x <= tileX1; ++x)
+      dst[x - tileX0] = src[x];
+    for (int x = tileX1 + 1; x < tileX0 + kTileSize; ++x)
+      dst[x - tileX0] = 0.0f; // Outside the screen: never passes
+  }
+  std::fill(nearest, nearest + kTileSize * kTileSize, kNoTriangle);
+
+  for (uint32_t t : m_bins[tile]) {
+    const SetupTriangle &tri = m_triangles[t];
+    const int x0 = std::max(tri.minX, tileX0), x1 = std::min(tri.maxX, tileX1);
+    const int y0 = std::max(tri.minY, tileY0), y1 = std::min(tri.maxY, tileY1);
+    // Four-pixel groups start on a multiple of 4 inside the tile
+    const int xStart = tileX0 + ((x0 - tileX0) & ~3);
+
+#ifdef TRANSFORM_USE_SSE
+    const __m128 laneOffset = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+    __m128 a[3], z[3];
+    for (int k = 0; k < 3; ++k) {
+      a[k] = _mm_set1_ps(tri.a[k]);
+      z[k] = _mm_set1_ps(tri.z[k]);
+    }
+    const __m128 zero = _mm_setzero_ps();
+    for (int y = y0; y <= y1; ++y) {
+      const float py = (float)y + 0.5f;
+      __m128 rowC[3];
+      for (int k = 0; k < 3; ++k)
+        rowC[k] = _mm_set1_ps(tri.b[k] * py + tri.c[k]);
+      float *depthRow = &depth[(y - tileY0) * kTileSize];
+      uint32_t *nearestRow = &nearest[(y - tileY0) * kTileSize];
+
+      for (int x = xStart; x <= x1; x += 4) {
+        __m128 px = _mm_add_ps(_mm_set1_ps((float)x), laneOffset);
+        __m128 e0 = _mm_add_ps(_mm_mul_ps(a[0], px), rowC[0]);
+        __m128 e1 = _mm_add_ps(_mm_mul_ps(a[1], px), rowC[1]);
+        __m128 e2 = _mm_add_ps(_mm_mul_ps(a[2], px), rowC[2]);
+        __m128 inside = _mm_and_ps(
+            _mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)),
+            _mm_cmpge_ps(e2, zero));
+        if (_mm_movemask_ps(inside) == 0)
+          continue;
+
+        __m128 zPix = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(e0, z[0]), _mm_mul_ps(e1, z[1])),
+            _mm_mul_ps(e2, z[2]));
+        float *d = &depthRow[x - tileX0];
+        __m128 old = _mm_loadu_ps(d);
+        __m128 pass = _mm_and_ps(inside, _mm_cmplt_ps(zPix, old));
+        // Lanes outside the triangle fail the edge test, lanes past the
+        // screen edge the depth test (their depth is 0)
+        int mask = _mm_movemask_ps(pass);
+        if (mask == 0)
+          continue;
+        _mm_storeu_ps(d, _mm_or_ps(_mm_and_ps(pass, zPix),
+                                   _mm_andnot_ps(pass, old)));
+        for (int lane = 0; lane < 4; ++lane)
+          if (mask & (1 << lane))
+            nearestRow[x - tileX0 + lane] = t;
+      }
+    }
+#else
+    for (int y = y0; y <= y1; ++y) {
+      const float py = (float)y + 0.5f;
+      float *depthRow = &depth[(y - tileY0) * kTileSize];
+      uint32_t *nearestRow = &nearest[(y - tileY0) * kTileSize];
+      for (int x = xStart; x <= x1; ++x) {
+        const float px = (float)x + 0.5f;
+        float e[3];
+        for (int k = 0; k < 3; ++k)
+          e[k] = tri.a[k] * px + tri.b[k] * py + tri.c[k];
+        if (e[0] < 0.0f || e[1] < 0.0f || e[2] < 0.0f)
+          continue;
+        float zPix = e[0] * tri.z[0] + e[1] * tri.z[1] + e[2] * tri.z[2];
+        if (zPix < depthRow[x - tileX0]) {
+          depthRow[x - tileX0] = zPix;
+          nearestRow[x - tileX0] = t;
+        }
+      }
+    }
+#endif
+  }
+
+  // Shade each covered pixel once with the nearest triangle's attributes
+  for (int y = tileY0; y <= tileY1; ++y) {
+    const float py = (float)y + 0.5f;
+    const uint32_t *nearestRow = &nearest[(y - tileY0) * kTileSize];
+    const float *depthRow = &depth[(y - tileY0) * kTileSize];
+    uint32_t *colorOut = &m_color[(size_t)y * m_width];
+    float *depthOut = &m_depth[(size_t)y * m_width];
+    for (int x = tileX0; x <= tileX1; ++x) {
+      uint32_t t = nearestRow[x - tileX0];
+      if (t == kNoTriangle)
+        continue;
+      const SetupTriangle &tri = m_triangles[t];
+      const float px = (float)x + 0.5f;
+
+      // Perspective-correct barycentrics
+      float w[3], sum = 0.0f;
+      for (int k = 0; k < 3; ++k) {
+        w[k] = (tri.a[k] * px + tri.b[k] * py + tri.c[k]) * tri.invW[k];
+        sum += w[k];
+      }
+      glm::vec3 fragPos(0.0f), normal(0.0f);
+      for (int k = 0; k < 3; ++k) {
+        const ShadedVertex &v = m_vertices[tri.v[k]];
+        fragPos += v.eyePos * (w[k] / sum);
+        normal += v.eyeNormal * (w[k] / sum);
+      }
+      colorOut[x] =
+          packColor(shadePhong(fragPos, normal, light, draw.material));
+      depthOut[x] = depthRow[x - tileX0];
+    }
+  }
+}
+
+bool SoftRasterizer::writePPM(const std::string &path) const {
+  return ::writePPM(path, m_width, m_height, m_color.data());
+}
+
+bool writePPM(const std::string &path, int width, int height,
+              const uint32_t *pixels) {
+  FILE *file = std::fopen(path.c_str(), "wb");
+  if (file == NULL) {
+    std::fprintf(stderr, "[soft] could not open %s\n", path.c_str());
+    return false;
+  }
+  std::fprintf(file, "P6\n%d %d\n255\n", width, height);
+  std::vector<unsigned char> row((size_t)width * 3);
+  for (int y = height - 1; y >= 0; --y) {
+    const uint32_t *src = &pixels[(size_t)y * width];
+    for (int x = 0; x < width; ++x) {
+      row[3 * x + 0] = (unsigned char)(src[x] & 0xFF);
+      row[3 * x + 1] = (unsigned char)((src[x] >> 8) & 0xFF);
+      row[3 * x + 2] = (unsigned char)((src[x] >> 16) & 0xFF);
+    }
+    std::fwrite(row.data(), 1, row.size(), file);
+  }
+  std::fclose(file);
+  return true;
+}
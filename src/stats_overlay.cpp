@@ -0,0 +1,102 @@
+#include "stats_overlay.hpp"
+#include <learnopengl/filesystem.h>
+#include <learnopengl/shader.h>
+#include <cctype>
+
+namespace {
+
+// 3x5 glyphs, one bit per pixel, top row in the highest bits
+struct Glyph {
+  char c;
+  unsigned short bits;
+};
+
+const Glyph kFont[] = {
+    {'0', 0x7B6F}, {'1', 0x2C97}, {'2', 0x73E7}, {'3', 0x72CF}, {'4', 0x5BC9}, {'5', 0x79CF},
+    {'6', 0x79EF}, {'7', 0x7292}, {'8', 0x7BEF}, {'9', 0x7BCF}, {'A', 0x2BED}, {'B', 0x6BAE},
+    {'C', 0x3923}, {'D', 0x6B6E}, {'E', 0x79A7}, {'F', 0x79A4}, {'G', 0x396B}, {'H', 0x5BED},
+    {'I', 0x7497}, {'J', 0x126A}, {'K', 0x5BAD}, {'L', 0x4927}, {'M', 0x5FED}, {'N', 0x6B6D},
+    {'O', 0x2B6A}, {'P', 0x6BA4}, {'Q', 0x2B73}, {'R', 0x6BAD}, {'S', 0x388E}, {'T', 0x7492},
+    {'U', 0x5B6F}, {'V', 0x5B6A}, {'W', 0x5BFD}, {'X', 0x5AAD}, {'Y', 0x5A92}, {'Z', 0x72A7},
+    {':', 0x0410}, {'.', 0x0002}, {'-', 0x01C0}, {'/', 0x12A4}, {'%', 0x52A5},
+};
+
+unsigned short glyphBits(char c) {
+  c = (char)std::toupper((unsigned char)c);
+  for (const Glyph &g : kFont)
+    if (g.c == c)
+      return g.bits;
+  return 0; // Space and unknown characters draw nothing
+}
+
+const float kPixel = 3.0f; // Size of one font pixel on screen
+const float kMargin = 8.0f;
+
+} // namespace
+
+StatsOverlay::StatsOverlay() {
+  Shader shader(FileSystem::getPath("shaders/overlay.vert").c_str(),
+                FileSystem::getPath("shaders/overlay.frag").c_str());
+  m_program = shader.ID;
+
+  glGenVertexArrays(1, &m_vao);
+  glGenBuffers(1, &m_vbo);
+  glBindVertexArray(m_vao);
+  glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void *)0);
+  glBindVertexArray(0);
+}
+
+StatsOverlay::~StatsOverlay() {
+  glDeleteBuffers(1, &m_vbo);
+  glDeleteVertexArrays(1, &m_vao);
+  glDeleteProgram(m_program);
+}
+
+void StatsOverlay::draw(const std::vector<std::string> &lines, int fbWidth,
+                        int fbHeight) {
+  if (fbWidth <= 0 || fbHeight <= 0)
+    return;
+
+  // Build two triangles per lit pixel, in framebuffer pixels (origin top-left)
+  m_quads.clear();
+  for (size_t row = 0; row < lines.size(); ++row) {
+    float penY = kMargin + row * 7.0f * kPixel;
+    for (size_t col = 0; col < lines[row].size(); ++col) {
+      unsigned short bits = glyphBits(lines[row][col]);
+      float penX = kMargin + col * 4.0f * kPixel;
+      for (int bit = 0; bit < 15; ++bit) {
+        if (!(bits & (1 << (14 - bit))))
+          continue;
+        float x0 = penX + (bit % 3) * kPixel, y0 = penY + (bit / 3) * kPixel;
+        float x1 = x0 + kPixel, y1 = y0 + kPixel;
+        float quad[12] = {x0, y0, x1, y0, x1, y1, x1, y1, x0, y1, x0, y0};
+        m_quads.insert(m_quads.end(), quad, quad + 12);
+      }
+    }
+  }
+  if (m_quads.empty())
+    return;
+
+  // Overlay must be readable in wireframe mode and on top of the scene
+  GLint polygonMode[2];
+  glGetIntegerv(GL_POLYGON_MODE, polygonMode);
+  GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+  glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+  glDisable(GL_DEPTH_TEST);
+
+  glUseProgram(m_program);
+  glUniform2f(glGetUniformLocation(m_program, "ScreenSize"), (float)fbWidth,
+              (float)fbHeight);
+  glBindVertexArray(m_vao);
+  glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+  glBufferData(GL_ARRAY_BUFFER, m_quads.size() * sizeof(float), m_quads.data(),
+               GL_STREAM_DRAW);
+  glDrawArrays(GL_TRIANGLES, 0, (GLsizei)(m_quads.size() / 2));
+  glBindVertexArray(0);
+
+  if (depthTest)
+    glEnable(GL_DEPTH_TEST);
+  glPolygonMode(GL_FRONT_AND_BACK, polygonMode[0]);
+}
@@ -0,0 +1,128 @@
+#include "stream_buffer.hpp"
+#include "profiler.hpp"
+#include "render_stats.hpp"
+#include <algorithm>
+#include <cstdio>
+
+StreamBuffer::StreamBuffer(size_t bytesPerFrame, int frames)
+    : m_bytesPerFrame(bytesPerFrame),
+      m_frames(std::min(std::max(frames, 1), kMaxFrames)) {
+  m_persistent = GLAD_GL_VERSION_4_4 != 0;
+  const size_t total = m_bytesPerFrame * m_frames;
+
+  // GL_COPY_WRITE_BUFFER does not disturb VAO / draw bindings
+  glGenBuffers(1, &m_buffer);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+  if (m_persistent) {
+    const GLbitfield flags =
+        GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glBufferStorage(GL_COPY_WRITE_BUFFER, total, NULL, flags);
+    m_persistentPtr =
+        (uint8_t *)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, total, flags);
+    if (!m_persistentPtr) {
+      std::fprintf(stderr, "[stream] persistent map failed\n");
+      m_persistent = false;
+    }
+  }
+  if (!m_persistent) {
+    // Storage from glBufferStorage is immutable, so start over
+    glDeleteBuffers(1, &m_buffer);
+    glGenBuffers(1, &m_buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, total, NULL, GL_STREAM_DRAW);
+  }
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+  std::printf("Stream buffer: %d x %zu KB, %s\n", m_frames,
+              m_bytesPerFrame / 1024,
+              m_persistent ? "persistent mapping" : "unsynchronized mapping");
+}
+
+StreamBuffer::~StreamBuffer() {
+  for (GLsync &fence : m_fences)
+    if (fence)
+      glDeleteSync(fence);
+  if (m_persistentPtr || m_regionPtr) {
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+    glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+  }
+  glDeleteBuffers(1, &m_buffer);
+}
+
+void StreamBuffer::beginFrame() {
+  PROFILE_ZONE("StreamBuffer::beginFrame");
+  m_region = (m_region + 1) % m_frames;
+  m_used = 0;
+
+  GLsync &fence = m_fences[m_region];
+  if (fence) {
+    // Poll first; only block if the GPU really is `frames` frames behind
+    GLenum status = glClientWaitSync(fence, 0, 0);
+    if (status == GL_TIMEOUT_EXPIRED) {
+      m_stalls++;
+      renderStats().streamStalls++;
+      glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+    }
+    glDeleteSync(fence);
+    fence = 0;
+  }
+
+  if (m_persistent)
+    m_regionPtr = m_persistentPtr + (size_t)m_region * m_bytesPerFrame;
+  else
+    mapRemaining();
+}
+
+void StreamBuffer::mapRemaining() {
+  // The fence already guarantees the GPU is done with this region, so the
+  // driver does not need to synchronize the mapping
+  glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+  m_mapStart = m_used;
+  m_regionPtr = (uint8_t *)glMapBufferRange(
+      GL_COPY_WRITE_BUFFER, (size_t)m_region * m_bytesPerFrame + m_mapStart,
+      m_bytesPerFrame - m_mapStart,
+      GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT |
+          GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_FLUSH_EXPLICIT_BIT);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+StreamBuffer::Allocation StreamBuffer::allocate(size_t size,
+                                                size_t alignment) {
+  Allocation result;
+  if (m_region < 0)
+    return result;
+  size_t start = (m_used + alignment - 1) & ~(alignment - 1);
+  if (start + size > m_bytesPerFrame)
+    return result;
+  // Written after a flush() on the fallback path: map the rest of the region
+  if (!m_regionPtr)
+    mapRemaining();
+  if (!m_regionPtr)
+    return result;
+
+  m_used = start + size;
+  result.data = m_regionPtr + (start - m_mapStart);
+  result.offset = (GLintptr)((size_t)m_region * m_bytesPerFrame + start);
+  result.size = size;
+  renderStats().bufferBytesUploaded += size;
+  return result;
+}
+
+void StreamBuffer::flush() {
+  if (m_persistent || !m_regionPtr)
+    return;
+  // The mapping must be released before the GPU reads the data
+  glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+  if (m_used > m_mapStart)
+    glFlushMappedBufferRange(GL_COPY_WRITE_BUFFER, 0, m_used - m_mapStart);
+  glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+  m_regionPtr = nullptr;
+}
+
+void StreamBuffer::endFrame() {
+  flush();
+  if (m_region >= 0)
+    m_fences[m_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
@@ -0,0 +1,665 @@
+#include "texture.hpp"
+#include "job_system.hpp"
+#include <learnopengl/transform.h>
+#include "profiler.hpp"
+#include <sys/stat.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#ifdef TRANSFORM_USE_SSE
+#include <emmintrin.h>
+#endif
+
+namespace {
+const uint32_t kCacheVersion = 1;
+const char kCacheMagic[4] = {'T', 'P', '2', 'T'};
+const size_t kRowGrain = 16;   // Mip rows per job
+const size_t kBlockGrain = 64; // Block rows per job
+const int kKaiserTaps = 8;
+
+double nowMs() {
+  using namespace std::chrono;
+  return duration<double, std::milli>(steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Run fn(begin, end) over [0, count), on the job system when there is one
+void forRange(JobSystem *jobs, size_t count, size_t grain,
+              const std::function<void(size_t, size_t)> &fn) {
+  if (jobs && count > grain)
+    jobs->parallelFor(count, grain, fn);
+  else if (count > 0)
+    fn(0, count);
+}
+
+bool readFile(const char *path, std::vector<uint8_t> &bytes) {
+  FILE *file = std::fopen(path, "rb");
+  if (!file)
+    return false;
+  std::fseek(file, 0, SEEK_END);
+  long size = std::ftell(file);
+  std::fseek(file, 0, SEEK_SET);
+  bytes.resize(size > 0 ? (size_t)size : 0);
+  size_t read = bytes.empty() ? 0 : std::fread(bytes.data(), 1, bytes.size(),
+                                               file);
+  std::fclose(file);
+  return read == bytes.size();
+}
+
+// --- Decoders ---
+
+// Next whitespace-separated number of a PPM header, skipping # comments
+bool ppmNumber(const std::vector<uint8_t> &bytes, size_t &pos, int &value) {
+  while (pos < bytes.size()) {
+    if (bytes[pos] == '#') {
+      while (pos < bytes.size() && bytes[pos] != '\n')
+        ++pos;
+    } else if (bytes[pos] == ' ' || bytes[pos] == '\t' ||
+               bytes[pos] == '\n' || bytes[pos] == '\r') {
+      ++pos;
+    } else {
+      break;
+    }
+  }
+  if (pos >= bytes.size() || bytes[pos] < '0' || bytes[pos] > '9')
+    return false;
+  value = 0;
+  while (pos < bytes.size() && bytes[pos] >= '0' && bytes[pos] <= '9')
+    value = value * 10 + (bytes[pos++] - '0');
+  return true;
+}
+
+bool decodePPM(const std::vector<uint8_t> &bytes, TextureLevel &level) {
+  size_t pos = 2;
+  int width = 0, height = 0, maxValue = 0;
+  if (!ppmNumber(bytes, pos, width) || !ppmNumber(bytes, pos, height) ||
+      !ppmNumber(bytes, pos, maxValue) || maxValue != 255 || width <= 0 ||
+      height <= 0)
+    return false;
+  ++pos; // Single whitespace before the pixels
+  if (bytes.size() - std::min(pos, bytes.size()) < (size_t)width * height * 3)
+    return false;
+
+  level.width = width;
+  level.height = height;
+  level.data.resize((size_t)width * height * 4);
+  for (int y = 0; y < height; ++y) {
+    // PPM rows run top to bottom
+    const uint8_t *src = &bytes[pos + (size_t)(height - 1 - y) * width * 3];
+    uint8_t *dst = &level.data[(size_t)y * width * 4];
+    for (int x = 0; x < width; ++x) {
+      dst[4 * x] = src[3 * x];
+      dst[4 * x + 1] = src[3 * x + 1];
+      dst[4 * x + 2] = src[3 * x + 2];
+      dst[4 * x + 3] = 255;
+    }
+  }
+  return true;
+}
+
+bool decodeTGA(const std::vector<uint8_t> &bytes, TextureLevel &level) {
+  if (bytes.size() < 18)
+    return false;
+  const uint8_t *header = bytes.data();
+  int imageType = header[2];
+  int width = header[12] | header[13] << 8;
+  int height = header[14] | header[15] << 8;
+  int bytesPerPixel = header[16] / 8;
+  bool topDown = (header[17] & 0x20) != 0;
+  if ((imageType != 2 && imageType != 10) || header[1] != 0 ||
+      (bytesPerPixel != 3 && bytesPerPixel != 4) || width <= 0 || height <= 0)
+    return false;
+
+  level.width = width;
+  level.height = height;
+  level.data.resize((size_t)width * height * 4);
+  size_t pos = 18 + header[0]; // Skip the image ID
+  size_t pixels = (size_t)width * height;
+  size_t pixel = 0;
+  // BGR(A) to RGBA, in file order (rows flipped afterwards when top-down)
+  auto emit = [&](const uint8_t *src) {
+    uint8_t *dst = &level.data[4 * pixel++];
+    dst[0] = src[2];
+    dst[1] = src[1];
+    dst[2] = src[0];
+    dst[3] = bytesPerPixel == 4 ? src[3] : 255;
+  };
+  while (pixel < pixels) {
+    if (imageType == 2) {
+      if (pos + bytesPerPixel > bytes.size())
+        return false;
+      emit(&bytes[pos]);
+      pos += bytesPerPixel;
+      continue;
+    }
+    // RLE packet: run of one pixel, or a raw stretch
+    if (pos >= bytes.size())
+      return false;
+    uint8_t packet = bytes[pos++];
+    size_t count = (packet & 0x7f) + 1u;
+    bool run = (packet & 0x80) != 0;
+    if (pixel + count > pixels ||
+        pos + (run ? 1 : count) * bytesPerPixel > bytes.size())
+      return false;
+    for (size_t i = 0; i < count; ++i) {
+      emit(&bytes[pos]);
+      if (!run)
+        pos += bytesPerPixel;
+    }
+    if (run)
+      pos += bytesPerPixel;
+  }
+  if (topDown) {
+    size_t rowBytes = (size_t)width * 4;
+    for (int y = 0; y < height / 2; ++y)
+      std::swap_ranges(&level.data[y * rowBytes],
+                       &level.data[(y + 1) * rowBytes],
+                       &level.data[(height - 1 - y) * rowBytes]);
+  }
+  return true;
+}
+
+// --- Mip filters ---
+
+// 2x2 average of src into dst rows [rowBegin, rowEnd). Odd source sizes
+// drop their last row / column, except at 1 texel where it is repeated.
+void boxRows(const TextureLevel &src, TextureLevel &dst, size_t rowBegin,
+             size_t rowEnd) {
+  const size_t srcRow = (size_t)src.width * 4;
+  for (size_t y = rowBegin; y < rowEnd; ++y) {
+    const uint8_t *row0 = &src.data[std::min<size_t>(2 * y, src.height - 1) *
+                                    srcRow];
+    const uint8_t *row1 =
+        &src.data[std::min<size_t>(2 * y + 1, src.height - 1) * srcRow];
+    uint8_t *out = &dst.data[y * dst.width * 4];
+    int x = 0;
+#ifdef TRANSFORM_USE_SSE
+    // Two output texels (four input texels per row) per step
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i two = _mm_set1_epi16(2);
+    for (; 2 * x + 3 < src.width; x += 2) {
+      __m128i a = _mm_loadu_si128((const __m128i *)(row0 + 8 * x));
+      __m128i b = _mm_loadu_si128((const __m128i *)(row1 + 8 * x));
+      // Vertical sums of texels 0-1 and 2-3, 16 bits per channel
+      __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero),
+                                 _mm_unpacklo_epi8(b, zero));
+      __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero),
+                                 _mm_unpackhi_epi8(b, zero));
+      // Horizontal: texel 0 + 1 and texel 2 + 3, rounded
+      __m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(lo, hi),
+                                  _mm_unpackhi_epi64(lo, hi));
+      sum = _mm_srli_epi16(_mm_add_epi16(sum, two), 2);
+      _mm_storel_epi64((__m128i *)(out + 4 * x), _mm_packus_epi16(sum, sum));
+    }
+#endif
+    for (; x < dst.width; ++x) {
+      int x0 = std::min(2 * x, src.width - 1);
+      int x1 = std::min(2 * x + 1, src.width - 1);
+      for (int c = 0; c < 4; ++c)
+        out[4 * x + c] = (uint8_t)((row0[4 * x0 + c] + row0[4 * x1 + c] +
+                                    row1[4 * x0 + c] + row1[4 * x1 + c] + 2) >>
+                                   2);
+    }
+  }
+}
+
+// Zeroth-order modified Bessel function (series), for the Kaiser window
+double besselI0(double x) {
+  double sum = 1.0, term = 1.0;
+  for (int k = 1; k < 16; ++k) {
+    term *= (x / (2.0 * k)) * (x / (2.0 * k));
+    sum += term;
+  }
+  return sum;
+}
+
+// Weights of the source texels 2x-3 .. 2x+4 around output texel x (its
+// center sits between source texels 2x and 2x+1)
+void kaiserWeights(float weights[kKaiserTaps]) {
+  const double alpha = 4.0;
+  const double radius = kKaiserTaps / 2.0;
+  double total = 0.0;
+  for (int i = 0; i < kKaiserTaps; ++i) {
+    double d = (i - kKaiserTaps / 2 + 0.5); // Distance in source texels
+    double t = d / 2.0;                     // ... in output texels
+    double sinc = std::sin(M_PI * t) / (M_PI * t);
+    double r = d / radius;
+    double window = besselI0(alpha * std::sqrt(std::max(0.0, 1.0 - r * r))) /
+                    besselI0(alpha);
+    weights[i] = (float)(sinc * window);
+    total += weights[i];
+  }
+  for (int i = 0; i < kKaiserTaps; ++i)
+    weights[i] = (float)(weights[i] / total);
+}
+
+// Separable Kaiser downsample: horizontal into `temp` (dst width x src
+// height floats), then vertical into dst
+void kaiserLevel(const TextureLevel &src, TextureLevel &dst,
+                 JobSystem *jobs) {
+  float weights[kKaiserTaps];
+  kaiserWeights(weights);
+  std::vector<float> temp((size_t)dst.width * src.height * 4);
+  const int half = kKaiserTaps / 2;
+
+  forRange(jobs, src.height, kRowGrain, [&](size_t begin, size_t end) {
+    for (size_t y = begin; y < end; ++y) {
+      const uint8_t *row = &src.data[y * src.width * 4];
+      float *out = &temp[y * dst.width * 4];
+      for (int x = 0; x < dst.width; ++x) {
+        float sum[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+        for (int i = 0; i < kKaiserTaps; ++i) {
+          int sx = std::min(std::max(2 * x - half + 1 + i, 0), src.width - 1);
+          for (int c = 0; c < 4; ++c)
+            sum[c] += weights[i] * row[4 * sx + c];
+        }
+        for (int c = 0; c < 4; ++c)
+          out[4 * x + c] = sum[c];
+      }
+    }
+  });
+  forRange(jobs, dst.height, kRowGrain, [&](size_t begin, size_t end) {
+    for (size_t y = begin; y < end; ++y) {
+      uint8_t *out = &dst.data[y * dst.width * 4];
+      for (int x = 0; x < dst.width; ++x) {
+        float sum[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+        for (int i = 0; i < kKaiserTaps; ++i) {
+          int sy = std::min(std::max(2 * (int)y - half + 1 + i, 0),
+                            src.height - 1);
+          const float *in = &temp[((size_t)sy * dst.width + x) * 4];
+          for (int c = 0; c < 4; ++c)
+            sum[c] += weights[i] * in[c];
+        }
+        for (int c = 0; c < 4; ++c)
+          out[4 * x + c] =
+              (uint8_t)std::min(std::max(sum[c] + 0.5f, 0.0f), 255.0f);
+      }
+    }
+  });
+}
+
+// --- Block compression ---
+
+uint16_t packRGB565(const float rgb[3]) {
+  int r = (int)std::lround(std::min(std::max(rgb[0], 0.0f), 255.0f) * 31.0f /
+                           255.0f);
+  int g = (int)std::lround(std::min(std::max(rgb[1], 0.0f), 255.0f) * 63.0f /
+                           255.0f);
+  int b = (int)std::lround(std::min(std::max(rgb[2], 0.0f), 255.0f) * 31.0f /
+                           255.0f);
+  return (uint16_t)(r << 11 | g << 5 | b);
+}
+
+void unpackRGB565(uint16_t c, int rgb[3]) {
+  int r = c >> 11, g = (c >> 5) & 63, b = c & 31;
+  rgb[0] = (r << 3) | (r >> 2);
+  rgb[1] = (g << 2) | (g >> 4);
+  rgb[2] = (b << 3) | (b >> 2);
+}
+
+// Color half of a BC1 / BC3 block: endpoints at the extremes of the texels
+// projected on their principal axis, then the nearest of the four palette
+// entries per texel. Always four-color mode (color0 > color1).
+void encodeColorBlock(const uint8_t block[64], uint8_t out[8]) {
+  float mean[3] = {0.0f, 0.0f, 0.0f};
+  for (int i = 0; i < 16; ++i)
+    for (int c = 0; c < 3; ++c)
+      mean[c] += block[4 * i + c] / 16.0f;
+  float cov[6] = {0, 0, 0, 0, 0, 0}; // rr rg rb gg gb bb
+  for (int i = 0; i < 16; ++i) {
+    float d[3] = {block[4 * i] - mean[0], block[4 * i + 1] - mean[1],
+                  block[4 * i + 2] - mean[2]};
+    cov[0] += d[0] * d[0];
+    cov[1] += d[0] * d[1];
+    cov[2] += d[0] * d[2];
+    cov[3] += d[1] * d[1];
+    cov[4] += d[1] * d[2];
+    cov[5] += d[2] * d[2];
+  }
+  // Power iteration for the principal axis
+  float axis[3] = {1.0f, 1.0f, 1.0f};
+  for (int iter = 0; iter < 8; ++iter) {
+    float next[3] = {cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2],
+                     cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2],
+                     cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2]};
+    float length = std::sqrt(next[0] * next[0] + next[1] * next[1] +
+                             next[2] * next[2]);
+    if (length < 1e-6f)
+      break; // Flat block: any axis works
+    for (int c = 0; c < 3; ++c)
+      axis[c] = next[c] / length;
+  }
+  float lo = 1e30f, hi = -1e30f;
+  for (int i = 0; i < 16; ++i) {
+    float t = 0.0f;
+    for (int c = 0; c < 3; ++c)
+      t += (block[4 * i + c] - mean[c]) * axis[c];
+    lo = std::min(lo, t);
+    hi = std::max(hi, t);
+  }
+  float end0[3], end1[3];
+  for (int c = 0; c < 3; ++c) {
+    end0[c] = mean[c] + axis[c] * hi;
+    end1[c] = mean[c] + axis[c] * lo;
+  }
+  uint16_t c0 = packRGB565(end0), c1 = packRGB565(end1);
+  if (c0 < c1)
+    std::swap(c0, c1);
+
+  uint32_t indices = 0;
+  if (c0 != c1) {
+    int palette[4][3];
+    unpackRGB565(c0, palette[0]);
+    unpackRGB565(c1, palette[1]);
+    for (int c = 0; c < 3; ++c) {
+      palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+      palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+    for (int i = 0; i < 16; ++i) {
+      int best = 0, bestError = INT32_MAX;
+      for (int p = 0; p < 4; ++p) {
+        int error = 0;
+        for (int c = 0; c < 3; ++c) {
+          int d = block[4 * i + c] - palette[p][c];
+          error += d * d;
+        }
+        if (error < bestError) {
+          bestError = error;
+          best = p;
+        }
+      }
+      indices |= (uint32_t)best << (2 * i);
+    }
+  }
+  out[0] = (uint8_t)(c0 & 0xff);
+  out[1] = (uint8_t)(c0 >> 8);
+  out[2] = (uint8_t)(c1 & 0xff);
+  out[3] = (uint8_t)(c1 >> 8);
+  for (int i = 0; i < 4; ++i)
+    out[4 + i] = (uint8_t)(indices >> (8 * i));
+}
+
+// Alpha half of a BC3 block: endpoints at the extremes, eight-value mode
+void encodeAlphaBlock(const uint8_t block[64], uint8_t out[8]) {
+  int a0 = 0, a1 = 255;
+  for (int i = 0; i < 16; ++i) {
+    a0 = std::max(a0, (int)block[4 * i + 3]);
+    a1 = std::min(a1, (int)block[4 * i + 3]);
+  }
+  uint64_t indices = 0;
+  if (a0 != a1) {
+    // Codes 0 and 1 are the endpoints, 2..7 the steps between them
+    int palette[8] = {a0, a1};
+    for (int i = 1; i < 7; ++i)
+      palette[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+    for (int i = 0; i < 16; ++i) {
+      int best = 0, bestError = 256;
+      for (int p = 0; p < 8; ++p) {
+        int error = std::abs(block[4 * i + 3] - palette[p]);
+        if (error < bestError) {
+          bestError = error;
+          best = p;
+        }
+      }
+      indices |= (uint64_t)best << (3 * i);
+    }
+  }
+  out[0] = (uint8_t)a0;
+  out[1] = (uint8_t)a1;
+  for (int i = 0; i < 6; ++i)
+    out[2 + i] = (uint8_t)(indices >> (8 * i));
+}
+
+void compressLevel(const TextureLevel &src, TextureLevel &dst, bool alpha,
+                   JobSystem *jobs) {
+  const int blocksX = (src.width + 3) / 4, blocksY = (src.height + 3) / 4;
+  const size_t blockBytes = alpha ? 16 : 8;
+  dst.width = src.width;
+  dst.height = src.height;
+  dst.data.resize((size_t)blocksX * blocksY * blockBytes);
+  forRange(jobs, blocksY, kBlockGrain, [&](size_t begin, size_t end) {
+    uint8_t block[64];
+    for (size_t by = begin; by < end; ++by) {
+      for (int bx = 0; bx < blocksX; ++bx) {
+        for (int y = 0; y < 4; ++y) {
+          int sy = std::min((int)by * 4 + y, src.height - 1);
+          for (int x = 0; x < 4; ++x) {
+            int sx = std::min(bx * 4 + x, src.width - 1);
+            std::memcpy(&block[4 * (4 * y + x)],
+                        &src.data[((size_t)sy * src.width + sx) * 4], 4);
+          }
+        }
+        uint8_t *out = &dst.data[(by * blocksX + bx) * blockBytes];
+        if (alpha) {
+          encodeAlphaBlock(block, out);
+          encodeColorBlock(block, out + 8);
+        } else {
+          encodeColorBlock(block, out);
+        }
+      }
+    }
+  });
+}
+
+// --- Cache ---
+
+struct CacheHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t format;
+  uint32_t filter;
+  uint32_t hasAlpha;
+  uint32_t levels;
+  uint64_t sourceSize;
+  int64_t sourceTime;
+};
+
+bool sourceStamp(const char *path, uint64_t &size, int64_t &time) {
+  struct stat info;
+  if (stat(path, &info) != 0)
+    return false;
+  size = (uint64_t)info.st_size;
+  time = (int64_t)info.st_mtime;
+  return true;
+}
+
+bool readCache(const std::string &cachePath, const CacheHeader &expected,
+               TextureData &out) {
+  FILE *file = std::fopen(cachePath.c_str(), "rb");
+  if (!file)
+    return false;
+  CacheHeader header;
+  bool ok = std::fread(&header, sizeof header, 1, file) == 1 &&
+            !std::memcmp(header.magic, kCacheMagic, 4) &&
+            header.version == kCacheVersion &&
+            header.filter == expected.filter &&
+            header.sourceSize == expected.sourceSize &&
+            header.sourceTime == expected.sourceTime &&
+            (expected.format == TEXTURE_RGBA8) ==
+                (header.format == TEXTURE_RGBA8) &&
+            header.levels > 0 && header.levels <= 32;
+  if (ok) {
+    out.format = (TextureFormat)header.format;
+    out.hasAlpha = header.hasAlpha != 0;
+    out.levels.resize(header.levels);
+    for (TextureLevel &level : out.levels) {
+      int32_t size[2];
+      uint32_t bytes = 0;
+      ok = std::fread(size, sizeof size, 1, file) == 1 &&
+           std::fread(&bytes, sizeof bytes, 1, file) == 1 && size[0] > 0 &&
+           size[1] > 0;
+      if (!ok)
+        break;
+      level.width = size[0];
+      level.height = size[1];
+      level.data.resize(bytes);
+      ok = bytes == 0 || std::fread(level.data.data(), bytes, 1, file) == 1;
+      if (!ok)
+        break;
+    }
+  }
+  std::fclose(file);
+  return ok;
+}
+
+bool writeCache(const std::string &cachePath, CacheHeader header,
+                const TextureData &texture) {
+  FILE *file = std::fopen(cachePath.c_str(), "wb");
+  if (!file)
+    return false;
+  header.format = texture.format;
+  header.hasAlpha = texture.hasAlpha ? 1 : 0;
+  header.levels = (uint32_t)texture.levels.size();
+  bool ok = std::fwrite(&header, sizeof header, 1, file) == 1;
+  for (const TextureLevel &level : texture.levels) {
+    int32_t size[2] = {level.width, level.height};
+    uint32_t bytes = (uint32_t)level.data.size();
+    ok = ok && std::fwrite(size, sizeof size, 1, file) == 1 &&
+         std::fwrite(&bytes, sizeof bytes, 1, file) == 1 &&
+         (bytes == 0 ||
+          std::fwrite(level.data.data(), bytes, 1, file) == 1);
+  }
+  ok = std::fclose(file) == 0 && ok;
+  if (!ok)
+    std::remove(cachePath.c_str()); // Never leave a truncated cache
+  return ok;
+}
+} // namespace
+
+size_t textureBytes(const TextureData &texture) {
+  size_t bytes = 0;
+  for (const TextureLevel &level : texture.levels)
+    bytes += level.data.size();
+  return bytes;
+}
+
+bool decodeImage(const char *path, TextureData &out) {
+  PROFILE_FUNCTION();
+  std::vector<uint8_t> bytes;
+  if (!readFile(path, bytes)) {
+    std::fprintf(stderr, "[texture] cannot read %s\n", path);
+    return false;
+  }
+  out.format = TEXTURE_RGBA8;
+  out.levels.assign(1, TextureLevel());
+  bool ok = bytes.size() > 2 && bytes[0] == 'P' && bytes[1] == '6'
+                ? decodePPM(bytes, out.levels[0])
+                : decodeTGA(bytes, out.levels[0]);
+  if (!ok) {
+    std::fprintf(stderr, "[texture] %s is not a PPM (P6) or TGA image\n",
+                 path);
+    out.levels.clear();
+    return false;
+  }
+  out.hasAlpha = false;
+  const std::vector<uint8_t> &data = out.levels[0].data;
+  for (size_t i = 3; i < data.size() && !out.hasAlpha; i += 4)
+    out.hasAlpha = data[i] != 255;
+  return true;
+}
+
+void generateMips(TextureData &texture, MipFilter filter, JobSystem *jobs) {
+  PROFILE_FUNCTION();
+  if (texture.levels.empty() || texture.format != TEXTURE_RGBA8)
+    return;
+  texture.levels.resize(1);
+  while (texture.levels.back().width > 1 || texture.levels.back().height > 1) {
+    texture.levels.push_back(TextureLevel());
+    const TextureLevel &src = texture.levels[texture.levels.size() - 2];
+    TextureLevel &dst = texture.levels.back();
+    dst.width = std::max(1, src.width / 2);
+    dst.height = std::max(1, src.height / 2);
+    dst.data.resize((size_t)dst.width * dst.height * 4);
+    if (filter == MIP_KAISER) {
+      kaiserLevel(src, dst, jobs);
+    } else {
+      forRange(jobs, dst.height, kRowGrain, [&](size_t begin, size_t end) {
+        boxRows(src, dst, begin, end);
+      });
+    }
+  }
+}
+
+void compressTexture(TextureData &texture, JobSystem *jobs) {
+  PROFILE_FUNCTION();
+  if (texture.format != TEXTURE_RGBA8)
+    return;
+  for (TextureLevel &level : texture.levels) {
+    TextureLevel compressed;
+    compressLevel(level, compressed, texture.hasAlpha, jobs);
+    level = std::move(compressed);
+  }
+  texture.format = texture.hasAlpha ? TEXTURE_BC3 : TEXTURE_BC1;
+}
+
+bool loadTexture(const char *path, TextureData &out,
+                 const TextureOptions &options, JobSystem *jobs,
+                 TextureTimings *timings) {
+  PROFILE_FUNCTION();
+  TextureTimings local;
+  TextureTimings &times = timings ? *timings : local;
+  times = TextureTimings();
+
+  CacheHeader header;
+  std::memcpy(header.magic, kCacheMagic, 4);
+  header.version = kCacheVersion;
+  header.format = options.compress ? TEXTURE_BC1 : TEXTURE_RGBA8;
+  header.filter = options.filter;
+  header.hasAlpha = 0;
+  header.levels = 0;
+  std::string cachePath = std::string(path) + ".tex";
+  bool stamped = options.useCache &&
+                 sourceStamp(path, header.sourceSize, header.sourceTime);
+
+  double start = nowMs();
+  if (stamped && readCache(cachePath, header, out)) {
+    times.cacheMs = nowMs() - start;
+    times.fromCache = true;
+    return true;
+  }
+
+  if (!decodeImage(path, out))
+    return false;
+  double decoded = nowMs();
+  generateMips(out, options.filter, jobs);
+  double mipped = nowMs();
+  if (options.compress)
+    compressTexture(out, jobs);
+  double compressed = nowMs();
+  times.decodeMs = decoded - start;
+  times.mipMs = mipped - decoded;
+  times.compressMs = compressed - mipped;
+
+  if (stamped) {
+    if (!writeCache(cachePath, header, out))
+      std::fprintf(stderr, "[texture] cannot write cache %s\n",
+                   cachePath.c_str());
+    times.cacheMs = nowMs() - compressed;
+  }
+  return true;
+}
+
+void loadTextures(const std::vector<std::string> &paths,
+                  std::vector<TextureData> &out, std::vector<bool> &ok,
+                  const TextureOptions &options, JobSystem *jobs) {
+  PROFILE_FUNCTION();
+  out.assign(paths.size(), TextureData());
+  // Not vector<bool>: its elements share bytes, so jobs could race
+  std::vector<uint8_t> loaded(paths.size(), 0);
+  if (jobs) {
+    JobCounter counter;
+    for (size_t i = 0; i < paths.size(); ++i)
+      jobs->run(
+          [&, i]() {
+            loaded[i] = loadTexture(paths[i].c_str(), out[i], options, jobs);
+          },
+          &counter);
+    jobs->wait(counter);
+  } else {
+    for (size_t i = 0; i < paths.size(); ++i)
+      loaded[i] = loadTexture(paths[i].c_str(), out[i], options, nullptr);
+  }
+  ok.assign(loaded.begin(), loaded.end());
+}
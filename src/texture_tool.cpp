@@ -0,0 +1,115 @@
+// Texture pipeline tool: decodes images, builds their mip chains and
+// block-compresses them as tp2 does for map_Kd, writing the .tex caches
+// next to them. Reports the time of each step, and of the whole batch
+// loaded in parallel against one image after another.
+//
+// Usage: texture_tool [options] image.ppm|image.tga ...
+//   --threads N      job system workers (default: one per hardware thread - 1)
+//   --kaiser         Kaiser-windowed mips instead of the 2x2 box filter
+//   --rgba           keep RGBA8 instead of compressing to BC1 / BC3
+//   --no-cache       neither read nor write the .tex caches
+#include "job_system.hpp"
+#include "texture.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+double nowMs() {
+  using namespace std::chrono;
+  return duration<double, std::milli>(steady_clock::now().time_since_epoch())
+      .count();
+}
+
+struct Options {
+  unsigned threads = 0;
+  TextureOptions texture;
+  std::vector<std::string> paths;
+};
+
+bool parseOptions(int argc, char **argv, Options &opt) {
+  for (int i = 1; i < argc; ++i) {
+    const char *arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (!std::strcmp(arg, "--threads") && hasValue) {
+      opt.threads = (unsigned)std::atoi(argv[++i]);
+    } else if (!std::strcmp(arg, "--kaiser")) {
+      opt.texture.filter = MIP_KAISER;
+    } else if (!std::strcmp(arg, "--rgba")) {
+      opt.texture.compress = false;
+    } else if (!std::strcmp(arg, "--no-cache")) {
+      opt.texture.useCache = false;
+    } else if (arg[0] != '-') {
+      opt.paths.push_back(arg);
+    } else {
+      return false;
+    }
+  }
+  return !opt.paths.empty();
+}
+
+const char *formatName(TextureFormat format) {
+  switch (format) {
+  case TEXTURE_BC1:
+    return "BC1";
+  case TEXTURE_BC3:
+    return "BC3";
+  default:
+    return "RGBA8";
+  }
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  Options opt;
+  if (!parseOptions(argc, argv, opt)) {
+    std::fprintf(stderr, "Uso: texture_tool [--threads N] [--kaiser] [--rgba] "
+                         "[--no-cache] imagem ...\n");
+    return -1;
+  }
+  JobSystem jobs(opt.threads);
+
+  // One image after another (each still splits its mips and blocks), with
+  // the time of every step. Writes the caches the batch below then reads,
+  // unless --no-cache.
+  std::printf("%-32s %6s %11s %6s %7s %8s %8s %8s %8s\n", "image",
+              "format", "size", "levels", "KB", "decode", "mips", "encode",
+              "cache");
+  double serialStart = nowMs();
+  int failed = 0;
+  for (const std::string &path : opt.paths) {
+    TextureData texture;
+    TextureTimings timings;
+    if (!loadTexture(path.c_str(), texture, opt.texture, &jobs, &timings)) {
+      ++failed;
+      continue;
+    }
+    char size[32];
+    std::snprintf(size, sizeof size, "%dx%d", texture.levels[0].width,
+                  texture.levels[0].height);
+    std::printf(
+        "%-32s %6s %11s %6zu %7zu %6.2fms %6.2fms %6.2fms %6.2fms%s\n",
+        path.c_str(), formatName(texture.format), size, texture.levels.size(),
+        (textureBytes(texture) + 1023) / 1024, timings.decodeMs, timings.mipMs,
+        timings.compressMs, timings.cacheMs,
+        timings.fromCache ? " (cache)" : "");
+  }
+  double serialMs = nowMs() - serialStart;
+
+  // The whole batch, one job per image as tp2 loads its materials
+  std::vector<TextureData> textures;
+  std::vector<bool> ok;
+  double batchStart = nowMs();
+  loadTextures(opt.paths, textures, ok, opt.texture, &jobs);
+  double batchMs = nowMs() - batchStart;
+
+  std::printf("\n%zu images, %u worker threads\n", opt.paths.size(),
+              jobs.threadCount());
+  std::printf("one by one : %8.2f ms\n", serialMs);
+  std::printf("parallel   : %8.2f ms%s\n", batchMs,
+              opt.texture.useCache ? " (from the caches just written)" : "");
+  return failed ? -1 : 0;
+}
@@ -0,0 +1,74 @@
+#include "texture.hpp"
+#include "profiler.hpp"
+#include "render_stats.hpp"
+#include <cstdio>
+#include <cstring>
+
+// EXT_texture_compression_s3tc is an extension, not part of GL 4.1 core:
+// most desktop drivers offer it, but textureCompressionSupported() must
+// say so before BC1 / BC3 data is uploaded
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+bool textureCompressionSupported() {
+  static int supported = -1; // Not asked yet
+  if (supported < 0) {
+    supported = 0;
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count && !supported; ++i) {
+      const char *name = (const char *)glGetStringi(GL_EXTENSIONS, (GLuint)i);
+      supported = name && !std::strcmp(name, "GL_EXT_texture_compression_s3tc");
+    }
+  }
+  return supported != 0;
+}
+
+GLuint createTexture(const TextureData &texture) {
+  PROFILE_FUNCTION();
+  if (texture.levels.empty())
+    return 0;
+  if (texture.format != TEXTURE_RGBA8 && !textureCompressionSupported()) {
+    std::fprintf(stderr, "[texture] no S3TC support for BC data\n");
+    return 0;
+  }
+  GLuint id = 0;
+  glGenTextures(1, &id);
+  glBindTexture(GL_TEXTURE_2D, id);
+  // RGBA8 rows are tightly packed, whatever their width
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  for (size_t i = 0; i < texture.levels.size(); ++i) {
+    const TextureLevel &level = texture.levels[i];
+    renderStats().bufferBytesUploaded += level.data.size();
+    if (texture.format == TEXTURE_RGBA8)
+      glTexImage2D(GL_TEXTURE_2D, (GLint)i, GL_RGBA8, level.width,
+                   level.height, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                   level.data.data());
+    else
+      glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)i,
+                             texture.format == TEXTURE_BC1
+                                 ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+                                 : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT,
+                             level.width, level.height, 0,
+                             (GLsizei)level.data.size(), level.data.data());
+  }
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL,
+                  (GLint)texture.levels.size() - 1);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                  GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  if (glGetError() != GL_NO_ERROR) {
+    std::fprintf(stderr, "[texture] upload failed\n");
+    glDeleteTextures(1, &id);
+    return 0;
+  }
+  return id;
+}